@@ -16,11 +16,19 @@
 
 #include <htc.h>
 #include "Usb.h"
+#include "board.h"
 #include "nes_keyboard.h"
+#include "nes_mouse.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "probe.h"
+#include "console.h"
+#include "record.h"
+#include "playback.h"
 
 // CONFIG1
 #pragma config FOSC = INTOSC    // Oscillator Selection Bits (INTOSC oscillator: I/O function on CLKIN pin)
-#pragma config WDTE = OFF       // Watchdog Timer Enable (WDT disabled)
+#pragma config WDTE = SWDTEN    // Watchdog Timer Enable (WDT controlled by SWDTEN - used as the wake timer in suspend)
 #pragma config PWRTE = OFF      // Power-up Timer Enable (PWRT disabled)
 #pragma config MCLRE = OFF      // MCLR Pin Function Select (MCLR/VPP pin function is Digital Input)
 #pragma config CP = OFF         // Flash Program Memory Code Protection (Program memory code protection is disabled)
@@ -41,9 +49,33 @@
 #pragma config LVP = OFF         // Low-Voltage Programming Enable (Low-voltage programming enabled)
 
 // Local Defines
-#define LED_SetHigh()            do { PORTAbits.RA4 = 1; } while(0)
-#define LED_SetLow()             do { PORTAbits.RA4 = 0; } while(0)
-#define LED_Toggle()             do { PORTAbits.RA4 = ~LATCbits.LATC2; } while(0)
+#define LED_SetHigh()            do { PIN_LAT(BOARD_LED) = BOARD_LED_ON; } while(0)
+#define LED_SetLow()             do { PIN_LAT(BOARD_LED) = !BOARD_LED_ON; } while(0)
+#define LED_Toggle()             do { PIN_LAT(BOARD_LED) ^= 1; } while(0)
+
+// Pad polling, paced by the USB frame (1ms). The SIE needs the 48MHz clock
+// while the bus is up, so the CPU can't sleep or slow down between samples
+// and the idle rate saves no power - the core spins at 48MHz and draws the
+// same current either way, only suspend is a low power state. What it
+// saves is CPU time, ~100us of pad shifting per sample. The cost is up to
+// one poll period of extra latency for any change (press, release or a
+// different button) once the pad has been still for IDLE_AFTER_FRAMES.
+// Press to host, p99 / max, from make sim (see tools/sim/sim.c):
+//   active  1 frame  -> 1000 samples/s, 10% of the CPU, 2.1 / 2.1ms
+//   idle    8 frames ->  125 samples/s, 1.3% of the CPU, 7.7 / 8.5ms
+// POLL_FRAMES_ACTIVE 0 samples on every pass of the main loop. These are
+// the start up values, the console can change them ("set").
+#define POLL_FRAMES_ACTIVE      1
+#define POLL_FRAMES_IDLE        8
+#define IDLE_AFTER_FRAMES       5000    // No change for 5s -> idle rate
+
+// Suspend
+#define SUSPEND_WDTPS           0b00100 // Wake every 16ms to look at the pad while suspended
+#if PaddleEnabled
+#define WAKE_BUTTONS            BUTTON_A // Fire - the other bits are the potentiometer line
+#else
+#define WAKE_BUTTONS            0xFF
+#endif
 
 //Modifier Keys (First Byte in Keyboard Message)
 #define KEY_L_CTRL			0x01
@@ -57,11 +89,29 @@
 
 // Local Variables
 uint8_t last_keypad_reading;  // This is to hold last status of the keypad so that we only report if it changes
+uint8_t last_sample_frame;    // FrameCount at the last pad sample
+uint16_t idle_frames;         // Frames since the pad last changed
+uint8_t poll_frames_active = POLL_FRAMES_ACTIVE;
+uint8_t poll_frames_idle = POLL_FRAMES_IDLE;
+#if SnapshotEnabled
+uint16_t sample_sequence;     // Counts every pad sample, reported in the snapshot
+#endif
+#if MouseEnabled
+uint8_t mouse_mode;           // Set when the pad drives the mouse instead of the keyboard
+uint8_t last_frame;           // FrameCount when the mouse was last updated
+uint8_t last_mouse_reading;   // Raw pad reading, used to catch the mode combo
+#endif
 
 // Interrupt
 void __interrupt () ISRCode (void)
 {
+#if VendorEnabled
+    uint16_t start = Scheduler_Cycles();
+    if (UsbInterrupt) ProcessUSBTransactions();
+    Telemetry_Isr(Scheduler_Cycles() - start);
+#else
     if (UsbInterrupt) ProcessUSBTransactions();
+#endif
 }
 
 static void InitializeSystem(void)
@@ -91,7 +141,7 @@ void PrepareTxBuffer(uint8_t keypad_reading)
     uint8_t n;
 
     //Reset TX Buffer to zeroes
-    for(n = 0 ; n < HidReportByteCount; n++)
+    for(n = 0 ; n < HidReportByteCount; n++)  // loop:ReportClear
     {
         HIDTxBuffer[n] = 0x00;
     }
@@ -101,15 +151,16 @@ void PrepareTxBuffer(uint8_t keypad_reading)
     {
         LED_SetHigh();
 
-        uint8_t i = 0;
+        uint8_t i;
+        uint8_t button = 1;
         uint8_t index = 2; // 1st byte = modifier key bits, 2nd byte is always zero (padding)
 
         uint8_t max_buttons = 6;
-        while( button_key_maps[i].button != NULL )
+        for (i = 0; i < BUTTON_COUNT; i++, button <<= 1)  // loop:ReportButtons
         {
-            if ( (keypad_reading & button_key_maps[i].button) > 0)
+            if ( (keypad_reading & button) > 0)
             {
-                uint16_t key = button_key_maps[i].key;
+                uint8_t key = button_keys[i];
                 
                 if (key == KEY_RIGHTSHIFT)
                 {
@@ -124,7 +175,6 @@ void PrepareTxBuffer(uint8_t keypad_reading)
                     }
                 }
             }
-            i++;
         }
     }
     else
@@ -152,30 +202,300 @@ static void CheckUsb(void)
     }
 }
 
-void ProcessIO(void)
+#if PaddleEnabled
+static void PaddleTask(void);
+#else
+static void PadTask(void);
+#endif
+static void UsbOutTask(void);
+static void IdleReportTask(void);
+
+// Everything the main loop does, in priority order (see scheduler.h)
+#define TASK_INPUT      0
+Task Tasks[] =
+{
+#if PaddleEnabled
+    TASK(PaddleTask,     1,                  0),    // Fresh position every frame
+#else
+    TASK(PadTask,        POLL_FRAMES_ACTIVE, 0),    // Sample pad, stage report
+#endif
+    TASK(UsbOutTask,     0,                  0),    // Output reports (LEDs)
+    TASK(IdleReportTask, 1,                  3),    // SET_IDLE repeats, 4ms granularity
+#if RecordEnabled
+    TASK(RecordTask,     1,                  0),    // Recording stream, one report per frame at most
+#endif
+#if PlaybackEnabled
+    TASK(PlaybackTask,   1,                  0),    // Timeline reports into the playback ring
+#endif
+#if CdcEnabled
+    TASK(ConsoleTask,    1,                  7),    // Debug console, idle unless the port is open
+#endif
+};
+#define TaskCount (sizeof(Tasks) / sizeof(Tasks[0]))
+
+// Check USB for incomming Commands
+static void UsbOutTask(void)
 {
-    // Check USB for incomming Commands
     if (IsUsbReady) CheckUsb();
+}
+
+// Host asked for periodic reports (SET_IDLE) - repeat the last one
+static void IdleReportTask(void)
+{
+    if (HidIdleDue && IsUsbReady) HIDSend(HidInterfaceNumber);
+}
+
+#if PaddleEnabled
+// The Vaus has no buttons to map to keys - it only drives the mouse
+static void PaddleTask(void)
+{
+    uint8_t position;
+    uint8_t fire;
+
+    fire = NES_read_paddle(&position);
+    if (IsUsbReady) NES_paddle_frame(fire, position);
+}
+#else
+#if MouseEnabled
+static void ProcessMouse(uint8_t reading)
+{
+    // Toggle the mode on the press of the combo
+    if ((reading & MOUSE_MODE_COMBO) == MOUSE_MODE_COMBO &&
+        (last_mouse_reading & MOUSE_MODE_COMBO) != MOUSE_MODE_COMBO)
+    {
+        // Release the mouse buttons when going back to the keyboard
+        if (mouse_mode && IsUsbReady) NES_mouse_frame(0);
+        mouse_mode = !mouse_mode;
+        NES_mouse_reset();
+    }
+    last_mouse_reading = reading;
+
+    if (!mouse_mode) return;
+
+    // Pointer movement is paced by the USB frame
+    if (last_frame == FrameCount) return;
+    last_frame = FrameCount;
+
+    if (IsUsbReady) NES_mouse_frame(reading);
+}
+#endif
+
+#if SnapshotEnabled
+// Keep the GET_REPORT(Feature) snapshot current: raw pad byte, the frame it
+// was sampled in and a sequence number so the host can tell how fresh it is.
+static void SaveSnapshot(uint8_t reading)
+{
+    sample_sequence++;
+
+    // The ISR may be reading it for a GET_REPORT
+    INTCONbits.GIE = 0;
+    HIDFeatureBuffer[0] = reading;
+    HIDFeatureBuffer[1] = UFRML;
+    HIDFeatureBuffer[2] = UFRMH;
+    HIDFeatureBuffer[3] = LSB(sample_sequence);
+    HIDFeatureBuffer[4] = MSB(sample_sequence);
+    INTCONbits.GIE = 1;
+}
+#endif
+
+static void SetActivePolling(void)
+{
+    idle_frames = 0;
+    Tasks[TASK_INPUT].Period = poll_frames_active;
+}
+
+static void PadTask(void)
+{
+    // Drop to the idle rate once nothing has changed for a while
+    if (idle_frames < IDLE_AFTER_FRAMES) idle_frames += (uint8_t)(FrameCount - last_sample_frame);
+    else Tasks[TASK_INPUT].Period = poll_frames_idle;
+    last_sample_frame = FrameCount;
 
     // Check Status Of the keypad
-    uint8_t reading = NES_read_pad();
+#if VendorEnabled
+    uint16_t sampled = Scheduler_Cycles();
+    TELEMETRY_LOG2(SampleJitter, Telemetry_SinceSof(sampled));
+#endif
+    PROBE_BEGIN(PROBE_READ_PAD);
+    uint8_t reading = read_buttons();
+    PROBE_END(PROBE_READ_PAD);
+#if SnapshotEnabled
+    SaveSnapshot(reading);
+#endif
+    Record_Sample(reading);
+#if RecordEnabled
+    if (RecordOn)
+    {
+        idle_frames = 0;
+        Tasks[TASK_INPUT].Period = 1;   // Records are stamped to the frame
+    }
+#endif
+#if PlaybackEnabled
+    if (IsPlaying)
+    {
+        reading = Playback_Input(reading);
+        idle_frames = 0;
+        Tasks[TASK_INPUT].Period = 1;   // One step of the timeline per frame
+    }
+#endif
+
+#if MouseEnabled
+    ProcessMouse(reading);
+    if (mouse_mode)
+    {
+        SetActivePolling();     // Pointer movement needs every frame
+        reading = 0;            // Keyboard stays released while in mouse mode
+    }
+#endif
+
     if (reading == last_keypad_reading ) return;
 
-    // If Keypad Changed - Report
+    // If Keypad Changed - Report. Before configuration the report is only
+    // staged; SET_CONFIGURATION arms it for the host's first poll.
+    PROBE_BEGIN(PROBE_PREPARE_TX);
     PrepareTxBuffer(reading);
-    HIDSend(HidInterfaceNumber);
+    PROBE_END(PROBE_PREPARE_TX);
+    TELEMETRY_LOG2(StageLatency, Scheduler_Cycles() - sampled);
+    if (IsUsbReady) HIDSend(HidInterfaceNumber);
 
     // Save New Button Status
     last_keypad_reading = reading;
+
+    // First edge brings back the full rate
+    SetActivePolling();
+}
+#endif
+
+#if CdcEnabled
+// Console commands (see console.h)
+
+static void StatsCommand(const char *arguments)
+{
+    (void)arguments;
+#if VendorEnabled
+    Console_Write("resets ");
+    Console_Decimal(Telemetry.BusResets);
+    Console_Write(" reports ");
+    Console_Decimal(Telemetry.Reports);
+    Console_Write(" dropped ");
+    Console_Decimal(Telemetry.Dropped);
+    Console_Write(" isr max ");
+    Console_Decimal(Telemetry.IsrMaxCycles);
+    Console_Write("\r\n");
+#else
+    Console_Write("no telemetry (VendorEnabled 0)\r\n");
+#endif
+}
+
+static void TasksCommand(const char *arguments)
+{
+    uint8_t i;
+
+    (void)arguments;
+    for (i = 0; i < TaskCount; i++)
+    {
+        Console_Write("task ");
+        Console_Decimal(i);
+        Console_Write(" period ");
+        Console_Decimal(Tasks[i].Period);
+        Console_Write(" misses ");
+        Console_Decimal(Tasks[i].Misses);
+        Console_Write(" max ");
+        Console_Decimal(Tasks[i].MaxCycles);
+        Console_Write("\r\n");
+    }
+}
+
+static void StateCommand(const char *arguments)
+{
+    (void)arguments;
+    Console_Write("usb ");
+    Console_Decimal(DeviceState);
+    Console_Write(" addr ");
+    Console_Decimal(UADDR);
+    Console_Write(" pad ");
+    Console_Hex(last_keypad_reading);
+    Console_Write(" idle ");
+    Console_Decimal(idle_frames);
+    Console_Write(" poll ");
+    Console_Decimal(poll_frames_active);
+    Console_Write("/");
+    Console_Decimal(poll_frames_idle);
+    Console_Write("\r\n");
+}
+
+#if !PaddleEnabled
+// set active|idle <frames> - pad poll periods, 1..255 (PadTask() only, the
+// paddle is read every frame)
+static void SetCommand(const char *arguments)
+{
+    uint16_t value = 0;
+    uint8_t *setting = 0;
+    const char *number;
+
+    if ((number = Console_Word(arguments, "active")) != 0) setting = &poll_frames_active;
+    else if ((number = Console_Word(arguments, "idle")) != 0) setting = &poll_frames_idle;
+
+    if (setting == 0 || !Console_Number(number, &value) || value == 0 || value > 255)
+    {
+        Console_Write("set active|idle 1..255\r\n");
+        return;
+    }
+    *setting = (uint8_t)value;
+    SetActivePolling();
+}
+#endif
+
+const ConsoleCommand ConsoleCommands[] =
+{
+    { "stats", StatsCommand },      // Telemetry counters
+    { "tasks", TasksCommand },      // Scheduler periods, misses and worst cycles
+    { "state", StateCommand },      // USB state, pad, poll rates
+#if !PaddleEnabled
+    { "set",   SetCommand },        // Change a poll rate
+#endif
+};
+const uint8_t ConsoleCommandCount = sizeof(ConsoleCommands) / sizeof(ConsoleCommands[0]);
+#endif
+
+// The host has suspended the bus. Sleep, waking on the WDT to check the pad
+// and on bus activity (ACTVIF - the ISR takes the module out of suspend).
+// A new press wakes the host if it enabled remote wakeup; the press itself
+// is reported by PadTask() once the bus is back, as last_keypad_reading
+// isn't touched here.
+static void SuspendIO(void)
+{
+    LED_SetLow();   // The LED alone would blow the 2.5mA suspend budget
+
+    WDTCONbits.WDTPS = SUSPEND_WDTPS;
+    WDTCONbits.SWDTEN = 1;
+    SLEEP();
+    NOP();
+    WDTCONbits.SWDTEN = 0;
+
+    // Woken by the host
+    if (!IsUsbSuspended) return;
+
+    if (read_buttons() & ~last_keypad_reading & WAKE_BUTTONS)
+        SignalRemoteWakeup();
 }
 
 void main(void)
 {
+    // USB first so the pull-up is on (and the host's connect debounce
+    // running) while the rest starts up. Nothing here waits on the bus.
     InitializeSystem();
-    NES_GPIO_Initialize();
+    Telemetry_Reset();
+    Probe_Reset();
     InitializeUSB();
     EnableUSBModule();
     EnableInterrupts();
+    NES_GPIO_Initialize();
+    Scheduler_Initialize();
 
-    while(1) { ProcessIO(); }
+    while(1)
+    {
+        if (IsUsbSuspended) SuspendIO();
+        else Scheduler_Run(Tasks, TaskCount, FrameCount);
+    }
 }
@@ -30,6 +30,13 @@
 
 #include <htc.h>
 #include "Usb.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "probe.h"
+#include "record.h"
+#include "playback.h"
+
+#define _XTAL_FREQ 48000000L
 
 /***********************/
 /* Local Definitions   */
@@ -68,6 +75,22 @@
 #define SET_IDLE                    0x0A
 #define SET_PROTOCOL                0x0B
 
+// HIDPostProcess
+#define POST_OUTPUT_REPORT          0x01 // Keyboard output report in HIDRxBuffer
+#define POST_RECORD_CONTROL         0x02 // Recording stream on/off in ControlTransferBuffer
+#define POST_PLAYBACK_CONTROL       0x03 // Playback command in ControlTransferBuffer
+
+// CDC ACM Class specific requests (HID ones are all below these)
+#define SET_LINE_CODING             0x20
+#define GET_LINE_CODING             0x21
+#define SET_CONTROL_LINE_STATE      0x22
+
+// bmRequestType type bits (D6..5)
+#define REQUEST_TYPE_MASK           0x60
+#define STANDARD_REQUEST            0x00
+#define CLASS_REQUEST               0x20
+#define VENDOR_REQUEST              0x40
+
 // Standard Feature Selectors
 #define DEVICE_REMOTE_WAKEUP        0x01
 #define ENDPOINT_HALT               0x00
@@ -143,9 +166,21 @@ typedef struct _setupPacketStruct
     uint8_t wIndex0;       // LSB of wIndex
     uint8_t wIndex1;       // MSB of wIndex
     uint16_t wLength;       // Number of bytes to transfer if there's a data stage
-    uint8_t extra[1];      // Fill out to same size as Endpoint 0 max buffer (E0SZ-7)
+    uint8_t extra[E0SZ-7]; // Fill out to same size as Endpoint 0 max buffer (E0SZ-7)
 } setupPacketStruct;
 
+/***********************/
+/* Global Variables    */
+/***********************/
+
+uint8_t DeviceState;
+volatile uint8_t FrameCount;
+uint16_t EnumTimeline[ENUM_MILESTONES];
+volatile uint8_t HidIdleDue;
+#if CdcEnabled
+uint8_t CdcLineState;
+#endif
+
 /***********************/
 /* Local Variables     */
 /***********************/
@@ -155,37 +190,71 @@ uint8_t DeviceAddress;
 uint8_t SelfPowered;
 uint8_t CtrlTransferStage; // Holds the current stage in a control transfer
 uint8_t CurrentConfiguration;
-uint8_t HIDPostProcess;    // Set to 1 if HID needs to process after the data stage
+uint8_t HIDPostProcess;    // What to do after the data stage (POST_...), 0 = nothing
 uint8_t RequestHandled;    // Set to 1 if request was understood and processed.
 // HID Class variables
-uint8_t HidIdleRate;
+uint8_t HidIdleRate; // 4ms units, 0 = only report on change
+uint8_t HidIdleMs;   // 1ms pre-divider for HidIdleTicks
+uint8_t HidIdleTicks;// 4ms units since the last keyboard report
 uint8_t HidProtocol; // [0] Boot Protocol [1] Report Protocol
 uint8_t HidRxLen;    // # of bytes put into buffer
 
 const uint8_t *ROMoutPtr;  // Data to send to the host
 uint8_t *outPtr;           // Data to send to the host
 uint8_t *inPtr;            // Data from the host
+uint16_t inAddress;        // Where the data stage lands, a buffer in USB RAM
+uint8_t inSize;            // Room at inAddress for the data stage (0 = discard)
 uint8_t transferType;	// 0=ram 1=rom
 uint16_t wCount;            // Number of bytes of data
 
-volatile setupPacketStruct SetupPacket;
-volatile uint8_t ControlTransferBuffer[E0SZ];
-//TESTING!!!volatile uint8_t EndpointFlags[InterfaceCount] @ 0xE99; // Endpoint Flag Registers
-volatile uint8_t EndpointFlags[InterfaceCount] __at(0xE99); // Endpoint Flag Registers
+// Endpoint control registers for the HID endpoints (UEP1, UEP2, ...)
+#define EndpointFlags(i)    ((&UEP1)[i])
 
 // !!! It is ABSOLUTELY VITAL for the start of BDTs to point to 0x2000.
 // !!! Won't work without it.
 //TESTING!!!volatile Interface Interfaces[InterfaceCount + 1] @ 0x2000;
-volatile Interface Interfaces[InterfaceCount + 1] __at(0x2000);
+volatile Interface Interfaces[InterfaceCount + 1] __at(BdtAddress);
 // ... The hours I've waisted before I found out... :(
 
+// Everything else the SIE touches, right behind the BDT (see UsbDescriptors.h)
+volatile setupPacketStruct SetupPacket __at(SetupPacketAddress);
+volatile uint8_t ControlTransferBuffer[E0SZ] __at(ControlBufferAddress);
+volatile uint8_t HIDTxBuffer[HidReportByteCount] __at(HidTxAddress);
+volatile uint8_t HIDRxBuffer[HidReportByteCount] __at(HidRxAddress);
+#if MouseEnabled
+volatile uint8_t MouseTxBuffer[MouseReportByteCount] __at(MouseTxAddress);
+#endif
+#if VendorEnabled
+volatile uint8_t VendorTxBuffer[VendorReportByteCount] __at(VendorTxAddress);
+#endif
+#if PlaybackEnabled
+volatile uint8_t VendorRxBuffer[VendorReportByteCount] __at(VendorRxAddress);
+#endif
+#if CdcEnabled
+volatile uint8_t CdcTxBuffer[CdcPacketSize] __at(CdcTxAddress);
+volatile uint8_t CdcRxBuffer[CdcPacketSize] __at(CdcRxAddress);
+volatile uint8_t CdcLineCoding[CdcLineCodingByteCount] __at(CdcLineCodingAddress); // SET_LINE_CODING data stage
+#endif
+#if SnapshotEnabled
+volatile uint8_t HIDFeatureBuffer[HidFeatureByteCount]; // Only ever copied through EP0
+#endif
+
 
 /***********************/
 /* Implementation      */
 /***********************/
+
+// Record the current USB frame number (ms) for an enumeration milestone
+static void EnumMark(uint8_t milestone)
+{
+    EnumTimeline[milestone] = ((uint16_t)(UFRMH & 0x07) << 8) | UFRML;
+}
+
 uint8_t IsUsbDataAvaialble(uint8_t InterfaceNo)
 {
     if(InterfaceNo >= InterfaceCount) return 0;
+    // Output report delivered over EP0 (SET_REPORT)
+    if((InterfaceNo == HidInterfaceNumber) && HidRxLen) return HidRxLen;
     if(!(Interfaces[InterfaceNo + 1].Output.Stat & UOWN))
     {
         return Interfaces[InterfaceNo + 1].Output.Cnt;
@@ -199,10 +268,12 @@ void ReArmInterface(uint8_t InterfaceNo)
     //Indicate that we have processed it and get the endpoint
     //ready to receive next packet.
 
+    if(InterfaceNo == HidInterfaceNumber) HidRxLen = 0;
+
     if(!(Interfaces[InterfaceNo + 1].Output.Stat & UOWN))
     {
         //Interfaces[InterfaceNo + 1].Output.Cnt =  *BufferSizes[0];
-        Interfaces[InterfaceNo + 1].Output.Cnt =  Buffers[(InterfaceNo * 2) + 1].Size;
+        Interfaces[InterfaceNo + 1].Output.Cnt =  RxBufferSize(InterfaceNo);
         //Interfaces[InterfaceNo + 1].Output.Cnt =  sizeof(HIDRxBuffer);
 
   //      HIDRxBuffer
@@ -213,20 +284,56 @@ void ReArmInterface(uint8_t InterfaceNo)
     }
 }
 
+uint8_t IsHidTxReady(uint8_t InterfaceNo)
+{
+    // The buffer may only be touched while the CPU owns the IN descriptor
+    return !(Interfaces[InterfaceNo + 1].Input.Stat & UOWN);
+}
+
 void HIDSend(uint8_t InterfaceNo)
 {
+    PROBE_BEGIN(PROBE_HID_SEND);
+
     // If the CPU still owns the SIE, then don't try to send anything.
-    if (Interfaces[InterfaceNo + 1].Input.Stat & UOWN) return;
+    if (Interfaces[InterfaceNo + 1].Input.Stat & UOWN)
+    {
+        TELEMETRY_COUNT(Dropped);
+        PROBE_END(PROBE_HID_SEND);
+        return;
+    }
+    if (InterfaceNo == HidInterfaceNumber) Telemetry_Armed();
     // Toggle the data bit and give control to the SIE
 
     //Interfaces[InterfaceNo + 1].Input.Cnt = sizeof(HIDTxBuffer);
-    Interfaces[InterfaceNo + 1].Input.Cnt =  Buffers[InterfaceNo * 2].Size;
+    Interfaces[InterfaceNo + 1].Input.Cnt =  TxBufferSize(InterfaceNo);
 
     if(Interfaces[InterfaceNo + 1].Input.Stat & DTS)
         Interfaces[InterfaceNo + 1].Input.Stat = UOWN | DTSEN;
     else
         Interfaces[InterfaceNo + 1].Input.Stat = UOWN | DTS | DTSEN;
+
+    // A report just went out, so the idle period starts again
+    if (InterfaceNo == HidInterfaceNumber)
+    {
+        HidIdleTicks = 0;
+        HidIdleDue = 0;
+    }
+    PROBE_END(PROBE_HID_SEND);
+}
+
+#if CdcEnabled
+// Arm the console bulk IN endpoint with count (<= CdcPacketSize) bytes
+// of CdcTxBuffer. Check IsHidTxReady(CdcDataInterfaceNumber) first.
+void CdcSend(uint8_t count)
+{
+    Interfaces[CdcDataInterfaceNumber + 1].Input.Cnt = count;
+
+    if(Interfaces[CdcDataInterfaceNumber + 1].Input.Stat & DTS)
+        Interfaces[CdcDataInterfaceNumber + 1].Input.Stat = UOWN | DTSEN;
+    else
+        Interfaces[CdcDataInterfaceNumber + 1].Input.Stat = UOWN | DTS | DTSEN;
 }
+#endif
 
 // After configuration is complete, this routine is called to initialize
 // the endpoints (e.g., assign buffer addresses).
@@ -236,43 +343,90 @@ void HIDInitEndpoints(void)
 
     HidRxLen =0;
 
-    for (i = 0 ; i < InterfaceCount; i++)
+    for (i = 0 ; i < InterfaceCount; i++)  // loop:InitEndpoints
     {
-        // Turn on both in and out for this endpoint
-        EndpointFlags[i] = 0x1E;
-        //Interfaces[i+1].Output.Cnt = sizeof(HIDRxBuffer);
-        Interfaces[i + 1].Output.Cnt = Buffers[(i * 2) + 1].Size;
+        if (RxBufferSize(i) == 0)
+        {
+            // In only endpoint (i.e. Mouse)
+            EndpointFlags(i) = 0x1A;
+            Interfaces[i + 1].Output.Stat = 0x00;
+        }
+        else
+        {
+            // Turn on both in and out for this endpoint
+            EndpointFlags(i) = 0x1E;
+            //Interfaces[i+1].Output.Cnt = sizeof(HIDRxBuffer);
+            Interfaces[i + 1].Output.Cnt = RxBufferSize(i);
 
-        //Interfaces[i+1].Output.ADDR = PTR16(&HIDRxBuffer);
-        Interfaces[i + 1].Output.ADDR = PTR16(Buffers[(i * 2) + 1].Buffer);
+            //Interfaces[i+1].Output.ADDR = PTR16(&HIDRxBuffer);
+            Interfaces[i + 1].Output.ADDR = RxBufferAddress(i);
 
-        Interfaces[i + 1].Output.Stat = UOWN | DTSEN;
+            Interfaces[i + 1].Output.Stat = UOWN | DTSEN;
+        }
 
         //Interfaces[i + 1].Input.ADDR = PTR16(&HIDTxBuffer);
-        Interfaces[i + 1].Input.ADDR = PTR16(Buffers[(i * 2)].Buffer);
+        Interfaces[i + 1].Input.ADDR = TxBufferAddress(i);
         Interfaces[i + 1].Input.Stat = DTS;
     }
 }
 
-// Process HID specific requests
-void ProcessHIDRequest(void)
-{
-    uint8_t bRequest;
+// Request handlers. Each one is reached through RequestHandlers[] below,
+// so only the handler that matches the setup packet runs.
 
-     // Has to be to the HID interface
-    if((SetupPacket.bmRequestType & 0x1F) != 0x01 || (SetupPacket.wIndex0 != 0x00)) return;
+// Process GET_DESCRIPTOR (device and HID class descriptors)
+static void GetDescriptor(void)
+{
+    uint8_t descriptorType  = SetupPacket.wValue1;
+    uint8_t descriptorIndex = SetupPacket.wValue0;
 
-    bRequest = SetupPacket.bRequest;
+    if(SetupPacket.bmRequestType == 0x80)
+    {
+        if (descriptorType == DEVICE_DESCRIPTOR)
+        {
+                RequestHandled = 1;
+                ROMoutPtr = (const uint8_t *) & DeviceDescriptor;
+                wCount = sizeof(DeviceDescriptor);
+                transferType=1;
+        }
+        else if (descriptorType == CONFIGURATION_DESCRIPTOR)
+        {
+                RequestHandled = 1;
+                ROMoutPtr = (const uint8_t*)&ConfigurationDescriptor;
+                wCount = sizeof(ConfigurationDescriptor);
+		transferType=1;
+        }
+        else if (descriptorType == STRING_DESCRIPTOR)
+        {
+                RequestHandled = 1;
+                if(descriptorIndex >= StringDescriptorCount)
+                    ROMoutPtr = StringDescriptorPointers[0];
+                else
+                    ROMoutPtr = *(StringDescriptorPointers + descriptorIndex);
 
-    if (bRequest == GET_DESCRIPTOR)
+                wCount = *ROMoutPtr;
+		transferType=1;
+        }
+        else
+        {   // Unknown Descriptor
+        }
+    }
+    else if((SetupPacket.bmRequestType == 0x81) && (SetupPacket.wIndex0 < HidInterfaceCount))
     {
-        // Request for a descriptor.
-        uint8_t descriptorType  = SetupPacket.wValue1;
+        // Request for a HID class descriptor
         if (descriptorType == HID_DESCRIPTOR)
         {
+            // The class descriptor follows the 9 byte interface descriptor
             RequestHandled = 1;
-            ROMoutPtr = (const uint8_t*)&ConfigurationDescriptor.HIDDescriptor;
-            wCount = sizeof(ConfigurationDescriptor.HIDDescriptor);
+            ROMoutPtr = (const uint8_t*)&ConfigurationDescriptor.HIDDescriptor[9];
+#if MouseEnabled
+            if (SetupPacket.wIndex0 == MouseInterfaceNumber)
+                ROMoutPtr = (const uint8_t*)&ConfigurationDescriptor.MouseDescriptor[9];
+#endif
+#if VendorEnabled
+            if (SetupPacket.wIndex0 == VendorInterfaceNumber)
+                ROMoutPtr = (const uint8_t*)&ConfigurationDescriptor.VendorDescriptor[9];
+#endif
+            wCount = 9;
             transferType=1;
         }
         else if (descriptorType == REPORT_DESCRIPTOR)
@@ -280,103 +434,227 @@ void ProcessHIDRequest(void)
             RequestHandled = 1;
             ROMoutPtr = (const uint8_t*)HIDReport;
             wCount = sizeof(HIDReport);
+#if MouseEnabled
+            if (SetupPacket.wIndex0 == MouseInterfaceNumber)
+            {
+                ROMoutPtr = (const uint8_t*)MouseReport;
+                wCount = sizeof(MouseReport);
+            }
+#endif
+#if VendorEnabled
+            if (SetupPacket.wIndex0 == VendorInterfaceNumber)
+            {
+                ROMoutPtr = (const uint8_t*)VendorReport;
+                wCount = sizeof(VendorReport);
+            }
+#endif
             transferType=1;
         }
-        else if (descriptorType == PHYSICAL_DESCRIPTOR)
-        {   // Do Nothing
-        }
         else
-        {   // Unsupported Descriptor
+        {   // Unsupported (or Physical) Descriptor
         }
     }
+}
 
-    if ((SetupPacket.bmRequestType & 0x60) != 0x20)
+// HID GET_REPORT - the current input report, or the pad snapshot feature
+// report, straight from RAM without waiting for an interrupt transfer.
+static void GetReport(void)
+{
+    uint8_t reportType = SetupPacket.wValue1;
+
+    if (reportType == 0x01)
     {
-        return;
+        RequestHandled = 1;
+        outPtr = (uint8_t*)&HIDTxBuffer;
+        wCount = sizeof(HIDTxBuffer);
+#if MouseEnabled
+        if (SetupPacket.wIndex0 == MouseInterfaceNumber)
+        {
+            outPtr = (uint8_t*)&MouseTxBuffer;
+            wCount = sizeof(MouseTxBuffer);
+        }
+#endif
+#if VendorEnabled
+        if (SetupPacket.wIndex0 == VendorInterfaceNumber)
+        {
+            outPtr = (uint8_t*)&VendorTxBuffer;
+            wCount = sizeof(VendorTxBuffer);
+        }
+#endif
+        transferType=0;
     }
-
-    // HID-specific requests.
-    if (bRequest == GET_REPORT)
-    {   // Do Nothing
+#if SnapshotEnabled
+    else if ((reportType == 0x03) && (SetupPacket.wIndex0 == HidInterfaceNumber))
+    {
+        RequestHandled = 1;
+        outPtr = (uint8_t*)&HIDFeatureBuffer;
+        wCount = sizeof(HIDFeatureBuffer);
+        transferType=0;
     }
-
-    else if (bRequest == SET_REPORT)
+#endif
+#if VendorEnabled
+    // Telemetry, longer than one EP0 packet - sent from a copy so both
+    // packets come from the same moment
+    else if ((reportType == 0x03) && (SetupPacket.wIndex0 == VendorInterfaceNumber) &&
+             (SetupPacket.wValue0 == TELEMETRY_REPORT_ID))
     {
-        HIDPostProcess = 1;
         RequestHandled = 1;
+        Telemetry_Snapshot();
+        outPtr = (uint8_t*)&TelemetrySnapshot;
+        wCount = sizeof(TelemetrySnapshot);
+        transferType=0;
     }
-
-    else if (bRequest == GET_IDLE)
+#endif
+#if TraceEnabled
+    // Trace records, built in place - InDataStage() copies onto itself
+    else if ((reportType == 0x03) && (SetupPacket.wIndex0 == VendorInterfaceNumber) &&
+             (SetupPacket.wValue0 == TRACE_REPORT_ID))
     {
         RequestHandled = 1;
-        outPtr = &HidIdleRate;
-        wCount = 1;
+        outPtr = (uint8_t*)&ControlTransferBuffer;
+        wCount = Trace_Drain((uint8_t*)&ControlTransferBuffer, SetupPacket.wLength);
         transferType=0;
     }
-
-    else if (bRequest == SET_IDLE)
+#endif
+#if ProbesEnabled
+    else if ((reportType == 0x03) && (SetupPacket.wIndex0 == VendorInterfaceNumber) &&
+             (SetupPacket.wValue0 == PROBE_REPORT_ID))
     {
         RequestHandled = 1;
-        HidIdleRate = SetupPacket.wValue1;
+        outPtr = (uint8_t*)&Probes;
+        wCount = sizeof(Probes);
+        transferType=0;
     }
-
-    else if (bRequest == GET_PROTOCOL)
+#endif
+#if RecordEnabled
+    else if ((reportType == 0x03) && (SetupPacket.wIndex0 == VendorInterfaceNumber) &&
+             (SetupPacket.wValue0 == RECORD_CONTROL_ID))
     {
         RequestHandled = 1;
-        outPtr = &HidProtocol;
-        wCount = 1;
-	transferType=0;
+        ControlTransferBuffer[0] = RECORD_CONTROL_ID;
+        ControlTransferBuffer[1] = RecordOn;
+        outPtr = (uint8_t*)&ControlTransferBuffer;
+        wCount = RecordControlByteCount;
+        transferType=0;
     }
+#endif
+#if PlaybackEnabled
+    else if ((reportType == 0x03) && (SetupPacket.wIndex0 == VendorInterfaceNumber) &&
+             (SetupPacket.wValue0 == PLAYBACK_REPORT_ID))
+    {
+        RequestHandled = 1;
+        outPtr = (uint8_t*)&ControlTransferBuffer;
+        wCount = Playback_Status((uint8_t*)&ControlTransferBuffer);
+        transferType=0;
+    }
+#endif
+}
 
-    else if (bRequest == SET_PROTOCOL)
+// HID SET_REPORT
+static void SetReport(void)
+{
+    // Output report (LEDs) lands straight in HIDRxBuffer, the data
+    // stage BDT points there - no copy through ControlTransferBuffer.
+    if ((SetupPacket.wValue1 == 0x02) && (SetupPacket.wIndex0 == HidInterfaceNumber))
+    {
+        HIDPostProcess = POST_OUTPUT_REPORT;
+        RequestHandled = 1;
+        inAddress = HidRxAddress;
+        inSize = sizeof(HIDRxBuffer);
+    }
+#if RecordEnabled
+    // Two bytes, short enough to take from ControlTransferBuffer afterwards
+    else if ((SetupPacket.wValue1 == 0x03) && (SetupPacket.wIndex0 == VendorInterfaceNumber) &&
+             (SetupPacket.wValue0 == RECORD_CONTROL_ID))
+    {
+        HIDPostProcess = POST_RECORD_CONTROL;
+        RequestHandled = 1;
+    }
+#endif
+#if PlaybackEnabled
+    else if ((SetupPacket.wValue1 == 0x03) && (SetupPacket.wIndex0 == VendorInterfaceNumber) &&
+             (SetupPacket.wValue0 == PLAYBACK_REPORT_ID))
     {
+        HIDPostProcess = POST_PLAYBACK_CONTROL;
         RequestHandled = 1;
-        HidProtocol = SetupPacket.wValue0;
     }
+#endif
+}
 
-    else
-    {   // Unknown Request
+// HID GET_IDLE
+static void GetIdle(void)
+{
+    RequestHandled = 1;
+    outPtr = &HidIdleRate;
+    wCount = 1;
+    transferType=0;
+}
+
+// HID SET_IDLE
+static void SetIdle(void)
+{
+    RequestHandled = 1;
+    // Only the keyboard repeats reports, the others just acknowledge
+    if (SetupPacket.wIndex0 == HidInterfaceNumber)
+    {
+        HidIdleRate = SetupPacket.wValue1;
+        HidIdleMs = 0;
+        HidIdleTicks = 0;
+        HidIdleDue = 0;
     }
 }
 
-// Process GET_DESCRIPTOR
-static void GetDescriptor(void)
+// HID GET_PROTOCOL
+static void GetProtocol(void)
 {
-    if(SetupPacket.bmRequestType == 0x80)
+    RequestHandled = 1;
+    outPtr = &HidProtocol;
+    wCount = 1;
+    transferType=0;
+}
+
+// HID SET_PROTOCOL
+static void SetProtocol(void)
+{
+    RequestHandled = 1;
+    HidProtocol = SetupPacket.wValue0;
+}
+
+#if CdcEnabled
+// CDC SET_LINE_CODING - the host's baud rate etc. mean nothing to a USB
+// console, but terminals read them back, so keep what they set.
+static void SetLineCoding(void)
+{
+    if (SetupPacket.wIndex0 == CdcCommInterfaceNumber)
     {
-        uint8_t descriptorType  = SetupPacket.wValue1;
-        uint8_t descriptorIndex = SetupPacket.wValue0;
+        RequestHandled = 1;
+        inAddress = CdcLineCodingAddress;
+        inSize = sizeof(CdcLineCoding);
+    }
+}
 
-        if (descriptorType == DEVICE_DESCRIPTOR)
-        {
-                RequestHandled = 1;
-                ROMoutPtr = (const uint8_t *) & DeviceDescriptor;
-                wCount = sizeof(DeviceDescriptor);
-                transferType=1;
-        }
-        else if (descriptorType == CONFIGURATION_DESCRIPTOR)
-        {
-                RequestHandled = 1;
-                ROMoutPtr = (const uint8_t*)&ConfigurationDescriptor;
-                wCount = sizeof(ConfigurationDescriptor);
-		transferType=1;
-        }
-        else if (descriptorType == STRING_DESCRIPTOR)
-        {
-                RequestHandled = 1;
-                if(descriptorIndex >= StringDescriptorCount)
-                    ROMoutPtr = (const uint8_t*)&StringDescriptor0;
-                else
-                    ROMoutPtr = *(StringDescriptorPointers + descriptorIndex);
+// CDC GET_LINE_CODING
+static void GetLineCoding(void)
+{
+    if (SetupPacket.wIndex0 == CdcCommInterfaceNumber)
+    {
+        RequestHandled = 1;
+        outPtr = (uint8_t*)&CdcLineCoding;
+        wCount = sizeof(CdcLineCoding);
+        transferType=0;
+    }
+}
 
-                wCount = *ROMoutPtr;
-		transferType=1;
-        }
-        else
-        {   // Unknown Descriptor
-        }
+// CDC SET_CONTROL_LINE_STATE - DTR is how we know the port is open
+static void SetControlLineState(void)
+{
+    if (SetupPacket.wIndex0 == CdcCommInterfaceNumber)
+    {
+        RequestHandled = 1;
+        CdcLineState = SetupPacket.wValue0 & 0x03;
     }
 }
+#endif
 
 // Process GET_STATUS
 static void GetStatus(void)
@@ -407,13 +685,17 @@ static void GetStatus(void)
         // Endpoint
         uint8_t endpointNum = SetupPacket.wIndex0 & 0x0F;
         uint8_t endpointDir = SetupPacket.wIndex0 & 0x80;
+        // Only endpoints that have a BD, anything else STALLs
+        if (endpointNum > InterfaceCount)
+            return;
         RequestHandled = 1;
-        // Endpoint descriptors are 8 bytes long, with each in and out taking 4 bytes
-        // within the endpoint. (See PIC datasheet.)
-        inPtr = (uint8_t *)&Interfaces[0].Output + (endpointNum * 8);
+        // Each endpoint has an out then an in buffer descriptor (See PIC datasheet.)
         if (endpointDir)
-            inPtr += 4;
-        if(*inPtr & BSTALL)
+            inPtr = (uint8_t *)&Interfaces[endpointNum].Input;
+        else
+            inPtr = (uint8_t *)&Interfaces[endpointNum].Output;
+        // A BD the SIE handed back has the PID where BSTALL would be
+        if((*inPtr & (UOWN | BSTALL)) == (UOWN | BSTALL))
             ControlTransferBuffer[0] = 0x01;
     }
 
@@ -449,15 +731,15 @@ static void SetFeature(void)
         // Endpoint
         uint8_t endpointNum = SetupPacket.wIndex0 & 0x0F;
         uint8_t endpointDir = SetupPacket.wIndex0 & 0x80;
-        if ((feature == ENDPOINT_HALT) && (endpointNum != 0))
+        if ((feature == ENDPOINT_HALT) && (endpointNum != 0) && (endpointNum <= InterfaceCount))
         {
-            // Halt endpoint (as long as it isn't endpoint 0)
+            // Halt endpoint (as long as it isn't endpoint 0 and it has a BD)
             RequestHandled = 1;
-            // Endpoint descriptors are 8 bytes long, with each in and out taking 4 bytes
-            // within the endpoint. (See PIC datasheet.)
-            inPtr = (uint8_t *)&Interfaces[0].Output + (endpointNum * 8);
+            // Each endpoint has an out then an in buffer descriptor (See PIC datasheet.)
             if (endpointDir)
-                inPtr += 4;
+                inPtr = (uint8_t *)&Interfaces[endpointNum].Input;
+            else
+                inPtr = (uint8_t *)&Interfaces[endpointNum].Output;
 
             if(SetupPacket.bRequest == SET_FEATURE)
                 *inPtr = 0x84;
@@ -472,97 +754,154 @@ static void SetFeature(void)
     }
 }
 
-void ProcessStandardRequest(void)
+// Process SET_ADDRESS
+static void SetAddress(void)
 {
-    uint8_t request = SetupPacket.bRequest;
-
-    if((SetupPacket.bmRequestType & 0x60) != 0x00)
-        // Not a standard request - don't process here.  Class or Vendor
-        // requests have to be handled seperately.
-        return;
+    // Set the address of the device.  All future requests
+    // will come to that address.  Can't actually set UADDR
+    // to the new address yet because the rest of the SET_ADDRESS
+    // transaction uses address 0.
+    RequestHandled = 1;
+    DeviceState = ADDRESS;
+    DeviceAddress = SetupPacket.wValue0;
+}
 
-    if (request == SET_ADDRESS)
-    {
-            // Set the address of the device.  All future requests
-            // will come to that address.  Can't actually set UADDR
-            // to the new address yet because the rest of the SET_ADDRESS
-            // transaction uses address 0.
-            RequestHandled = 1;
-            DeviceState = ADDRESS;
-            DeviceAddress = SetupPacket.wValue0;
-    }
-    else if (request == GET_DESCRIPTOR)
-    {
-            GetDescriptor();
-    }
-    else if (request == SET_CONFIGURATION)
+// Process SET_CONFIGURATION
+static void SetConfiguration(void)
+{
+    RequestHandled = 1;
+    CurrentConfiguration = SetupPacket.wValue0;
+    // TBD: ensure the new configuration value is one that
+    // exists in the descriptor.
+    if (CurrentConfiguration == 0)
+        // If configuration value is zero, device is put in
+        // address state (USB 2.0 - 9.4.7)
+        DeviceState = ADDRESS;
+    else
     {
-            RequestHandled = 1;
-            CurrentConfiguration = SetupPacket.wValue0;
-            // TBD: ensure the new configuration value is one that
-            // exists in the descriptor.
-            if (CurrentConfiguration == 0)
-                // If configuration value is zero, device is put in
-                // address state (USB 2.0 - 9.4.7)
-                DeviceState = ADDRESS;
-            else
-            {
-                // Set the configuration.
-                DeviceState = CONFIGURED;
+        // Set the configuration.
+        DeviceState = CONFIGURED;
 
-                // Initialize the endpoints for all interfaces
-                HIDInitEndpoints();
+        // Initialize the endpoints for all interfaces
+        HIDInitEndpoints();
 
-                // TBD: Add initialization code here for any additional
-                // interfaces beyond the one used for the HID
-            }
-    }
-    else if (request == GET_CONFIGURATION)
-    {
-            RequestHandled = 1;
-            outPtr = (uint8_t*)&CurrentConfiguration;
-            wCount = 1;
-			transferType=0;
-    }
-    else if (request == GET_STATUS)
-    {
-            GetStatus();
-    }
-    else if ((request == CLEAR_FEATURE) ||
-        (request == SET_FEATURE))
-    {
-            SetFeature();
-    }
-    else if (request == GET_INTERFACE)
-    {
-            // No support for alternate interfaces.  Send
-            // zero back to the host.
-            RequestHandled = 1;
-            ControlTransferBuffer[0] = 0;
-            outPtr = (uint8_t*)&ControlTransferBuffer;
-            wCount = 1;
-			transferType=0;
-    }
-    else if (request == SET_INTERFACE)
-    {
-            // No support for alternate interfaces - just ignore.
-            RequestHandled = 1;
+        // The main loop has been sampling the pad since the bus reset, so
+        // the current report is already staged - arm it for the first poll.
+        HIDSend(HidInterfaceNumber);
+        EnumMark(ENUM_CONFIGURED);
+
+        // TBD: Add initialization code here for any additional
+        // interfaces beyond the one used for the HID
     }
-    else if (request == SET_DESCRIPTOR)
+}
+
+// Process GET_CONFIGURATION
+static void GetConfiguration(void)
+{
+    RequestHandled = 1;
+    outPtr = (uint8_t*)&CurrentConfiguration;
+    wCount = 1;
+    transferType=0;
+}
+
+// Process GET_INTERFACE
+static void GetInterface(void)
+{
+    // No support for alternate interfaces.  Send
+    // zero back to the host.
+    RequestHandled = 1;
+    ControlTransferBuffer[0] = 0;
+    outPtr = (uint8_t*)&ControlTransferBuffer;
+    wCount = 1;
+    transferType=0;
+}
+
+// Process SET_INTERFACE
+static void SetInterface(void)
+{
+    // No support for alternate interfaces - just ignore.
+    RequestHandled = 1;
+}
+
+// (bmRequestType type bits, bRequest) -> handler. Most frequent first, the
+// search stops at the first match. Anything not listed (SET_DESCRIPTOR,
+// SYNCH_FRAME, vendor requests...) is stalled.
+typedef struct _RequestHandler
+{
+    uint8_t Type;           // bmRequestType & REQUEST_TYPE_MASK
+    uint8_t Request;        // bRequest
+    void (*Handler)(void);
+} RequestHandler;
+
+const RequestHandler RequestHandlers[] =
+{
+    { STANDARD_REQUEST, GET_DESCRIPTOR,    GetDescriptor },
+    { STANDARD_REQUEST, SET_ADDRESS,       SetAddress },
+    { STANDARD_REQUEST, SET_CONFIGURATION, SetConfiguration },
+    { CLASS_REQUEST,    SET_IDLE,          SetIdle },
+    { CLASS_REQUEST,    SET_REPORT,        SetReport },
+    { STANDARD_REQUEST, GET_STATUS,        GetStatus },
+    { STANDARD_REQUEST, CLEAR_FEATURE,     SetFeature },
+    { STANDARD_REQUEST, SET_FEATURE,       SetFeature },
+    { STANDARD_REQUEST, GET_CONFIGURATION, GetConfiguration },
+    { STANDARD_REQUEST, GET_INTERFACE,     GetInterface },
+    { STANDARD_REQUEST, SET_INTERFACE,     SetInterface },
+    { CLASS_REQUEST,    GET_REPORT,        GetReport },
+    { CLASS_REQUEST,    GET_IDLE,          GetIdle },
+    { CLASS_REQUEST,    SET_PROTOCOL,      SetProtocol },
+    { CLASS_REQUEST,    GET_PROTOCOL,      GetProtocol },
+#if CdcEnabled
+    { CLASS_REQUEST,    SET_CONTROL_LINE_STATE, SetControlLineState },
+    { CLASS_REQUEST,    SET_LINE_CODING,   SetLineCoding },
+    { CLASS_REQUEST,    GET_LINE_CODING,   GetLineCoding },
+#endif
+};
+
+#define RequestHandlerCount (sizeof(RequestHandlers) / sizeof(RequestHandlers[0]))
+
+// Find and run the handler for the current setup packet. Class requests
+// have to be addressed to one of our interfaces - HID requests to the HID
+// ones, CDC requests to the CDC ones.
+static void ProcessRequest(void)
+{
+    uint8_t i;
+    uint8_t type = SetupPacket.bmRequestType & REQUEST_TYPE_MASK;
+    uint8_t request = SetupPacket.bRequest;
+
+    if (type == CLASS_REQUEST)
     {
+        if ((SetupPacket.bmRequestType & 0x1F) != 0x01) return;
+        if (SetupPacket.wIndex0 >= InterfaceCount) return;
+#if CdcEnabled
+        if ((SetupPacket.wIndex0 < HidInterfaceCount) == (request >= SET_LINE_CODING)) return;
+#endif
     }
-    else if (request == SYNCH_FRAME)
+
+    for (i = 0; i < RequestHandlerCount; i++)  // loop:RequestTable
     {
+        if ((RequestHandlers[i].Request == request) && (RequestHandlers[i].Type == type))
+        {
+            RequestHandlers[i].Handler();
+            return;
+        }
     }
-    else
+}
+// Copy n (> 0) bytes. A plain loop: XC8 keeps both pointers in FSR0/FSR1
+// and uses the moviw/movwi post increment modes itself, while hand written
+// moviw/movwi statements would clobber FSRs it may be holding values in.
+// src may be in RAM or flash - XC8 sets bit 15 on program memory pointers,
+// which is exactly how FSR reads from flash.
+static void BlockCopy(volatile uint8_t *dst, const uint8_t *src, uint8_t n)
+{
+    do  // loop:BlockCopy
     {
-    }
+        *dst++ = *src++;
+    } while (--n);
 }
 
 // Data stage for a Control Transfer that sends data to the host
 void InDataStage(void)
 {
-    uint8_t i;
     uint16_t bufferSize;
 
     // Determine how many bytes are going to the host
@@ -575,7 +914,7 @@ void InDataStage(void)
     Interfaces[0].Input.Stat &= ~(BC8 | BC9); // Clear BC8 and BC9
     Interfaces[0].Input.Stat |= (uint8_t)((bufferSize & 0x0300) >> 8);
     Interfaces[0].Input.Cnt = (uint8_t)(bufferSize & 0xFF);
-    Interfaces[0].Input.ADDR = PTR16(&ControlTransferBuffer);
+    Interfaces[0].Input.ADDR = ControlBufferAddress;
 
     // Update the number of bytes that still need to be sent.  Getting
     // all the data back to the host can take multiple transactions, so
@@ -583,28 +922,70 @@ void InDataStage(void)
     wCount = wCount - bufferSize;
 
     // Move data to the USB output buffer from wherever it sits now.
-    inPtr = (uint8_t *)&ControlTransferBuffer;
-	if(transferType==1) for(i=0;i<bufferSize;i++) *inPtr++ = *ROMoutPtr++;
-	else for(i=0;i<bufferSize;i++) *inPtr++ = *outPtr++;
+    if (bufferSize == 0) return;
+    if (transferType == 1)
+    {
+        BlockCopy(ControlTransferBuffer, ROMoutPtr, (uint8_t)bufferSize);
+        ROMoutPtr += bufferSize;
+    }
+    else
+    {
+        BlockCopy(ControlTransferBuffer, outPtr, (uint8_t)bufferSize);
+        outPtr += bufferSize;
+    }
 }
 
-// Data stage for a Control Transfer that reads data from the host
+// Data stage for a Control Transfer that reads data from the host.
+// The SIE has already written the data to its final place (see SetupStage),
+// so all that's left is bookkeeping.
 void OutDataStage(void)
 {
-    uint16_t i, bufferSize;
+    uint16_t bufferSize;
 
     bufferSize = ((0x03 & Interfaces[0].Output.Stat) << 8) | Interfaces[0].Output.Cnt;
 
     // Accumulate total number of bytes read
     wCount = wCount + bufferSize;
 
-    outPtr = (uint8_t*)&ControlTransferBuffer;
-
-    for (i=0;i<bufferSize;i++)
+    if (HIDPostProcess == POST_OUTPUT_REPORT)
+    {
+        HidRxLen = (uint8_t)bufferSize;
+    }
+#if RecordEnabled
+    else if ((HIDPostProcess == POST_RECORD_CONTROL) && (bufferSize >= RecordControlByteCount))
+    {
+        Record_Control(ControlTransferBuffer[1]);
+    }
+#endif
+#if PlaybackEnabled
+    else if ((HIDPostProcess == POST_PLAYBACK_CONTROL) && (bufferSize >= 2))
     {
-        *inPtr++ = *outPtr++;
+        Playback_Control(ControlTransferBuffer[1]);
     }
+#endif
+    HIDPostProcess = 0;
+
+    // Anything more (there shouldn't be) is dropped in ControlTransferBuffer,
+    // and once the data is in, a new SETUP has to land in SetupPacket.
+    inSize = 0;
+    Interfaces[0].Output.Cnt = E0SZ;
+    if (wCount >= SetupPacket.wLength)
+        Interfaces[0].Output.ADDR = SetupPacketAddress;
+    else
+        Interfaces[0].Output.ADDR = ControlBufferAddress;
+}
+
+#if TraceEnabled
+static uint8_t TraceQuiet;  // The control transfer in progress is a trace drain
+
+// GET_REPORT for the trace feature report, which empties the ring
+static uint8_t IsTraceDrain(void)
+{
+    return (SetupPacket.bmRequestType == 0xA1) && (SetupPacket.bRequest == GET_REPORT) &&
+           (SetupPacket.wValue1 == 0x03) && (SetupPacket.wValue0 == TRACE_REPORT_ID) &&
+           (SetupPacket.wIndex0 == VendorInterfaceNumber);
 }
+#endif
 
 // Process the Setup stage of a control transfer.  This code initializes the
 // flags that let the firmware know what to do during subsequent stages of
@@ -620,21 +1001,21 @@ void SetupStage(void)
     CtrlTransferStage = SETUP_STAGE;
     RequestHandled = 0; // Default is that request hasn't been handled
     HIDPostProcess = 0; // Assume standard request until know otherwise
+    inSize = 0;         // No destination for OUT data
     wCount = 0;         // No bytes transferred
+#if TraceEnabled
+    if (!TraceQuiet) Trace_Setup((const volatile uint8_t*)&SetupPacket);
+#endif
 
-    // See if this is a standard (as definded in USB chapter 9) request
-    ProcessStandardRequest();
-
-    // See if the HID class can do something with it.
-    ProcessHIDRequest();
-
-    // TBD: Add handlers for any other classes/interfaces in the device
+    // Standard (USB chapter 9) or HID class request - see RequestHandlers[]
+    ProcessRequest();
 
     if (!RequestHandled)
     {
+        TRACE(TRACE_REFUSED, SetupPacket.bmRequestType, SetupPacket.bRequest, 0, 0);
         // If this service wasn't handled then stall endpoint 0
         Interfaces[0].Output.Cnt = E0SZ;
-        Interfaces[0].Output.ADDR = PTR16(&SetupPacket);
+        Interfaces[0].Output.ADDR = SetupPacketAddress;
         Interfaces[0].Output.Stat = UOWN | BSTALL;
         Interfaces[0].Input.Stat = UOWN | BSTALL;
     }
@@ -647,11 +1028,11 @@ void SetupStage(void)
         CtrlTransferStage = DATA_IN_STAGE;
         // Reset the out buffer descriptor for endpoint 0
         Interfaces[0].Output.Cnt = E0SZ;
-        Interfaces[0].Output.ADDR = PTR16(&SetupPacket);
+        Interfaces[0].Output.ADDR = SetupPacketAddress;
         Interfaces[0].Output.Stat = UOWN;
 
         // Set the in buffer descriptor on endpoint 0 to send data
-        Interfaces[0].Input.ADDR = PTR16(&ControlTransferBuffer);
+        Interfaces[0].Input.ADDR = ControlBufferAddress;
         // Give to SIE, DATA1 packet, enable data toggle checks
         Interfaces[0].Input.Stat = UOWN | DTS | DTSEN;
     }
@@ -664,9 +1045,26 @@ void SetupStage(void)
         Interfaces[0].Input.Cnt = 0;
         Interfaces[0].Input.Stat = UOWN | DTS | DTSEN;
 
-        // Set the out buffer descriptor on endpoint 0 to receive data
-        Interfaces[0].Output.Cnt = E0SZ;
-        Interfaces[0].Output.ADDR = PTR16(&ControlTransferBuffer);
+        // Set the out buffer descriptor on endpoint 0 to receive data,
+        // straight into the destination when there is one. Clamp to the
+        // smaller of the request and the destination.
+        if (inSize)
+        {
+            if (SetupPacket.wLength < inSize)
+                Interfaces[0].Output.Cnt = (uint8_t)SetupPacket.wLength;
+            else
+                Interfaces[0].Output.Cnt = inSize;
+            Interfaces[0].Output.ADDR = inAddress;
+        }
+        else
+        {
+            Interfaces[0].Output.Cnt = E0SZ;
+            Interfaces[0].Output.ADDR = ControlBufferAddress;
+        }
+        // No data stage: the next thing on the OUT side is a SETUP, which
+        // may come before the status stage has been handled
+        if (SetupPacket.wLength == 0)
+            Interfaces[0].Output.ADDR = SetupPacketAddress;
         // Give to SIE, DATA1 packet, enable data toggle checks
         Interfaces[0].Output.Stat = UOWN | DTS | DTSEN;
     }
@@ -676,22 +1074,51 @@ void SetupStage(void)
 }
 
 // Configures the buffer descriptor for endpoint 0 so that it is waiting for
-// the status stage of a control transfer.
+// the setup stage of the next control transfer.
 void WaitForSetupStage(void)
 {
     CtrlTransferStage = SETUP_STAGE;
     Interfaces[0].Output.Cnt = E0SZ;
-    Interfaces[0].Output.ADDR = PTR16(&SetupPacket);
+    Interfaces[0].Output.ADDR = SetupPacketAddress;
     Interfaces[0].Output.Stat = UOWN | DTSEN; // Give to SIE, enable data toggle checks
     Interfaces[0].Input.Stat = 0x00;         // Give control to CPU
 }
 
+// Same at the end of a control transfer, but the host may have sent the
+// next SETUP already, right behind the status stage: then the OUT BD holds
+// it and its entry is still in the USTAT FIFO, so leave the BD alone. Not
+// after a bus reset - the FIFO is flushed and nothing would handle it.
+static void EndControlTransfer(void)
+{
+    if (((Interfaces[0].Output.Stat & UOWN) == 0) &&
+        (((Interfaces[0].Output.Stat & 0x3C) >> 2) == 0x0D))
+    {
+        CtrlTransferStage = SETUP_STAGE;
+        Interfaces[0].Input.Stat = 0x00;
+        return;
+    }
+    WaitForSetupStage();
+}
+
 // This is the starting point for processing a Control Transfer.  The code directly
 // follows the sequence of transactions described in the USB spec chapter 5.  The
 // only Control Pipe in this firmware is the Default Control Pipe (endpoint 0).
 // Control messages that have a different destination will be discarded.
 void ProcessControlTransfer(void)
 {
+#if TraceEnabled
+    // A new SETUP decides whether this transfer is traced: the drain
+    // request would otherwise leave records of itself in every report
+    if ((USTAT == 0) && (((Interfaces[0].Output.Stat & 0x3C) >> 2) == 0x0D))
+        TraceQuiet = IsTraceDrain();
+
+    // EP0 only - the interrupt endpoints would flood the ring
+    if (!TraceQuiet && (USTAT == 0))
+        TRACE(TRACE_TOKEN, USTAT, Interfaces[0].Output.Stat, CtrlTransferStage, Interfaces[0].Output.Cnt);
+    else if (!TraceQuiet && (USTAT == 0x04))
+        TRACE(TRACE_TOKEN, USTAT, Interfaces[0].Input.Stat, CtrlTransferStage, Interfaces[0].Input.Cnt);
+#endif
+
     if (USTAT == 0)
     {
         // Endpoint 0:out
@@ -710,7 +1137,7 @@ void ProcessControlTransfer(void)
         else
         {
             // Prepare for the Setup stage of a control transfer
-            WaitForSetupStage();
+            EndControlTransfer();
         }
     }
 
@@ -719,9 +1146,10 @@ void ProcessControlTransfer(void)
         // Endpoint 0:in
         if ((UADDR == 0) && (DeviceState == ADDRESS))
         {
-            // TBD: ensure that the new address matches the value of
-            // "deviceAddress" (which came in through a SET_ADDRESS).
-            UADDR = SetupPacket.wValue0;
+            // From SET_ADDRESS, not SetupPacket - the next SETUP may
+            // already be in there
+            UADDR = DeviceAddress;
+            EnumMark(ENUM_ADDRESS);
             if(UADDR == 0)
                 // If we get a reset after a SET_ADDRESS, then we need
                 // to drop back to the Default state.
@@ -742,7 +1170,7 @@ void ProcessControlTransfer(void)
         else
         {
             // Prepare for the Setup stage of a control transfer
-            WaitForSetupStage();
+            EndControlTransfer();
         }
     }
     else
@@ -769,6 +1197,16 @@ void InitializeUSB(void)
     UEIR = 0; // Clear all USB Error Interrupt Flags
     ResetPPBuffers();
     UCONbits.PKTDIS = 0;// Enable Packet Transfers
+#if CdcEnabled
+    // 115200 8N1 until a terminal sets something else
+    CdcLineCoding[0] = 0x00;
+    CdcLineCoding[1] = 0xC2;
+    CdcLineCoding[2] = 0x01;
+    CdcLineCoding[3] = 0x00;
+    CdcLineCoding[4] = 0x00;    // 1 stop bit
+    CdcLineCoding[5] = 0x00;    // No parity
+    CdcLineCoding[6] = 0x08;    // 8 data bits
+#endif
 }
 
 void EnableUSBModule(void)
@@ -783,15 +1221,17 @@ void EnableUSBModule(void)
         DeviceState = ATTACHED;
     }
 
-    while (UCONbits.SE0); //Single Ended Zero Is Set - Busywait for initial power-up
-
-    // If we are attached and no single-ended zero is detected, then
-    // we can move to the Powered state.
+    // No busy wait for SE0 to clear here - nothing happens until the host
+    // resets the bus anyway, and BusReset() takes us to DEFAULT from either
+    // state. Meanwhile the rest of the firmware can start up.
     UIR = 0;
     UIE = 0;
     UIEbits.URSTIE = 1; //USB Reset Interrupt Enable bit
     UIEbits.IDLEIE = 1; //Idle Detect Interrupt Enable bit
-    DeviceState = POWERED;
+
+    // If we are attached and no single-ended zero is detected, then
+    // we can move to the Powered state.
+    if (!UCONbits.SE0) DeviceState = POWERED;
 }
 
 // Unsuspend the device
@@ -802,21 +1242,49 @@ void UnSuspend(void)
     UIR &= 0xFB;
 }
 
+// Wake the host from suspend by driving RESUME signalling, as long as it
+// enabled remote wakeup (SET_FEATURE DEVICE_REMOTE_WAKEUP). Returns 1 if
+// the host was signalled.
+uint8_t SignalRemoteWakeup(void)
+{
+    if (!RemoteWakeup || !UCONbits.SUSPND) return 0;
+
+    UnSuspend();                // RESUME only works with the module awake
+    UCONbits.RESUME = 1;
+    __delay_ms(10);             // Drive K state for 1-15ms (USB 2.0 7.1.7.7)
+    UCONbits.RESUME = 0;
+    return 1;
+}
+
 // Full speed devices get a Start Of Frame (SOF) packet every 1 millisecond.
-// Nothing is currently done with this interrupt (it is simply masked out).
+// The main loop uses FrameCount as its 1ms time base, and the SET_IDLE
+// period is counted here so repeating a report costs no extra polling.
 void StartOfFrame(void)
 {
-    // TBD: Add a callback routine to do something
+    FrameCount++;
+    Telemetry_Sof();
+    Playback_Frame();
+
+    if (HidIdleRate != 0 && ++HidIdleMs >= 4)
+    {
+        HidIdleMs = 0;
+        if (++HidIdleTicks >= HidIdleRate)
+        {
+            HidIdleTicks = 0;
+            HidIdleDue = 1;
+        }
+    }
     UIRbits.SOFIF = 0;
 }
 
 // This routine is called in response to the code stalling an endpoint.
 void Stall(void)
 {
+    TRACE(TRACE_STALL, UEP0, 0, 0, 0);
     if(UEP0bits.EPSTALL == 1)
     {
         // Prepare for the Setup stage of a control transfer
-        WaitForSetupStage();
+        EndControlTransfer();
         UEP0bits.EPSTALL = 0;
     }
     UIRbits.STALLIF = 0;
@@ -825,6 +1293,7 @@ void Stall(void)
 // Suspend all processing until we detect activity on the USB bus
 void Suspend(void)
 {
+    TRACE(TRACE_SUSPEND, 0, 0, 0, 0);
     UIEbits.ACTVIE = 1;                     // Enable bus activity interrupt
     UIR &= 0xEF;
     UCONbits.SUSPND = 1;                   // Put USB module in power conserve
@@ -832,6 +1301,9 @@ void Suspend(void)
 
 void BusReset()
 {
+    uint8_t i;
+
+    TRACE(TRACE_RESET, UADDR, DeviceState, 0, 0);
     UEIR  = 0x00;
     UIR   = 0x00;
     UEIE  = 0x9f;
@@ -841,8 +1313,17 @@ void BusReset()
     // Set endpoint 0 as a control pipe
     UEP0 = 0x16;
 
+    // The interrupt endpoints stay off until SET_CONFIGURATION, so nothing
+    // armed in the old session goes out in the new one
+    for (i = 0; i < InterfaceCount; i++)  // loop:ResetEndpoints
+    {
+        EndpointFlags(i) = 0x00;
+        Interfaces[i + 1].Output.Stat = 0x00;
+        Interfaces[i + 1].Input.Stat = 0x00;
+    }
+
     // Flush any pending transactions
-    while (UIRbits.TRNIF == 1) UIRbits.TRNIF = 0;
+    while (UIRbits.TRNIF == 1) UIRbits.TRNIF = 0;  // loop:UstatFlush
 
     // Enable packet processing
     UCONbits.PKTDIS = 0;
@@ -852,13 +1333,43 @@ void BusReset()
 
     RemoteWakeup = 0;         // Remote wakeup is off by default
     SelfPowered = 0;          // Self powered is off by default
+    HidIdleRate = 0;          // Report on change only until the host says otherwise
+    HidIdleDue = 0;
+    HidProtocol = 1;          // Report protocol is the default (HID 1.11 7.2.6)
+    HidRxLen = 0;
     CurrentConfiguration = 0; // Clear active configuration
+    Record_Control(0);        // The host starts the recording stream again if it wants it
+    Playback_Control(PLAYBACK_STOP); // ... and playback
+#if CdcEnabled
+    CdcLineState = 0;         // Console closed until the host says otherwise
+#endif
     DeviceState = DEFAULT;
+    EnumMark(ENUM_RESET);
+    TELEMETRY_COUNT(BusResets);
 }
 
 // Main entry point for USB tasks.  Checks interrupts, then checks for transactions.
+//
+// Only sources that are both flagged and enabled are looked at (one read of
+// UIR and UIE), the per frame SOF is handled first and the rare sources
+// (idle, stall, error) are skipped with a single test.
+//
+// Worst case path (estimated from the instruction counts of the code below
+// at Fosc/4 = 12 MIPS): SOF + a SETUP that walks the whole RequestHandlers[]
+// table and answers with a full 64 byte EP0 packet:
+//   entry/exit + flag tests       ~  40 cycles
+//   StartOfFrame()                ~  30 cycles
+//   table walk (18, CdcEnabled)   ~ 380 cycles
+//   handler + SetupStage() BDTs   ~ 150 cycles
+//   BlockCopy() 64 bytes          ~ 320 cycles (5 per byte)
+//                                 ~ 920 cycles, ~77us
+// make budget has the worst case from the listing (tools/budget.py).
+// A plain SOF frame is ~70 cycles (~6us). NES_read_pad() only slows down
+// when preempted - the 4021 is static, so a longer clock phase is harmless.
 void ProcessUSBTransactions(void)
 {
+    uint8_t pending;
+
     // See if the device is connected yet.
     if(DeviceState == DETACHED)
     {
@@ -867,9 +1378,12 @@ void ProcessUSBTransactions(void)
 	return;
     }
 
+    pending = UIR & UIE;
+
     // If the USB became active then wake up from suspend
-    if(UIRbits.ACTVIF && UIEbits.ACTVIE)
+    if(pending & USB_RESUM)
     {
+        TRACE(TRACE_RESUME, 0, 0, 0, 0);
         UnSuspend();
 	ClearUsbInterruptFlag(USB_RESUM);
     }
@@ -883,39 +1397,51 @@ void ProcessUSBTransactions(void)
         return;
     }
 
-     // Process a bus reset
-    if (UIRbits.URSTIF && UIEbits.URSTIE)
+     // Process a bus reset - whatever else was pending belongs to the old
+     // session and was cleared along with it.
+    if (pending & USB_URST)
     {
+        PROBE_BEGIN(PROBE_USB_RESET);
         BusReset();
     	ClearUsbInterruptFlag(USB_URST);
+        UsbInterrupt = 0; // Clear Global Usb Interrupt Flag
+        PROBE_END(PROBE_USB_RESET);
+        return;
     }
 
-    if (UIRbits.IDLEIF && UIEbits.IDLEIE)
-    {
-        // No bus activity for a while - suspend the firmware
-        Suspend();
-    	ClearUsbInterruptFlag(USB_IDLE);
-    }
-
-    if (UIRbits.SOFIF && UIEbits.SOFIE)
+    if (pending & USB_SOF)
     {
+        PROBE_BEGIN(PROBE_USB_SOF);
         StartOfFrame();
         ClearUsbInterruptFlag(USB_SOF);
+        PROBE_END(PROBE_USB_SOF);
     }
 
-    if (UIRbits.STALLIF && UIEbits.STALLIE)
+    if (pending & (USB_IDLE | USB_STALL | USB_UERR))
     {
-        Stall();
-        ClearUsbInterruptFlag(USB_STALL);
-    }
+        PROBE_BEGIN(PROBE_USB_RARE);
+        if (pending & USB_IDLE)
+        {
+            // No bus activity for a while - suspend the firmware
+            Suspend();
+            ClearUsbInterruptFlag(USB_IDLE);
+        }
 
-    if (UIRbits.UERRIF && UIEbits.UERRIE)
-    {
-        // TBD: See where the error came from.
-        // Clear errors
-        UIRbits.UERRIF = 0;
-        UEIR = 0 ; //     Clear All Usb Error Interrupt Flags
-        ClearUsbInterruptFlag(USB_UERR);
+        if (pending & USB_STALL)
+        {
+            Stall();
+            ClearUsbInterruptFlag(USB_STALL);
+        }
+
+        if (pending & USB_UERR)
+        {
+            Telemetry_UsbErrors(UEIR & UEIE);
+            TRACE(TRACE_ERROR, UEIR, 0, 0, 0);
+            // Clear errors
+            UEIR = 0 ; //     Clear All Usb Error Interrupt Flags
+            ClearUsbInterruptFlag(USB_UERR);
+        }
+        PROBE_END(PROBE_USB_RARE);
     }
 
     // Unless we have been reset by the host, no need to keep processing
@@ -927,10 +1453,14 @@ void ProcessUSBTransactions(void)
     }
 
     // A transaction has finished.  Try default processing on endpoint 0.
-    if(UIRbits.TRNIF && UIEbits.TRNIE)
+    if(pending & USB_TRN)
     {
+        PROBE_BEGIN(PROBE_USB_TRN);
+        // Keyboard report collected by the host
+        if (USTAT == (((HidInterfaceNumber + 1) << 3) | 0x04)) Telemetry_Collected();
         ProcessControlTransfer();
         ClearUsbInterruptFlag(USB_TRN);
+        PROBE_END(PROBE_USB_TRN);
     }
     UsbInterrupt = 0; // Clear Global Usb Interrupt Flag
 }
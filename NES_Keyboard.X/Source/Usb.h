@@ -37,6 +37,7 @@
 #define MSB(x) ((x & 0xFF00) >> 8)
 #define ClearUsbInterruptFlag(x)        UIR &= ~(x)
 #define IsUsbReady ((DeviceState == 0x05) && (UCONbits.SUSPND==0))
+#define IsUsbSuspended (UCONbits.SUSPND==1)
 #define UsbInterrupt PIR2bits.USBIF
 #define VIDL LSB(VendorId)  // Vendor Id Low Byte (LSB)
 #define VIDH MSB(VendorId)  // Vendor Id High Byte (MSB)
@@ -47,31 +48,40 @@
 #define INTF InterfaceCount // Total Count of Interfaces
 #define IHID HidInterfaceNumber
 #define E0SZ Endpoint0BufferSize
+// Enumeration milestones (EnumTimeline)
+#define ENUM_RESET          0   // Bus reset
+#define ENUM_ADDRESS        1   // Address took effect
+#define ENUM_CONFIGURED     2   // SET_CONFIGURATION, first report armed
+#define ENUM_MILESTONES     3
 #define CONFIG_HEADER_SIZE      0x09 // Configuration descriptor header size (see UsbDescriptors.h) - Pretty much always 9 :)
 
 //#include <GenericTypeDefs.h>
 #include <stdint.h>
 
-// Structures
-typedef struct _BufferInfo
-{
-    uint8_t Size;
-    uint8_t *Buffer;
-} BufferInfo;
-
 // Includes
 #include "UsbDescriptors.h"
 
-// Global Variables
-uint8_t DeviceState;    // Visible device states (from USB 2.0, chap 9.1.1)
+// Global Variables (defined in Usb.c)
+extern uint8_t DeviceState;    // Visible device states (from USB 2.0, chap 9.1.1)
+extern volatile uint8_t FrameCount; // Incremented on every Start Of Frame (1ms)
+extern uint16_t EnumTimeline[ENUM_MILESTONES]; // USB frame number (ms) at each milestone
+extern volatile uint8_t HidIdleDue; // Set when the SET_IDLE period expires without a keyboard report
+#if CdcEnabled
+extern uint8_t CdcLineState;   // SET_CONTROL_LINE_STATE: [0] DTR (port open) [1] RTS
+#endif
 
 // USB Functions
 void InitializeUSB(void);
 void EnableUSBModule(void);
 void HIDSend(uint8_t InterfaceNo);
+uint8_t IsHidTxReady(uint8_t InterfaceNo);
 void ProcessUSBTransactions(void);
 void ReArmInterface(uint8_t InterfaceNo);
 uint8_t IsUsbDataAvaialble(uint8_t InterfaceNo);
+uint8_t SignalRemoteWakeup(void);
+#if CdcEnabled
+void CdcSend(uint8_t count);
+#endif
 
 #endif	/* USB_H */
 
@@ -0,0 +1,405 @@
+/*
+ * File:   UsbDescriptors.c
+ * Author: Szymon Roslowski
+ *
+ * Created on 13 October 2014, 18:44
+ *
+ * Device and configuration descriptors, the report descriptors and the
+ * strings. The sizes and the options they depend on are in
+ * UsbDescriptors.h, only Usb.c reads the tables.
+ */
+
+#include <stdint.h>
+#include <htc.h>
+#include "Usb.h"
+
+// Device Descriptor
+const uint8_t DeviceDescriptor[DeviceDescriptorSize]=
+{
+    0x12,   // Size of this descriptor in bytes
+    0x01,   // DEVICE descriptor type
+    0x00,   // USB Spec Release Number in BCD format LSB
+    0x02,   // USB Spec Release Number in BCD format MSB
+    DeviceClass,    // Class Code
+    DeviceSubClass, // Subclass code
+    DeviceProtocol, // Protocol code
+    E0SZ,   // Max packet size for EP0
+    VIDL,   // Vendor ID LSB
+    VIDH,   // Vendor ID MSB
+    PIDL,   // Product ID: Custom HID device demo LSB
+    PIDH,   // Product ID: Custom HID device demo MSB
+    RELL,   // Device release number in BCD format LSB
+    RELH,   // Device release number in BCD format MSB
+    SMAN,   // Manufacturer string index
+    SPRD,   // Product string index
+    SSER,   // Device serial number string index
+    0x01    // Number of possible configurations
+};
+
+#define HRBC HidReportByteCount
+
+// Configuration descriptor
+const ConfigStruct ConfigurationDescriptor =
+{
+    {
+        // Configuration descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x02,   // CONFIGURATION descriptor type
+    LSB(ConfigTotalLength),   // Total length of data for this cfg LSB
+    MSB(ConfigTotalLength),   // Total length of data for this cfg MSB
+    INTF,   // Number of interfaces in this cfg
+    0x01,   // Index value of this configuration
+    SCON,   // Configuration string index
+    0xA0,   // Attributes
+    0x32,   // Max power consumption (50 mA)
+    },
+    {
+        // Keyboard HID Interface descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x04,   // INTERFACE descriptor type
+    IHID,   // Interface Number
+    0x00,   // Alternate Setting Number
+    0x02,   // Number of endpoints in this interface
+    0x03,   // Class code (HID)
+    0x01,   // Subclass code (Sublass Boot(1) as opposed to NONE(0) the rest reserved)
+    0x01,   // Protocol code 0-none, 1-Keyboard, 2- Mouse
+    0x00,   // Interface String Descriptor Index
+
+
+        // Keyboard Class-Specific descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x21,   // HID descriptor type
+    0x11,   // HID Spec Release Number in BCD format (1.11) LSB
+    0x01,   // HID Spec Release Number in BCD format (1.11) MSB
+    0x00,   // Country Code (0x00 for Not supported)
+    0x01,   // Number of class descriptors
+    0x22,   // Report descriptor type
+    HidReportDescriptorSize,   // Report Size LSB
+    0x00,   // Report Size MSB
+
+    	// Keyboard Endpoint 1 In
+    0x07,   // Size of this descriptor in bytes
+    0x05,   // ENDPOINT descriptor type
+    0x81,   // Endpoint Address
+    0x03,   // Attributes (Interrupt)
+    HRBC,   // Max Packet Size LSB
+    0x00,   // Max Packet Size MSB
+    0x01,   // Interval (1 millisecond)
+
+    	// Keyboard Endpoint 1 Out
+    0x07,   // Size of this descriptor in bytes
+    0x05,   // ENDPOINT descriptor type
+    0x01,   // Endpoint Address
+    0x03,   // Attributes (Interrupt)
+    HRBC,   // Max Packet Size LSB
+    0x00,   // Max Packet Size MSB
+    0x01    // Interval (1 millisecond)
+    },
+#if MouseEnabled
+    {
+        // Mouse HID Interface descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x04,   // INTERFACE descriptor type
+    MouseInterfaceNumber,   // Interface Number
+    0x00,   // Alternate Setting Number
+    0x01,   // Number of endpoints in this interface
+    0x03,   // Class code (HID)
+    0x01,   // Subclass code (Boot)
+    0x02,   // Protocol code 0-none, 1-Keyboard, 2- Mouse
+    0x00,   // Interface String Descriptor Index
+
+        // Mouse Class-Specific descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x21,   // HID descriptor type
+    0x11,   // HID Spec Release Number in BCD format (1.11) LSB
+    0x01,   // HID Spec Release Number in BCD format (1.11) MSB
+    0x00,   // Country Code (0x00 for Not supported)
+    0x01,   // Number of class descriptors
+    0x22,   // Report descriptor type
+    MouseReportDescriptorSize,   // Report Size LSB  (50 bytes)
+    0x00,   // Report Size MSB
+
+    	// Mouse Endpoint 2 In
+    0x07,   // Size of this descriptor in bytes
+    0x05,   // ENDPOINT descriptor type
+    0x82,   // Endpoint Address
+    0x03,   // Attributes (Interrupt)
+    MouseReportByteCount,   // Max Packet Size LSB
+    0x00,   // Max Packet Size MSB
+    0x01    // Interval (1 millisecond)
+    },
+#endif
+#if VendorEnabled
+    {
+        // Vendor HID Interface descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x04,   // INTERFACE descriptor type
+    VendorInterfaceNumber,   // Interface Number
+    0x00,   // Alternate Setting Number
+    0x01 + PlaybackEnabled,  // Number of endpoints in this interface
+    0x03,   // Class code (HID)
+    0x00,   // Subclass code (None)
+    0x00,   // Protocol code 0-none, 1-Keyboard, 2- Mouse
+    0x00,   // Interface String Descriptor Index
+
+        // Vendor Class-Specific descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x21,   // HID descriptor type
+    0x11,   // HID Spec Release Number in BCD format (1.11) LSB
+    0x01,   // HID Spec Release Number in BCD format (1.11) MSB
+    0x00,   // Country Code (0x00 for Not supported)
+    0x01,   // Number of class descriptors
+    0x22,   // Report descriptor type
+    VendorReportDescriptorSize,   // Report Size LSB
+    0x00,   // Report Size MSB
+
+    	// Vendor Endpoint In
+    0x07,   // Size of this descriptor in bytes
+    0x05,   // ENDPOINT descriptor type
+    0x81 + VendorInterfaceNumber,   // Endpoint Address
+    0x03,   // Attributes (Interrupt)
+    VendorReportByteCount,   // Max Packet Size LSB
+    0x00,   // Max Packet Size MSB
+    VendorInterval, // Interval (1 or 10 milliseconds)
+#if PlaybackEnabled
+    	// Vendor Endpoint Out
+    0x07,   // Size of this descriptor in bytes
+    0x05,   // ENDPOINT descriptor type
+    0x01 + VendorInterfaceNumber,   // Endpoint Address
+    0x03,   // Attributes (Interrupt)
+    VendorReportByteCount,   // Max Packet Size LSB
+    0x00,   // Max Packet Size MSB
+    0x01    // Interval (1 millisecond)
+#endif
+    },
+#endif
+#if CdcEnabled
+    {
+        // Interface Association descriptor
+    0x08,   // Size of this descriptor in bytes
+    0x0B,   // INTERFACE ASSOCIATION descriptor type
+    CdcCommInterfaceNumber, // First interface
+    0x02,   // Interface count
+    0x02,   // Function class (CDC)
+    0x02,   // Function subclass (ACM)
+    0x01,   // Function protocol (AT commands)
+    0x00,   // Function String Descriptor Index
+
+        // CDC Communication Interface descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x04,   // INTERFACE descriptor type
+    CdcCommInterfaceNumber, // Interface Number
+    0x00,   // Alternate Setting Number
+    0x01,   // Number of endpoints in this interface
+    0x02,   // Class code (CDC)
+    0x02,   // Subclass code (ACM)
+    0x01,   // Protocol code (AT commands)
+    0x00,   // Interface String Descriptor Index
+
+        // CDC Header functional descriptor
+    0x05,   // Size of this descriptor in bytes
+    0x24,   // CS_INTERFACE descriptor type
+    0x00,   // Header
+    0x10,   // CDC Release Number in BCD format (1.10) LSB
+    0x01,   // CDC Release Number in BCD format (1.10) MSB
+
+        // CDC Call Management functional descriptor
+    0x05,   // Size of this descriptor in bytes
+    0x24,   // CS_INTERFACE descriptor type
+    0x01,   // Call Management
+    0x00,   // Capabilities (no call management)
+    CdcDataInterfaceNumber, // Data interface
+
+        // CDC Abstract Control Management functional descriptor
+    0x04,   // Size of this descriptor in bytes
+    0x24,   // CS_INTERFACE descriptor type
+    0x02,   // Abstract Control Management
+    0x02,   // Capabilities (line coding and control line state)
+
+        // CDC Union functional descriptor
+    0x05,   // Size of this descriptor in bytes
+    0x24,   // CS_INTERFACE descriptor type
+    0x06,   // Union
+    CdcCommInterfaceNumber, // Control interface
+    CdcDataInterfaceNumber, // Subordinate interface
+
+        // CDC Notification Endpoint In
+    0x07,   // Size of this descriptor in bytes
+    0x05,   // ENDPOINT descriptor type
+    0x81 + CdcCommInterfaceNumber, // Endpoint Address
+    0x03,   // Attributes (Interrupt)
+    CdcNotifyByteCount, // Max Packet Size LSB
+    0x00,   // Max Packet Size MSB
+    0xFF,   // Interval (255 milliseconds)
+
+        // CDC Data Interface descriptor
+    0x09,   // Size of this descriptor in bytes
+    0x04,   // INTERFACE descriptor type
+    CdcDataInterfaceNumber, // Interface Number
+    0x00,   // Alternate Setting Number
+    0x02,   // Number of endpoints in this interface
+    0x0A,   // Class code (CDC Data)
+    0x00,   // Subclass code
+    0x00,   // Protocol code
+    0x00,   // Interface String Descriptor Index
+
+        // CDC Data Endpoint Out
+    0x07,   // Size of this descriptor in bytes
+    0x05,   // ENDPOINT descriptor type
+    0x01 + CdcDataInterfaceNumber, // Endpoint Address
+    0x02,   // Attributes (Bulk)
+    CdcPacketSize, // Max Packet Size LSB
+    0x00,   // Max Packet Size MSB
+    0x00,   // Interval (ignored for bulk)
+
+        // CDC Data Endpoint In
+    0x07,   // Size of this descriptor in bytes
+    0x05,   // ENDPOINT descriptor type
+    0x81 + CdcDataInterfaceNumber, // Endpoint Address
+    0x02,   // Attributes (Bulk)
+    CdcPacketSize, // Max Packet Size LSB
+    0x00,   // Max Packet Size MSB
+    0x00    // Interval (ignored for bulk)
+    },
+#endif
+};
+
+// Report For Keyboard
+const uint8_t HIDReport[HidReportDescriptorSize] = {
+    0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
+    0x09, 0x06,                    // USAGE (Keyboard)
+    0xa1, 0x01,                    // COLLECTION (Application)
+    0x05, 0x07,                    //   USAGE_PAGE (Keyboard)
+    0x19, 0xe0,                    //   USAGE_MINIMUM (Keyboard LeftControl)
+    0x29, 0xe7,                    //   USAGE_MAXIMUM (Keyboard Right GUI)
+    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
+    0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
+    0x75, 0x01,                    //   REPORT_SIZE (1)
+    0x95, 0x08,                    //   REPORT_COUNT (8)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+    0x95, 0x01,                    //   REPORT_COUNT (1)
+    0x75, 0x08,                    //   REPORT_SIZE (8)
+    0x81, 0x03,                    //   INPUT (Cnst,Var,Abs)
+    0x95, 0x05,                    //   REPORT_COUNT (5)
+    0x75, 0x01,                    //   REPORT_SIZE (1)
+    0x05, 0x08,                    //   USAGE_PAGE (LEDs)
+    0x19, 0x01,                    //   USAGE_MINIMUM (Num Lock)
+    0x29, 0x05,                    //   USAGE_MAXIMUM (Kana)
+    0x91, 0x02,                    //   OUTPUT (Data,Var,Abs)
+    0x95, 0x01,                    //   REPORT_COUNT (1)
+    0x75, 0x03,                    //   REPORT_SIZE (3)
+    0x91, 0x03,                    //   OUTPUT (Cnst,Var,Abs)
+    0x95, 0x06,                    //   REPORT_COUNT (6)
+    0x75, 0x08,                    //   REPORT_SIZE (8)
+    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
+    0x25, 0x65,                    //   LOGICAL_MAXIMUM (101)
+    0x05, 0x07,                    //   USAGE_PAGE (Keyboard)
+    0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))
+    0x29, 0x65,                    //   USAGE_MAXIMUM (Keyboard Application)
+    0x81, 0x00,                    //   INPUT (Data,Ary,Abs)
+#if SnapshotEnabled
+    0x06, 0x00, 0xff,              //   USAGE_PAGE (Vendor Defined Page 1)
+    0x09, 0x01,                    //   USAGE (Vendor Usage 1)
+    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
+    0x26, 0xff, 0x00,              //   LOGICAL_MAXIMUM (255)
+    0x75, 0x08,                    //   REPORT_SIZE (8)
+    0x95, HidFeatureByteCount,     //   REPORT_COUNT (5)
+    0xb1, 0x03,                    //   FEATURE (Cnst,Var,Abs) - read only, SET_REPORT stalls
+#endif
+    0xc0                           // END_COLLECTION
+};
+
+#if MouseEnabled
+// Report For Mouse (Boot Protocol compatible)
+const uint8_t MouseReport[MouseReportDescriptorSize] = {
+    0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
+    0x09, 0x02,                    // USAGE (Mouse)
+    0xa1, 0x01,                    // COLLECTION (Application)
+    0x09, 0x01,                    //   USAGE (Pointer)
+    0xa1, 0x00,                    //   COLLECTION (Physical)
+    0x05, 0x09,                    //     USAGE_PAGE (Button)
+    0x19, 0x01,                    //     USAGE_MINIMUM (Button 1)
+    0x29, 0x03,                    //     USAGE_MAXIMUM (Button 3)
+    0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
+    0x25, 0x01,                    //     LOGICAL_MAXIMUM (1)
+    0x95, 0x03,                    //     REPORT_COUNT (3)
+    0x75, 0x01,                    //     REPORT_SIZE (1)
+    0x81, 0x02,                    //     INPUT (Data,Var,Abs)
+    0x95, 0x01,                    //     REPORT_COUNT (1)
+    0x75, 0x05,                    //     REPORT_SIZE (5)
+    0x81, 0x03,                    //     INPUT (Cnst,Var,Abs)
+    0x05, 0x01,                    //     USAGE_PAGE (Generic Desktop)
+    0x09, 0x30,                    //     USAGE (X)
+    0x09, 0x31,                    //     USAGE (Y)
+    0x15, 0x81,                    //     LOGICAL_MINIMUM (-127)
+    0x25, 0x7f,                    //     LOGICAL_MAXIMUM (127)
+    0x75, 0x08,                    //     REPORT_SIZE (8)
+    0x95, 0x02,                    //     REPORT_COUNT (2)
+    0x81, 0x06,                    //     INPUT (Data,Var,Rel)
+    0xc0,                          //   END_COLLECTION
+    0xc0                           // END_COLLECTION
+};
+#endif
+
+#if VendorEnabled
+// Report For the Vendor Interface - telemetry is read as a feature report
+const uint8_t VendorReport[VendorReportDescriptorSize] = {
+    0x06, 0x00, 0xff,              // USAGE_PAGE (Vendor Defined Page 1)
+    0x09, 0x02,                    // USAGE (Vendor Usage 2)
+    0xa1, 0x01,                    // COLLECTION (Application)
+    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
+    0x26, 0xff, 0x00,              //   LOGICAL_MAXIMUM (255)
+    0x75, 0x08,                    //   REPORT_SIZE (8)
+    0x85, 0x01,                    //   REPORT_ID (1)
+    0x09, 0x01,                    //   USAGE (Vendor Usage 1)
+    0x95, VendorReportByteCount - 1, //   REPORT_COUNT (63)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+    0x09, 0x02,                    //   USAGE (Vendor Usage 2)
+    0x95, TelemetryReportByteCount - 1, // REPORT_COUNT (73)
+    0xb1, 0x02,                    //   FEATURE (Data,Var,Abs)
+#if TraceEnabled
+    0x85, 0x02,                    //   REPORT_ID (2)
+    0x09, 0x03,                    //   USAGE (Vendor Usage 3)
+    0x95, TraceReportByteCount - 1, //   REPORT_COUNT (59 with 64 byte EP0)
+    0xb1, 0x02,                    //   FEATURE (Data,Var,Abs)
+#endif
+#if ProbesEnabled
+    0x85, 0x03,                    //   REPORT_ID (3)
+    0x09, 0x04,                    //   USAGE (Vendor Usage 4)
+    0x95, ProbeReportByteCount - 1, //   REPORT_COUNT (70)
+    0xb1, 0x02,                    //   FEATURE (Data,Var,Abs)
+#endif
+#if RecordEnabled
+    0x85, 0x04,                    //   REPORT_ID (4)
+    0x09, 0x05,                    //   USAGE (Vendor Usage 5)
+    0x95, RecordControlByteCount - 1, // REPORT_COUNT (1)
+    0xb1, 0x02,                    //   FEATURE (Data,Var,Abs)
+#endif
+#if PlaybackEnabled
+    0x85, 0x05,                    //   REPORT_ID (5)
+    0x09, 0x06,                    //   USAGE (Vendor Usage 6)
+    0x95, VendorReportByteCount - 1, //   REPORT_COUNT (63)
+    0x91, 0x02,                    //   OUTPUT (Data,Var,Abs)
+    0x09, 0x07,                    //   USAGE (Vendor Usage 7)
+    0x95, PlaybackStatusByteCount - 1, // REPORT_COUNT (8)
+    0xb1, 0x02,                    //   FEATURE (Data,Var,Abs)
+#endif
+    0xc0                           // END_COLLECTION
+};
+#endif
+
+static const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[1];}StringDescriptor0={sizeof(StringDescriptor0),0x03,{0x0409}};
+
+static const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[13];}StringDescriptor1={sizeof(StringDescriptor1),0x03,
+{'J','o','e',' ','O','s','t','r','a','n','d','e','r'}};
+
+static const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[12];}StringDescriptor2={sizeof(StringDescriptor2),0x03,
+{'N','E','S',' ','K','e','y','b','o','a','r','d'}};
+
+//Array of string descriptors
+const uint8_t *const StringDescriptorPointers[StringDescriptorCount]=
+{
+    (const uint8_t *const)&StringDescriptor0,
+    (const uint8_t *const)&StringDescriptor1,
+    (const uint8_t *const)&StringDescriptor2
+};
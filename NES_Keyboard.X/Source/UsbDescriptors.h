@@ -19,14 +19,104 @@
 #define ProductId   0x01A6
 #define ReleaseNo   0x0001
 
+// Optional Interfaces
+#ifndef MouseEnabled
+#define MouseEnabled            0    // Set to 1 to add a boot mouse interface driven by the D-pad (see nes_mouse.c)
+#endif
+#ifndef SnapshotEnabled
+#define SnapshotEnabled         1    // Keyboard feature report with the raw pad byte, frame and sequence number
+#endif
+#ifndef VendorEnabled
+#define VendorEnabled           0    // Set to 1 to add a vendor defined HID interface for field telemetry (see telemetry.h)
+#endif
+#ifndef TraceEnabled
+#define TraceEnabled            0    // USB event trace ring, drained through the vendor interface (see trace.h)
+#endif
+#ifndef ProbesEnabled
+#define ProbesEnabled           0    // Cycle probes on the hot paths, read through the vendor interface (see probe.h)
+#endif
+#ifndef RecordEnabled
+#define RecordEnabled           0    // Pad recording stream on the vendor interface IN endpoint (see record.h)
+#endif
+#ifndef PlaybackEnabled
+#define PlaybackEnabled         0    // Host fed button timeline replayed as the pad, vendor interface OUT endpoint (see playback.h)
+#endif
+#ifndef CdcEnabled
+#define CdcEnabled              0    // CDC-ACM debug console next to the keyboard (see console.c)
+#endif
+#if (TraceEnabled || ProbesEnabled || RecordEnabled || PlaybackEnabled) && !VendorEnabled
+#error "TraceEnabled, ProbesEnabled, RecordEnabled and PlaybackEnabled need VendorEnabled"
+#endif
+
 // Definitions
-#define InterfaceCount          0x01 // One Interface - Just Keyboard
-#define StringDescriptorCount   0x03 // Three string descriptors - See Bottom of this file
-#define Endpoint0BufferSize     0x08 // Endpoint 0 Buffer Size
+#define InterfaceCount          (0x01 + MouseEnabled + VendorEnabled + (CdcEnabled * 2)) // Keyboard, then the optional ones
+#define StringDescriptorCount   0x03 // Three string descriptors - See UsbDescriptors.c
+#ifndef Endpoint0BufferSize
+#define Endpoint0BufferSize     0x40 // Endpoint 0 Buffer Size (8, 16, 32 or 64) - 64 sends every descriptor in one transaction
+#endif
+#define DeviceDescriptorSize    0x12 // Size Of Device Descriptor
 #define HidDescriptorSize       0x20 // Size Of HID Descriptor
+#if (Endpoint0BufferSize != 8) && (Endpoint0BufferSize != 16) && (Endpoint0BufferSize != 32) && (Endpoint0BufferSize != 64)
+#error "Endpoint0BufferSize must be 8, 16, 32 or 64"
+#endif
 // HID
 #define HidReportByteCount      0x08 // Hid Report Size, also size of Buffers etc. ( Memory usage can go over the roof if not careful with this value)
 #define HidInterfaceNumber      0x00 // Interface For our HID
+#define HidFeatureByteCount     0x05 // Snapshot: Pad, Frame LSB/MSB, Sequence LSB/MSB
+#if SnapshotEnabled
+#define HidReportDescriptorSize 0x4F // 63 byte keyboard + 16 byte feature
+#else
+#define HidReportDescriptorSize 0x3F
+#endif
+// Mouse
+#define MouseDescriptorSize     0x19 // Size Of Mouse Interface, HID and Endpoint Descriptors
+#define MouseReportDescriptorSize 0x32 // Boot mouse report descriptor
+#define MouseReportByteCount    0x03 // Boot Mouse Report: Buttons, X, Y
+#define MouseInterfaceNumber    0x01 // Interface For the Mouse (Endpoint 2)
+// Vendor
+#define VendorDescriptorSize    (0x19 + (PlaybackEnabled * 7)) // Size Of Vendor Interface, HID and Endpoint Descriptors
+#define VendorReportByteCount   0x40 // Input report: ID + 63 bytes (the recording stream, see record.h)
+#define VendorReportDescriptorSize (0x1D + (TraceEnabled * 8) + (ProbesEnabled * 8) + (RecordEnabled * 8) + \
+                                    (PlaybackEnabled * 14)) // Telemetry, then 8 bytes per optional feature (14 for playback)
+#if RecordEnabled
+#define VendorInterval          0x01 // Recording stream, up to one report per frame
+#else
+#define VendorInterval          0x0A // Nothing is sent, poll rarely
+#endif
+#define VendorInterfaceNumber   (0x01 + MouseEnabled) // Last interface (Endpoint 2 or 3)
+#define TelemetryReportByteCount 0x4A // Feature report ID 1, see TelemetryReport in telemetry.h
+#define TraceRecordsPerReport   ((E0SZ - 4) / 8) // Feature report ID 2 fits one EP0 packet
+#define TraceReportByteCount    (4 + (TraceRecordsPerReport * 8))
+#define ProbeReportByteCount    0x47 // Feature report ID 3, see ProbeReport in probe.h
+#define RecordControlByteCount  0x02 // Feature report ID 4: ID, streaming on/off
+#define PlaybackStatusByteCount 0x09 // Feature report ID 5, see playback.h (the output report is ID 5 too)
+#if TraceEnabled && (Endpoint0BufferSize < 16)
+#error "TraceEnabled needs Endpoint0BufferSize of at least 16"
+#endif
+// CDC-ACM console - communication interface (notification endpoint) then
+// data interface (bulk endpoints), tied together by an IAD
+#define CdcDescriptorSize       0x42 // IAD, both interfaces, functional and endpoint descriptors
+#define CdcCommInterfaceNumber  (0x01 + MouseEnabled + VendorEnabled)
+#define CdcDataInterfaceNumber  (CdcCommInterfaceNumber + 1)
+#define HidInterfaceCount       (InterfaceCount - (CdcEnabled * 2)) // The HID ones come first
+#define CdcNotifyByteCount      0x08 // Notification endpoint (never sent)
+#define CdcPacketSize           0x20 // Bulk endpoint max packet size
+#define CdcLineCodingByteCount  0x07 // dwDTERate, bCharFormat, bParityType, bDataBits
+
+// A composite device with an IAD has to say so in the device descriptor
+#if CdcEnabled
+#define DeviceClass             0xEF // Miscellaneous
+#define DeviceSubClass          0x02 // Common Class
+#define DeviceProtocol          0x01 // Interface Association Descriptor
+#else
+#define DeviceClass             0x00 // Defined by the interfaces
+#define DeviceSubClass          0x00
+#define DeviceProtocol          0x00
+#endif
+
+#define ConfigTotalLength       (CONFIG_HEADER_SIZE + HidDescriptorSize + \
+                                 (MouseEnabled * MouseDescriptorSize) + (VendorEnabled * VendorDescriptorSize) + \
+                                 (CdcEnabled * CdcDescriptorSize))
 
 // Strings
 #define SMAN 0x01   // Manufacturer Name String Index
@@ -34,162 +124,98 @@
 #define SSER 0x00   // Serial Number String Index
 #define SCON 0x00   // Configuration String Index
 
-// Actual USB Data Buffers
-volatile uint8_t HIDRxBuffer[HidReportByteCount];
-volatile uint8_t HIDTxBuffer[HidReportByteCount];
-
-BufferInfo Buffers[(InterfaceCount * 2)] =
-{
-    { HidReportByteCount, (uint8_t*)&HIDTxBuffer },
-    { HidReportByteCount, (uint8_t*)&HIDRxBuffer }
-};
+// USB dual-port RAM layout (linear addresses). Everything the SIE reads or
+// writes is packed behind the BDT, which has to start at 0x2000, so the
+// endpoint setup is all constants and the linker can't move a buffer out of
+// reach. Only the first 8 bytes of the setup packet are accessed directly,
+// the rest of each buffer goes through FSRs so bank crossings don't matter.
+#define UsbRamStart             0x2000
+#define UsbRamEnd               0x21FF
+#define BdtAddress              UsbRamStart
+#define SetupPacketAddress      (BdtAddress + ((InterfaceCount + 1) * 8))
+#define ControlBufferAddress    (SetupPacketAddress + E0SZ + 1)
+#define HidTxAddress            (ControlBufferAddress + E0SZ)
+#define HidRxAddress            (HidTxAddress + HidReportByteCount)
+#define MouseTxAddress          (HidRxAddress + HidReportByteCount)
+#define VendorTxAddress         (MouseTxAddress + (MouseEnabled * MouseReportByteCount))
+#define VendorRxAddress         (VendorTxAddress + (VendorEnabled * VendorReportByteCount))
+#define CdcNotifyAddress        (VendorRxAddress + (PlaybackEnabled * VendorReportByteCount))
+#define CdcTxAddress            (CdcNotifyAddress + (CdcEnabled * CdcNotifyByteCount))
+#define CdcRxAddress            (CdcTxAddress + (CdcEnabled * CdcPacketSize))
+#define CdcLineCodingAddress    (CdcRxAddress + (CdcEnabled * CdcPacketSize))
+#define UsbRamUsed              (CdcLineCodingAddress + (CdcEnabled * CdcLineCodingByteCount))
+#if UsbRamUsed > (UsbRamEnd + 1)
+#error "USB buffers don't fit in dual-port RAM"
+#endif
+
+// Endpoint buffers per interface: Tx (IN) then Rx (OUT). A zero sized Rx
+// buffer means the interface has an IN endpoint only.
+#define IsMouseInterface(i)     (MouseEnabled && ((i) == MouseInterfaceNumber))
+#define IsVendorInterface(i)    (VendorEnabled && ((i) == VendorInterfaceNumber))
+#define IsCdcComm(i)            (CdcEnabled && ((i) == CdcCommInterfaceNumber))
+#define IsCdcData(i)            (CdcEnabled && ((i) == CdcDataInterfaceNumber))
+#define TxBufferSize(i)         (IsCdcData(i) ? CdcPacketSize : IsCdcComm(i) ? CdcNotifyByteCount : \
+                                 IsVendorInterface(i) ? VendorReportByteCount : \
+                                 IsMouseInterface(i) ? MouseReportByteCount : HidReportByteCount)
+#define TxBufferAddress(i)      (IsCdcData(i) ? CdcTxAddress : IsCdcComm(i) ? CdcNotifyAddress : \
+                                 IsVendorInterface(i) ? VendorTxAddress : \
+                                 IsMouseInterface(i) ? MouseTxAddress : HidTxAddress)
+#define RxBufferSize(i)         (IsCdcData(i) ? CdcPacketSize : \
+                                 IsVendorInterface(i) ? (PlaybackEnabled * VendorReportByteCount) : \
+                                 (IsCdcComm(i) || IsMouseInterface(i)) ? 0 : HidReportByteCount)
+#define RxBufferAddress(i)      (IsCdcData(i) ? CdcRxAddress : IsVendorInterface(i) ? VendorRxAddress : HidRxAddress)
+
+// Actual USB Data Buffers (defined in Usb.c)
+extern volatile uint8_t HIDRxBuffer[HidReportByteCount];
+extern volatile uint8_t HIDTxBuffer[HidReportByteCount];
+#if SnapshotEnabled
+extern volatile uint8_t HIDFeatureBuffer[HidFeatureByteCount];
+#endif
+#if MouseEnabled
+extern volatile uint8_t MouseTxBuffer[MouseReportByteCount];
+#endif
+#if VendorEnabled
+extern volatile uint8_t VendorTxBuffer[VendorReportByteCount];
+#endif
+#if PlaybackEnabled
+extern volatile uint8_t VendorRxBuffer[VendorReportByteCount];
+#endif
+#if CdcEnabled
+extern volatile uint8_t CdcTxBuffer[CdcPacketSize];
+extern volatile uint8_t CdcRxBuffer[CdcPacketSize];
+extern volatile uint8_t CdcLineCoding[CdcLineCodingByteCount];
+#endif
 
 /***********************/
 /* Descriptors         */
 /***********************/
 
-// Device Descriptor
-const uint8_t DeviceDescriptor[]=
-{
-    0x12,   // Size of this descriptor in bytes
-    0x01,   // DEVICE descriptor type
-    0x00,   // USB Spec Release Number in BCD format LSB
-    0x02,   // USB Spec Release Number in BCD format MSB
-    0x00,   // Class Code
-    0x00,   // Subclass code
-    0x00,   // Protocol code
-    E0SZ,   // Max packet size for EP0 (8)
-    VIDL,   // Vendor ID LSB
-    VIDH,   // Vendor ID MSB
-    PIDL,   // Product ID: Custom HID device demo LSB
-    PIDH,   // Product ID: Custom HID device demo MSB
-    RELL,   // Device release number in BCD format LSB
-    RELH,   // Device release number in BCD format MSB
-    SMAN,   // Manufacturer string index
-    SPRD,   // Product string index
-    SSER,   // Device serial number string index
-    0x01    // Number of possible configurations
-};
-
-// ...Stuck these here to keep the number of files to minimum
-#define HRBC HidReportByteCount
 typedef struct _configStruct
 {
     uint8_t configHeader[CONFIG_HEADER_SIZE];
     uint8_t HIDDescriptor[HidDescriptorSize];
+#if MouseEnabled
+    uint8_t MouseDescriptor[MouseDescriptorSize];
+#endif
+#if VendorEnabled
+    uint8_t VendorDescriptor[VendorDescriptorSize];
+#endif
+#if CdcEnabled
+    uint8_t CdcDescriptor[CdcDescriptorSize];
+#endif
 } ConfigStruct;
 
-// Configuration descriptor
-const ConfigStruct ConfigurationDescriptor =
-{
-    {
-        // Configuration descriptor
-    0x09,   // Size of this descriptor in bytes
-    0x02,   // CONFIGURATION descriptor type
-    0x29,   // Total length of data for this cfg LSB
-    0x00,   // Total length of data for this cfg MSB
-    INTF,   // Number of interfaces in this cfg
-    0x01,   // Index value of this configuration
-    SCON,   // Configuration string index
-    0xA0,   // Attributes
-    0x32,   // Max power consumption (50 mA)
-    },
-    {
-        // Keyboard HID Interface descriptor
-    0x09,   // Size of this descriptor in bytes
-    0x04,   // INTERFACE descriptor type
-    IHID,   // Interface Number
-    0x00,   // Alternate Setting Number
-    0x02,   // Number of endpoints in this interface
-    0x03,   // Class code (HID)
-    0x01,   // Subclass code (Sublass Boot(1) as opposed to NONE(0) the rest reserved)
-    0x01,   // Protocol code 0-none, 1-Keyboard, 2- Mouse
-    0x00,   // Interface String Descriptor Index
-
-
-        // Keyboard Class-Specific descriptor
-    0x09,   // Size of this descriptor in bytes
-    0x21,   // HID descriptor type
-    0x11,   // HID Spec Release Number in BCD format (1.11) LSB
-    0x01,   // HID Spec Release Number in BCD format (1.11) MSB
-    0x00,   // Country Code (0x00 for Not supported)
-    0x01,   // Number of class descriptors
-    0x22,   // Report descriptor type
-    0x3F,   // Report Size LSB  (63 bytes)
-    0x00,   // Report Size MSB
-
-    	// Keyboard Endpoint 1 In
-    0x07,   // Size of this descriptor in bytes
-    0x05,   // ENDPOINT descriptor type
-    0x81,   // Endpoint Address
-    0x03,   // Attributes (Interrupt)
-    HRBC,   // Max Packet Size LSB
-    0x00,   // Max Packet Size MSB
-    0x01,   // Interval (1 millisecond)
-
-    	// Keyboard Endpoint 1 Out
-    0x07,   // Size of this descriptor in bytes
-    0x05,   // ENDPOINT descriptor type
-    0x01,   // Endpoint Address
-    0x03,   // Attributes (Interrupt)
-    HRBC,   // Max Packet Size LSB
-    0x00,   // Max Packet Size MSB
-    0x01    // Interval (1 millisecond)
-    }
-};
-
-// Report For Keyboard
-const uint8_t HIDReport[] = {
-    0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
-    0x09, 0x06,                    // USAGE (Keyboard)
-    0xa1, 0x01,                    // COLLECTION (Application)
-    0x05, 0x07,                    //   USAGE_PAGE (Keyboard)
-    0x19, 0xe0,                    //   USAGE_MINIMUM (Keyboard LeftControl)
-    0x29, 0xe7,                    //   USAGE_MAXIMUM (Keyboard Right GUI)
-    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
-    0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
-    0x75, 0x01,                    //   REPORT_SIZE (1)
-    0x95, 0x08,                    //   REPORT_COUNT (8)
-    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
-    0x95, 0x01,                    //   REPORT_COUNT (1)
-    0x75, 0x08,                    //   REPORT_SIZE (8)
-    0x81, 0x03,                    //   INPUT (Cnst,Var,Abs)
-    0x95, 0x05,                    //   REPORT_COUNT (5)
-    0x75, 0x01,                    //   REPORT_SIZE (1)
-    0x05, 0x08,                    //   USAGE_PAGE (LEDs)
-    0x19, 0x01,                    //   USAGE_MINIMUM (Num Lock)
-    0x29, 0x05,                    //   USAGE_MAXIMUM (Kana)
-    0x91, 0x02,                    //   OUTPUT (Data,Var,Abs)
-    0x95, 0x01,                    //   REPORT_COUNT (1)
-    0x75, 0x03,                    //   REPORT_SIZE (3)
-    0x91, 0x03,                    //   OUTPUT (Cnst,Var,Abs)
-    0x95, 0x06,                    //   REPORT_COUNT (6)
-    0x75, 0x08,                    //   REPORT_SIZE (8)
-    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
-    0x25, 0x65,                    //   LOGICAL_MAXIMUM (101)
-    0x05, 0x07,                    //   USAGE_PAGE (Keyboard)
-    0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))
-    0x29, 0x65,                    //   USAGE_MAXIMUM (Keyboard Application)
-    0x81, 0x00,                    //   INPUT (Data,Ary,Abs)
-    0xc0                           // END_COLLECTION
-};
-
-
-const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[1];}StringDescriptor0={sizeof(StringDescriptor0),0x03,{0x0409}};
-
-const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[13];}StringDescriptor1={sizeof(StringDescriptor1),0x03,
-{'J','o','e',' ','O','s','t','r','a','n','d','e','r'}};
-
-const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[12];}StringDescriptor2={sizeof(StringDescriptor2),0x03,
-{'N','E','S',' ','K','e','y','b','o','a','r','d'}};
-
-//Array of string descriptors
-const uint8_t *const StringDescriptorPointers[StringDescriptorCount]=
-{
-    (const uint8_t *const)&StringDescriptor0,
-    (const uint8_t *const)&StringDescriptor1,
-    (const uint8_t *const)&StringDescriptor2
-};
+// The tables themselves are in UsbDescriptors.c
+extern const uint8_t DeviceDescriptor[DeviceDescriptorSize];
+extern const ConfigStruct ConfigurationDescriptor;
+extern const uint8_t HIDReport[HidReportDescriptorSize];
+#if MouseEnabled
+extern const uint8_t MouseReport[MouseReportDescriptorSize];
+#endif
+#if VendorEnabled
+extern const uint8_t VendorReport[VendorReportDescriptorSize];
+#endif
+extern const uint8_t *const StringDescriptorPointers[StringDescriptorCount];
 
 #endif	/* USBDESCRIPTORS_H */
 
@@ -0,0 +1,79 @@
+/*
+ * File:   board.h
+ *
+ * Pin assignments for each NES Keyboard PCB revision. Everything here is a
+ * compile time constant, the helper macros expand to the same single bit
+ * LATx/PORTx accesses that used to be written by hand.
+ *
+ * Select the board with BOARD_REV (make BOARD_REV=1 ..., or the board-v1 /
+ * board-v2 targets in the project Makefile).
+ */
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#ifndef BOARD_REV
+#define BOARD_REV 2
+#endif
+
+#if BOARD_REV == 1
+// v1 pcb had latch and clock on swapped pins!
+#define BOARD_DATA_BIT      3   // RC3 - pad data (input)
+#define BOARD_LATCH_BIT     5   // RC5 - pad latch (output)
+#define BOARD_CLK_BIT       4   // RC4 - pad clock (output)
+#define BOARD_POT_BIT       2   // RC2 - Vaus potentiometer data (input)
+#define BOARD_LED_BIT       4   // RA4 - status LED
+#define BOARD_LED_ON        1   // LED polarity (level that lights it)
+#elif BOARD_REV == 2
+#define BOARD_DATA_BIT      3   // RC3 - pad data (input)
+#define BOARD_LATCH_BIT     4   // RC4 - pad latch (output)
+#define BOARD_CLK_BIT       5   // RC5 - pad clock (output)
+#define BOARD_POT_BIT       2   // RC2 - Vaus potentiometer data (input)
+#define BOARD_LED_BIT       4   // RA4 - status LED
+#define BOARD_LED_ON        1   // LED polarity (level that lights it)
+#else
+#error "Unknown BOARD_REV"
+#endif
+
+// Pad lines all live on PORTC, the LED on PORTA
+#define BOARD_DATA          C, BOARD_DATA_BIT
+#define BOARD_LATCH         C, BOARD_LATCH_BIT
+#define BOARD_CLK           C, BOARD_CLK_BIT
+#define BOARD_POT           C, BOARD_POT_BIT
+#define BOARD_LED           A, BOARD_LED_BIT
+
+// Direct wired buttons (GpioInputEnabled) - port sample (pa = PORTA,
+// pc = PORTC) and bit for each button. Active low.
+#define GPIO_PIN_A          pc, 0
+#define GPIO_PIN_B          pc, 1
+#define GPIO_PIN_SELECT     pc, 2
+#define GPIO_PIN_START      pa, 5
+#define GPIO_PIN_UP         pc, 3
+#define GPIO_PIN_DOWN       pc, 4
+#define GPIO_PIN_LEFT       pc, 5
+#define GPIO_PIN_RIGHT      pa, 3
+
+// Sanity check the assignment - two functions on one pin is always a typo
+#if (BOARD_DATA_BIT == BOARD_LATCH_BIT) || (BOARD_DATA_BIT == BOARD_CLK_BIT) || \
+    (BOARD_LATCH_BIT == BOARD_CLK_BIT) || (BOARD_POT_BIT == BOARD_DATA_BIT) || \
+    (BOARD_POT_BIT == BOARD_LATCH_BIT) || (BOARD_POT_BIT == BOARD_CLK_BIT)
+#error "Pad pins overlap"
+#endif
+#if (BOARD_LED_BIT == 0) || (BOARD_LED_BIT == 1) || (BOARD_LED_BIT == 3)
+#error "LED can't go on RA0/RA1 (USB) or RA3 (input only)"
+#endif
+#if (BOARD_DATA_BIT > 5) || (BOARD_LATCH_BIT > 5) || (BOARD_CLK_BIT > 5) || (BOARD_POT_BIT > 5)
+#error "PORTC only has RC0..RC5"
+#endif
+
+// Single bit accessors: PIN_LAT(BOARD_CLK) -> LATCbits.LATC5 etc.
+#define PIN_LAT(pin)            PIN_LAT_(pin)
+#define PIN_LAT_(port, bit)     LAT##port##bits.LAT##port##bit
+#define PIN_PORT(pin)           PIN_PORT_(pin)
+#define PIN_PORT_(port, bit)    PORT##port##bits.R##port##bit
+#define PIN_TRIS(pin)           PIN_TRIS_(pin)
+#define PIN_TRIS_(port, bit)    TRIS##port##bits.TRIS##port##bit
+#define PIN_ANSEL(pin)          PIN_ANSEL_(pin)
+#define PIN_ANSEL_(port, bit)   ANSEL##port##bits.ANS##port##bit
+
+#endif /* BOARD_H */
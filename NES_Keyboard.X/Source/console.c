@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <htc.h>
+#include "Usb.h"
+#include "console.h"
+
+#if CdcEnabled
+
+#define ConsoleOpen     (IsUsbReady && (CdcLineState & 0x01))
+
+uint8_t ConsoleRing[CONSOLE_RING];
+uint8_t ConsoleHead;        // Next byte written
+uint8_t ConsoleTail;        // Next byte sent
+char ConsoleLine[CONSOLE_LINE + 1];
+uint8_t ConsoleLength;
+uint8_t ConsoleFullPacket;  // Last packet out was CdcPacketSize bytes
+
+static void Console_Put(char c)
+{
+    uint8_t next = (ConsoleHead + 1) & (CONSOLE_RING - 1);
+
+    if (next == ConsoleTail) return;    // Full - drop it
+    ConsoleRing[ConsoleHead] = (uint8_t)c;
+    ConsoleHead = next;
+}
+
+void Console_Write(const char *text)
+{
+    while (*text) Console_Put(*text++);
+}
+
+void Console_Hex(uint8_t value)
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    Console_Put(digits[value >> 4]);
+    Console_Put(digits[value & 0x0F]);
+}
+
+void Console_Decimal(uint16_t value)
+{
+    char digits[5];
+    uint8_t n = 0;
+
+    do
+    {
+        digits[n++] = '0' + (char)(value % 10);
+        value /= 10;
+    } while (value);
+
+    while (n) Console_Put(digits[--n]);
+}
+
+// Parse an unsigned decimal, returns 0 if there isn't one
+uint8_t Console_Number(const char *text, uint16_t *value)
+{
+    uint16_t result = 0;
+
+    if (*text < '0' || *text > '9') return 0;
+    while (*text >= '0' && *text <= '9') result = result * 10 + (uint16_t)(*text++ - '0');
+    if (*text) return 0;
+
+    *value = result;
+    return 1;
+}
+
+// If text starts with word (followed by a space or the end), return what
+// comes after it, otherwise 0
+const char *Console_Word(const char *text, const char *word)
+{
+    while (*word && *word == *text)
+    {
+        word++;
+        text++;
+    }
+    if (*word) return 0;
+    if (*text == ' ') return text + 1;
+    if (*text) return 0;
+    return text;
+}
+
+static void Console_Help(void)
+{
+    uint8_t i;
+
+    Console_Write("help");
+    for (i = 0; i < ConsoleCommandCount; i++)
+    {
+        Console_Put(' ');
+        Console_Write(ConsoleCommands[i].Name);
+    }
+    Console_Write("\r\n");
+}
+
+// Run the command in ConsoleLine: the name, then optionally a space and
+// its arguments
+static void Console_Execute(void)
+{
+    uint8_t i;
+    const char *arguments;
+
+    if (ConsoleLength == 0) return;
+
+    if (Console_Word(ConsoleLine, "help"))
+    {
+        Console_Help();
+        return;
+    }
+
+    for (i = 0; i < ConsoleCommandCount; i++)
+    {
+        arguments = Console_Word(ConsoleLine, ConsoleCommands[i].Name);
+        if (arguments == 0) continue;
+
+        ConsoleCommands[i].Run(arguments);
+        return;
+    }
+
+    Console_Write("? try help\r\n");
+}
+
+// Line editing with echo: Enter runs the line, backspace takes a
+// character back, anything past CONSOLE_LINE is ignored
+static void Console_Receive(uint8_t count)
+{
+    uint8_t i;
+    char c;
+
+    for (i = 0; i < count; i++)
+    {
+        c = (char)CdcRxBuffer[i];
+        if (c == '\r' || c == '\n')
+        {
+            // CR LF from the terminal is one Enter, not two
+            if (c == '\n' && ConsoleLength == 0) continue;
+            Console_Write("\r\n");
+            ConsoleLine[ConsoleLength] = 0;
+            Console_Execute();
+            ConsoleLength = 0;
+            Console_Write("> ");
+        }
+        else if (c == 0x08 || c == 0x7F)
+        {
+            if (ConsoleLength == 0) continue;
+            ConsoleLength--;
+            Console_Write("\b \b");
+        }
+        else if (c >= ' ' && ConsoleLength < CONSOLE_LINE)
+        {
+            ConsoleLine[ConsoleLength++] = c;
+            Console_Put(c);
+        }
+    }
+}
+
+// Scheduler task: commands in, ring out, one packet each way per run
+void ConsoleTask(void)
+{
+    uint8_t count;
+
+    if (!ConsoleOpen)
+    {
+        // Nobody listening - start clean next time the port opens
+        ConsoleHead = ConsoleTail;
+        ConsoleLength = 0;
+        ConsoleFullPacket = 0;
+        return;
+    }
+
+    // A zero length packet from the host still hands the buffer back, so
+    // re-arm whenever the CPU owns it, not only when there were bytes
+    count = IsUsbDataAvaialble(CdcDataInterfaceNumber);
+    if (count) Console_Receive(count);
+    ReArmInterface(CdcDataInterfaceNumber);
+
+    if (!IsHidTxReady(CdcDataInterfaceNumber)) return;
+    if (ConsoleHead == ConsoleTail)
+    {
+        // A full packet doesn't end the host's read - a zero length one does
+        if (ConsoleFullPacket) CdcSend(0);
+        ConsoleFullPacket = 0;
+        return;
+    }
+
+    count = 0;
+    while (ConsoleTail != ConsoleHead && count < CdcPacketSize)
+    {
+        CdcTxBuffer[count++] = ConsoleRing[ConsoleTail];
+        ConsoleTail = (ConsoleTail + 1) & (CONSOLE_RING - 1);
+    }
+    ConsoleFullPacket = (count == CdcPacketSize);
+    CdcSend(count);
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+
+/*
+    Line based debug console on the CDC-ACM interface (CdcEnabled, see
+    UsbDescriptors.h). Open the port (/dev/ttyACMn, any baud rate), type a
+    command and Enter; "help" lists them.
+
+    Output goes into a CONSOLE_RING byte ring and ConsoleTask() moves it to
+    the bulk IN endpoint, one packet per frame, only while the host has the
+    port open (DTR set). With the port closed ConsoleTask() returns at once
+    and nothing is written, so the console costs nothing in the input path.
+    A full ring drops the rest of the text rather than wait.
+
+    The commands themselves live with the state they show, in
+    ConsoleCommands[] (Main.c). A handler gets whatever followed the
+    command name and a space, or an empty string; Console_Word() and
+    Console_Number() pick that apart.
+
+    Include after Usb.h (CdcEnabled).
+*/
+
+#ifndef CONSOLE_RING
+#define CONSOLE_RING        128     // Power of two
+#endif
+#define CONSOLE_LINE        32      // Longest command line
+
+typedef struct _ConsoleCommand
+{
+    const char *Name;
+    void (*Run)(const char *arguments);
+} ConsoleCommand;
+
+#if CdcEnabled
+
+extern const ConsoleCommand ConsoleCommands[];
+extern const uint8_t ConsoleCommandCount;
+
+void ConsoleTask(void);
+void Console_Write(const char *text);
+void Console_Hex(uint8_t value);
+void Console_Decimal(uint16_t value);
+uint8_t Console_Number(const char *text, uint16_t *value);
+const char *Console_Word(const char *text, const char *word);
+
+#endif
+
+#endif /* CONSOLE_H */
@@ -1,18 +1,23 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <pic16f1455.h>
+#include "board.h"
 #include "nes_keyboard.h"
 
 #include <xc.h>
 
 #define _XTAL_FREQ 48000000L
 
-#define DATA_Get()      (PORTCbits.RC3 & 0x1)
-#define CLK_Set()       do { LATCbits.LATC5 = 1; } while(0)
-#define CLK_Clear()     do { LATCbits.LATC5 = 0; } while(0)
-#define LATCH_Set()     do { LATCbits.LATC4 = 1; } while(0)
-#define LATCH_Clear()   do { LATCbits.LATC4 = 0; } while(0)
-// note:  v1 pcb had latch and clock on swapped pins!
+#define DATA_Get()      (PIN_PORT(BOARD_DATA) & 0x1)
+#define CLK_Set()       do { PIN_LAT(BOARD_CLK) = 1; } while(0)
+#define CLK_Clear()     do { PIN_LAT(BOARD_CLK) = 0; } while(0)
+#define LATCH_Set()     do { PIN_LAT(BOARD_LATCH) = 1; } while(0)
+#define LATCH_Clear()   do { PIN_LAT(BOARD_LATCH) = 0; } while(0)
+#define POT_Get()       (PIN_PORT(BOARD_POT) & 0x1)
+
+#define GPIO_PRESSED(pin)           GPIO_PRESSED_(pin)
+#define GPIO_PRESSED_(port, bit)    (!((port) & (1 << (bit))))
+// note:  v1 pcb had latch and clock on swapped pins! (see board.h)
 
 /*
     keyboard mapping (match retroarch default):
@@ -37,17 +42,41 @@
 */
 
 
+const uint8_t button_keys[BUTTON_COUNT] =
+{
+    KEY_X,          // A
+    KEY_Z,          // B
+    KEY_RIGHTSHIFT, // SELECT
+    KEY_ENTER,      // START
+    KEY_UP,         // UP
+    KEY_DOWN,       // DOWN
+    KEY_LEFT,       // LEFT
+    KEY_RIGHT,      // RIGHT
+};
+
 uint8_t last_reading = 0;
 
 void NES_GPIO_Initialize() 
 {
-    ANSELCbits.ANSC3 = 0;   // enable digital mode 
-    TRISCbits.TRISC3 = 1;   //Set RC3 as input
-    TRISCbits.TRISC4 = 0;   //Set RC4 as output
-    TRISCbits.TRISC5 = 0;   //Set RC5 as output
+#if GpioInputEnabled
+    ANSELC = 0x00;          // all of PORTC digital
+    TRISC |= 0b00111111;    // RC0..RC5 inputs
+    TRISAbits.TRISA5 = 1;   // RA3 is always an input
+    WPUA |= 0b00101000;     // pull-ups on RA3 and RA5
+    OPTION_REGbits.nWPUEN = 0;
+#else
+    PIN_ANSEL(BOARD_DATA) = 0;  // enable digital mode 
+    PIN_TRIS(BOARD_DATA) = 1;   //Set data as input
+    PIN_TRIS(BOARD_LATCH) = 0;  //Set latch as output
+    PIN_TRIS(BOARD_CLK) = 0;    //Set clock as output
+#if PaddleEnabled
+    PIN_ANSEL(BOARD_POT) = 0;   // enable digital mode
+    PIN_TRIS(BOARD_POT) = 1;    //Set potentiometer data as input
+#endif
+#endif
     
-    ANSELAbits.ANSA4 = 0;   // enable digital mode 
-    TRISAbits.TRISA4 = 0;   //Set RA4 as output
+    PIN_ANSEL(BOARD_LED) = 0;   // enable digital mode 
+    PIN_TRIS(BOARD_LED) = 0;    //Set LED as output
 }
 
 uint8_t NES_read_pad() 
@@ -79,7 +108,7 @@ uint8_t NES_read_pad()
   // state of the buttons
   uint8_t output = 0x00;
   int i;
-  for ( i = 0; i < 8; i++)
+  for ( i = 0; i < 8; i++)  // loop:PadBits
   {
       output |= !( DATA_Get()) << i;
       CLK_Set();
@@ -90,3 +119,53 @@ uint8_t NES_read_pad()
   
   return output;
 }
+
+#if PaddleEnabled
+uint8_t NES_read_paddle(uint8_t *position)
+{
+    /*
+      The Vaus shifts the fire button and an inverted 8 bit potentiometer
+      reading (MSB first) out on two lines with the same latch and clock,
+      so both are sampled in the one pass.
+     */
+    LATCH_Set();
+    __delay_us(12);
+    LATCH_Clear();
+
+    uint8_t fire = !DATA_Get();
+    uint8_t pot = 0x00;
+    uint8_t i;
+    for ( i = 0; i < 8; i++)  // loop:PaddleBits
+    {
+        pot = (uint8_t)(pot << 1) | !POT_Get();
+        CLK_Set();
+        __delay_us(6);
+        CLK_Clear();
+        __delay_us(6);
+    }
+
+    *position = pot;
+    return fire;
+}
+#endif
+
+#if GpioInputEnabled
+uint8_t GPIO_read_buttons()
+{
+    // One read per port, then each button is a single bit test
+    uint8_t pa = PORTA;
+    uint8_t pc = PORTC;
+    uint8_t output = 0x00;
+
+    if (GPIO_PRESSED(GPIO_PIN_A))       output |= BUTTON_A;
+    if (GPIO_PRESSED(GPIO_PIN_B))       output |= BUTTON_B;
+    if (GPIO_PRESSED(GPIO_PIN_SELECT))  output |= BUTTON_SELECT;
+    if (GPIO_PRESSED(GPIO_PIN_START))   output |= BUTTON_START;
+    if (GPIO_PRESSED(GPIO_PIN_UP))      output |= BUTTON_UP;
+    if (GPIO_PRESSED(GPIO_PIN_DOWN))    output |= BUTTON_DOWN;
+    if (GPIO_PRESSED(GPIO_PIN_LEFT))    output |= BUTTON_LEFT;
+    if (GPIO_PRESSED(GPIO_PIN_RIGHT))   output |= BUTTON_RIGHT;
+
+    return output;
+}
+#endif
@@ -3,6 +3,35 @@
 
 #include "usb_hid_keys.h"
 
+// Arkanoid (Vaus) paddle instead of a standard pad. Fire comes in on the
+// normal data line, the potentiometer on a second data line (see board.h).
+// Reported through the mouse interface, so MouseEnabled must be set too.
+#ifndef PaddleEnabled
+#define PaddleEnabled   0
+#endif
+#define PaddleSmoothing 2   // Exponential smoothing shift (0 = off, 1..4 heavier)
+
+// Arcade buttons wired straight to the PIC instead of a pad (pin map in
+// board.h). Active low: RA3/RA5 use the internal pull-ups, PORTC needs
+// external ones.
+#ifndef GpioInputEnabled
+#define GpioInputEnabled 0
+#endif
+
+#if GpioInputEnabled && PaddleEnabled
+#error "Select only one of GpioInputEnabled and PaddleEnabled"
+#endif
+
+// Recording (record.h) and playback (playback.h) are pad buttons through
+// PadTask(), a paddle build has neither. The options come from Usb.h,
+// included first.
+#if defined(RecordEnabled) && RecordEnabled && PaddleEnabled
+#error "RecordEnabled records pad buttons - it can't be used with PaddleEnabled"
+#endif
+#if defined(PlaybackEnabled) && PlaybackEnabled && PaddleEnabled
+#error "PlaybackEnabled replays pad buttons - it can't be used with PaddleEnabled"
+#endif
+
 #define BUTTON_A        (1<<0)
 #define BUTTON_B        (1<<1)
 #define BUTTON_SELECT   (1<<2)
@@ -12,27 +41,21 @@
 #define BUTTON_LEFT     (1<<6)
 #define BUTTON_RIGHT    (1<<7)
 
-struct KEYMAP
-{
-	uint8_t button;
-	uint16_t key;
-};
-
-struct KEYMAP button_key_maps[] =
-{
-    { BUTTON_A, KEY_X },
-    { BUTTON_B, KEY_Z },
-    { BUTTON_SELECT, KEY_RIGHTSHIFT },
-    { BUTTON_START, KEY_ENTER },
-    { BUTTON_UP, KEY_UP },
-    { BUTTON_DOWN, KEY_DOWN },
-    { BUTTON_LEFT, KEY_LEFT },
-    { BUTTON_RIGHT, KEY_RIGHT },
-    
-    { NULL, NULL },
-};
+#define BUTTON_COUNT    8
+
+// HID usage for every button, indexed by button bit (in flash, see nes_keyboard.c)
+extern const uint8_t button_keys[BUTTON_COUNT];
 
 void NES_GPIO_Initialize();
 uint8_t NES_read_pad();
+uint8_t NES_read_paddle(uint8_t *position);
+uint8_t GPIO_read_buttons();
+
+// Button byte from whichever input source is built in
+#if GpioInputEnabled
+#define read_buttons()  GPIO_read_buttons()
+#else
+#define read_buttons()  NES_read_pad()
+#endif
 
 #endif /* NES_KEYBOARD_H */
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include <stdint.h>
+#include <htc.h>
+#include "Usb.h"
+#include "nes_keyboard.h"
+#include "nes_mouse.h"
+
+#if PaddleEnabled && !MouseEnabled
+#error "PaddleEnabled reports through the mouse interface - set MouseEnabled"
+#endif
+
+#if MouseEnabled
+
+/*
+    Mouse emulation:
+    D-pad = pointer movement
+    A     = left button
+    B     = right button
+
+    Speed is 4.4 fixed point (1/16 pixel per frame) looked up from a flash
+    table indexed by how long the D-pad has been held. The fractional part
+    is carried over between frames so slow speeds still move smoothly.
+    NES_mouse_frame() is called once per USB frame (1ms), has no loops and
+    no multiplication, so its cost is constant.
+*/
+
+#define HOLD_SHIFT      5   // 32 frames (ms) per table step
+#define SPEED_STEPS     16
+
+const uint8_t speed_table[SPEED_STEPS] =
+{
+     2,  3,  4,  5,  6,  8, 10, 12,     // 0.125 .. 0.75 px/ms
+    14, 16, 19, 22, 25, 28, 31, 32      // 0.875 .. 2.0  px/ms
+};
+
+uint8_t hold_frames;    // Frames the D-pad has been held (saturates)
+uint8_t frac_x;         // Fractional position carried between frames
+uint8_t frac_y;
+int8_t  pending_x;      // Movement not yet collected by the host
+int8_t  pending_y;
+uint8_t last_buttons;
+#if PaddleEnabled
+uint16_t paddle_pos;    // Smoothed paddle position, 12.4 fixed point
+uint8_t paddle_last;    // Position last turned into movement
+uint8_t paddle_valid;   // Set once paddle_pos holds a real sample
+#endif
+
+static int8_t add_clamped(int8_t value, int8_t delta)
+{
+    int16_t sum = (int16_t)value + delta;
+    if (sum > 127) return 127;
+    if (sum < -127) return -127;
+    return (int8_t)sum;
+}
+
+void NES_mouse_reset()
+{
+    hold_frames = 0;
+    frac_x = 0;
+    frac_y = 0;
+    pending_x = 0;
+    pending_y = 0;
+    last_buttons = 0;
+#if PaddleEnabled
+    paddle_valid = 0;
+#endif
+}
+
+static void send_report(uint8_t buttons)
+{
+    // Nothing to say - stay off the bus
+    if (pending_x == 0 && pending_y == 0 && buttons == last_buttons) return;
+
+    // Host hasn't collected the previous report yet, keep accumulating
+    if (!IsHidTxReady(MouseInterfaceNumber)) return;
+
+    MouseTxBuffer[0] = buttons;
+    MouseTxBuffer[1] = (uint8_t)pending_x;
+    MouseTxBuffer[2] = (uint8_t)pending_y;
+    HIDSend(MouseInterfaceNumber);
+
+    pending_x = 0;
+    pending_y = 0;
+    last_buttons = buttons;
+}
+
+void NES_mouse_frame(uint8_t reading)
+{
+    uint8_t buttons = 0;
+    uint8_t step;
+    uint8_t speed;
+
+    if (reading & BUTTON_A) buttons |= MOUSE_BUTTON_LEFT;
+    if (reading & BUTTON_B) buttons |= MOUSE_BUTTON_RIGHT;
+
+    if (reading & (BUTTON_UP | BUTTON_DOWN | BUTTON_LEFT | BUTTON_RIGHT))
+    {
+        if (hold_frames < 0xFF) hold_frames++;
+
+        step = hold_frames >> HOLD_SHIFT;
+        if (step >= SPEED_STEPS) step = SPEED_STEPS - 1;
+        speed = speed_table[step];
+
+        if (reading & (BUTTON_LEFT | BUTTON_RIGHT))
+        {
+            frac_x += speed;
+            if (reading & BUTTON_RIGHT)
+                pending_x = add_clamped(pending_x, (int8_t)(frac_x >> 4));
+            else
+                pending_x = add_clamped(pending_x, -(int8_t)(frac_x >> 4));
+            frac_x &= 0x0F;
+        }
+        else frac_x = 0;
+
+        if (reading & (BUTTON_UP | BUTTON_DOWN))
+        {
+            frac_y += speed;
+            if (reading & BUTTON_DOWN)
+                pending_y = add_clamped(pending_y, (int8_t)(frac_y >> 4));
+            else
+                pending_y = add_clamped(pending_y, -(int8_t)(frac_y >> 4));
+            frac_y &= 0x0F;
+        }
+        else frac_y = 0;
+    }
+    else
+    {
+        hold_frames = 0;
+        frac_x = 0;
+        frac_y = 0;
+    }
+
+    send_report(buttons);
+}
+
+#if PaddleEnabled
+// Called once per USB frame with a fresh paddle sample. The position is
+// smoothed with an exponential filter in fixed point and the change turned
+// into relative X movement; fire is the left button.
+void NES_paddle_frame(uint8_t fire, uint8_t position)
+{
+    uint16_t target = (uint16_t)position << 4;
+    uint8_t smoothed;
+
+    if (!paddle_valid)
+    {
+        paddle_pos = target;
+        paddle_last = position;
+        paddle_valid = 1;
+    }
+
+    if (target >= paddle_pos)
+        paddle_pos += (target - paddle_pos) >> PaddleSmoothing;
+    else
+        paddle_pos -= (paddle_pos - target) >> PaddleSmoothing;
+
+    smoothed = (uint8_t)((paddle_pos + 8) >> 4);
+    pending_x = add_clamped(pending_x, (int8_t)((int16_t)smoothed - paddle_last));
+    paddle_last = smoothed;
+
+    send_report(fire ? MOUSE_BUTTON_LEFT : 0);
+}
+#endif
+
+#endif /* MouseEnabled */
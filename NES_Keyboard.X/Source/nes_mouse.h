@@ -0,0 +1,16 @@
+#ifndef NES_MOUSE_H
+#define NES_MOUSE_H
+
+#include <stdint.h>
+
+// Holding SELECT + START together toggles between keyboard and mouse mode
+#define MOUSE_MODE_COMBO    (BUTTON_SELECT | BUTTON_START)
+
+#define MOUSE_BUTTON_LEFT   (1<<0)
+#define MOUSE_BUTTON_RIGHT  (1<<1)
+
+void NES_mouse_reset();
+void NES_mouse_frame(uint8_t reading);
+void NES_paddle_frame(uint8_t fire, uint8_t position);
+
+#endif /* NES_MOUSE_H */
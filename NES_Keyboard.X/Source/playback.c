@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <htc.h>
+#include "Usb.h"
+#include "playback.h"
+
+#if PlaybackEnabled
+
+// The status report is built in ControlTransferBuffer
+typedef char PlaybackSizeCheck[(PlaybackStatusByteCount <= E0SZ) ? 1 : -1];
+
+volatile uint8_t PlaybackState;     // PLAYBACK_PLAYING | PLAYBACK_OVERRIDE, set from the ISR
+volatile uint8_t PlaybackFlush;     // Stop requested, the main loop empties the ring
+volatile uint8_t PlaybackStart;     // Play requested, the timeline waits for PadTask()
+PlaybackEntry PlaybackRing[PLAYBACK_RING];
+volatile uint8_t PlaybackHead;      // Next entry to fill, main loop only
+volatile uint8_t PlaybackTail;      // Next entry to play, ISR only
+volatile uint8_t PlaybackButtons;   // Buttons of the current entry
+uint8_t PlaybackHold;               // Frames left of the current entry after this one
+uint16_t PlaybackUnderruns;         // Frames that found the ring empty
+uint16_t PlaybackOverrides;         // Samples the live pad took over
+uint16_t PlaybackFrames;            // Frames played since PLAYBACK_PLAY
+
+// Called from the ISR (SET_REPORT data stage)
+void Playback_Control(uint8_t command)
+{
+    if (command & PLAYBACK_PLAY)
+    {
+        PlaybackUnderruns = 0;
+        PlaybackOverrides = 0;
+        PlaybackFrames = 0;
+        PlaybackHold = 0;
+        PlaybackButtons = 0;
+        PlaybackStart = 1;
+        PlaybackState = command & (PLAYBACK_PLAYING | PLAYBACK_OVERRIDE);
+    }
+    else
+    {
+        PlaybackState = 0;
+        PlaybackFlush = 1;
+    }
+}
+
+static uint8_t Playback_Free(void)
+{
+    return (PLAYBACK_RING - 1) - ((PlaybackHead - PlaybackTail) & (PLAYBACK_RING - 1));
+}
+
+// Called from the ISR (GET_REPORT), returns the report length
+uint8_t Playback_Status(uint8_t *report)
+{
+    report[0] = PLAYBACK_REPORT_ID;
+    report[1] = PlaybackState;
+    report[2] = Playback_Free();
+    report[3] = LSB(PlaybackUnderruns);
+    report[4] = MSB(PlaybackUnderruns);
+    report[5] = LSB(PlaybackOverrides);
+    report[6] = MSB(PlaybackOverrides);
+    report[7] = LSB(PlaybackFrames);
+    report[8] = MSB(PlaybackFrames);
+    return PlaybackStatusByteCount;
+}
+
+// Called on every SOF - one frame of the timeline. Not before PadTask() has
+// taken a sample with playback on: until then it may be at the idle rate,
+// and the first entries would go by between two samples.
+void Playback_Frame(void)
+{
+    PlaybackEntry *entry;
+
+    if (!(PlaybackState & PLAYBACK_PLAYING) || PlaybackFlush || PlaybackStart) return;
+
+    PlaybackFrames++;
+    if (PlaybackHold)
+    {
+        PlaybackHold--;
+        return;
+    }
+
+    // The host fell behind - hold what we have and say so
+    if (PlaybackTail == PlaybackHead)
+    {
+        if (PlaybackUnderruns != 0xFFFF) PlaybackUnderruns++;
+        return;
+    }
+
+    entry = &PlaybackRing[PlaybackTail];
+    PlaybackTail = (PlaybackTail + 1) & (PLAYBACK_RING - 1);
+    if (entry->Frames == 0)
+    {
+        PlaybackState = 0;
+        PlaybackButtons = 0;
+        return;
+    }
+    PlaybackButtons = entry->Buttons;
+    PlaybackHold = entry->Frames - 1;
+}
+
+// What PadTask() reports while playing, live is the real pad
+uint8_t Playback_Input(uint8_t live)
+{
+    PlaybackStart = 0;
+    if ((PlaybackState & PLAYBACK_OVERRIDE) && live)
+    {
+        // The ISR may be reading it for a GET_REPORT
+        INTCONbits.GIE = 0;
+        if (PlaybackOverrides != 0xFFFF) PlaybackOverrides++;
+        INTCONbits.GIE = 1;
+        return live;
+    }
+    return PlaybackButtons;
+}
+
+// Scheduler task: timeline reports from the OUT endpoint into the ring
+void PlaybackTask(void)
+{
+    uint8_t count;
+    uint8_t entries;
+    uint8_t n;
+
+    // The ISR leaves the tail alone until this is cleared
+    if (PlaybackFlush)
+    {
+        PlaybackHead = PlaybackTail;
+        PlaybackFlush = 0;
+    }
+
+    count = IsUsbDataAvaialble(VendorInterfaceNumber);
+    if (count == 0) return;
+
+    entries = 0;
+    if ((VendorRxBuffer[0] == PLAYBACK_REPORT_ID) && (count >= 2))
+    {
+        entries = VendorRxBuffer[1];
+        if (entries > (count - 2) / sizeof(PlaybackEntry)) entries = (count - 2) / sizeof(PlaybackEntry);
+    }
+
+    // No room for all of it yet - the host gets NAKs until there is
+    if (entries > Playback_Free()) return;
+
+    for (n = 0; n < entries; n++)
+    {
+        PlaybackRing[PlaybackHead].Buttons = VendorRxBuffer[2 + (n * 2)];
+        PlaybackRing[PlaybackHead].Frames = VendorRxBuffer[3 + (n * 2)];
+        PlaybackHead = (PlaybackHead + 1) & (PLAYBACK_RING - 1);
+    }
+    ReArmInterface(VendorInterfaceNumber);
+}
+
+#endif
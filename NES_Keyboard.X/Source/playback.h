@@ -0,0 +1,78 @@
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include <stdint.h>
+
+/*
+    Host fed playback (PlaybackEnabled, see UsbDescriptors.h).
+
+    The host streams a button timeline as output report PLAYBACK_REPORT_ID
+    on the vendor interface OUT endpoint:
+      ReportId Count Entries[PlaybackEntriesPerReport]
+    An entry holds Buttons for Frames USB frames (1..255); Frames 0 marks
+    the end of the timeline and stops playback with the pad released.
+    PlaybackTask() moves each report into a PLAYBACK_RING entry ring, or
+    leaves it on the endpoint (the host sees NAKs) until there is room
+    for all of it.
+
+    Timing belongs to the SOF interrupt: while playing, Playback_Frame()
+    advances the timeline by exactly one frame per SOF and PadTask() hands
+    Playback_Input() to the normal report builder in place of the pad, so
+    a timeline replays to the millisecond. The first frame waits for
+    PadTask()'s first sample after the play, which puts it on every frame. An empty ring at a frame
+    boundary is an underrun - the last buttons are held and it's counted.
+    With the live override on, any button pressed on the real pad replaces
+    the timeline for that sample (counted too), while the timeline keeps
+    running underneath.
+
+    Feature report PLAYBACK_REPORT_ID, 9 bytes:
+      GET  ReportId State Free Underruns(LSB MSB) Overrides(LSB MSB)
+           Frames(LSB MSB)      State: PLAYBACK_PLAYING, PLAYBACK_OVERRIDE
+      SET  ReportId Command     PLAYBACK_STOP flushes the ring,
+                                PLAYBACK_PLAY (| PLAYBACK_OVERRIDE) clears
+                                the counters and starts at the first SOF
+                                after the next pad sample
+    Preload the ring before PLAYBACK_PLAY. A bus reset stops playback.
+    tools/playback.c replays a tools/record.c capture.
+
+    Include after Usb.h (PlaybackEnabled).
+*/
+
+#define PLAYBACK_REPORT_ID  0x05
+#ifndef PLAYBACK_RING
+#define PLAYBACK_RING       64      // Power of two, 2 bytes of RAM each
+#endif
+#define PlaybackEntriesPerReport ((VendorReportByteCount - 2) / sizeof(PlaybackEntry))
+
+#define PLAYBACK_STOP       0x00
+#define PLAYBACK_PLAYING    0x01
+#define PLAYBACK_PLAY       0x01
+#define PLAYBACK_OVERRIDE   0x02
+
+typedef struct _PlaybackEntry
+{
+    uint8_t Buttons;        // As read_buttons() would return them
+    uint8_t Frames;         // How long, 0 = end of the timeline
+} PlaybackEntry;
+
+#if PlaybackEnabled
+
+extern volatile uint8_t PlaybackState;
+
+void Playback_Control(uint8_t command);
+uint8_t Playback_Status(uint8_t *report);
+void Playback_Frame(void);
+uint8_t Playback_Input(uint8_t live);
+void PlaybackTask(void);
+
+#define IsPlaying           (PlaybackState & PLAYBACK_PLAYING)
+
+#else
+
+#define Playback_Control(command)
+#define Playback_Frame()
+#define IsPlaying           0
+
+#endif
+
+#endif /* PLAYBACK_H */
@@ -0,0 +1,49 @@
+#include <stdint.h>
+#include <htc.h>
+#include "Usb.h"
+#include "scheduler.h"
+#include "probe.h"
+
+#if ProbesEnabled
+
+#ifdef __XC8
+// The report goes out as is, so it has to match the descriptor
+typedef char ProbeSizeCheck[(sizeof(ProbeReport) == ProbeReportByteCount) ? 1 : -1];
+#endif
+
+ProbeReport Probes;
+
+void Probe_Reset()
+{
+    uint8_t i;
+
+    Probes.ReportId = PROBE_REPORT_ID;
+    for (i = 0; i < PROBE_COUNT; i++)
+    {
+        Probes.Probes[i].Min = 0xFFFF;
+        Probes.Probes[i].Max = 0;
+        Probes.Probes[i].Sum = 0;
+        Probes.Probes[i].Count = 0;
+    }
+}
+
+// Timer1, the modelled one in a host build
+uint16_t Probe_Now()
+{
+    return Scheduler_Cycles();
+}
+
+void Probe_Record(uint8_t id, uint16_t counts)
+{
+    Probe *probe = &Probes.Probes[id];
+
+    if (counts < probe->Min) probe->Min = counts;
+    if (counts > probe->Max) probe->Max = counts;
+    if (probe->Count != 0xFFFF)
+    {
+        probe->Sum += counts;
+        probe->Count++;
+    }
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdint.h>
+
+/*
+    Cycle probes around the hot paths (ProbesEnabled, see UsbDescriptors.h).
+
+        PROBE_BEGIN(PROBE_READ_PAD);
+        reading = NES_read_pad();
+        PROBE_END(PROBE_READ_PAD);
+
+    BEGIN and END must be in the same block. Each probe keeps min, max, sum
+    and count of the counts between them - Timer1 at Fosc/4 (12 per us) on
+    target, so ISR preemption is included. Count stops at 0xFFFF (and the
+    sum with it, so the mean stays right), min and max keep going.
+
+    In a host build (tools/sim) Timer1 counts the sim's modelled cycles,
+    which only approximate the firmware's; tools/bench.py measures the
+    real ones on the XC8 hex.
+
+    The host reads them with GET_REPORT(Feature, PROBE_REPORT_ID) on the
+    vendor interface: ReportId, then Probe[PROBE_COUNT] little endian.
+    HIDSend() runs in both the ISR and the main loop, so its probe can
+    occasionally lose an update.
+
+    Include after Usb.h (ProbesEnabled).
+*/
+
+#define PROBE_REPORT_ID     0x03
+
+#define PROBE_READ_PAD      0   // read_buttons()
+#define PROBE_PREPARE_TX    1   // PrepareTxBuffer()
+#define PROBE_HID_SEND      2   // HIDSend()
+#define PROBE_USB_RESET     3   // ProcessUSBTransactions() bus reset branch
+#define PROBE_USB_SOF       4   // ... SOF branch
+#define PROBE_USB_RARE      5   // ... idle / stall / error branch
+#define PROBE_USB_TRN       6   // ... transaction branch
+#define PROBE_COUNT         7
+
+typedef struct _Probe
+{
+    uint16_t Min;
+    uint16_t Max;
+    uint32_t Sum;
+    uint16_t Count;
+} Probe;
+
+typedef struct _ProbeReport
+{
+    uint8_t ReportId;       // PROBE_REPORT_ID
+    Probe Probes[PROBE_COUNT];
+} ProbeReport;
+
+#if ProbesEnabled
+
+extern ProbeReport Probes;
+
+void Probe_Reset();
+uint16_t Probe_Now();
+void Probe_Record(uint8_t id, uint16_t counts);
+
+#define PROBE_BEGIN(id)     uint16_t probe_start_##id = Probe_Now()
+#define PROBE_END(id)       Probe_Record(id, Probe_Now() - probe_start_##id)
+
+#else
+
+#define Probe_Reset()
+#define PROBE_BEGIN(id)
+#define PROBE_END(id)
+
+#endif
+
+#endif /* PROBE_H */
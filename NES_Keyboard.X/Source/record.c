@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <htc.h>
+#include "Usb.h"
+#include "record.h"
+
+#if RecordEnabled
+
+volatile uint8_t RecordOn;          // Streaming, set by the host through the ISR
+volatile uint8_t RecordRestart;     // Start requested, the main loop clears the state
+PadRecord RecordRing[RECORD_RING];
+uint8_t RecordHead;                 // Next record to write
+uint8_t RecordTail;                 // Next record to send
+uint16_t RecordDropped;             // Records that didn't fit since the start
+uint8_t RecordSequence;             // Reports sent since the start
+uint8_t RecordLast;                 // Buttons in the last record
+uint16_t RecordLastFrame;           // Frame of the last record
+uint16_t RecordFrameHigh;           // Frame number bits 11..15, counted here
+uint16_t RecordFrameLow;            // Hardware frame number at the last sample
+
+// Called from the ISR (SET_REPORT data stage)
+void Record_Control(uint8_t on)
+{
+    RecordOn = on;
+    if (on) RecordRestart = 1;
+}
+
+// The 11 bit USB frame number extended to 16 bits. Needs calling at least
+// every 2048 frames, which the pad polling does.
+static uint16_t Record_Frame(void)
+{
+    uint8_t high;
+    uint8_t low;
+    uint16_t frame;
+
+    do
+    {
+        high = UFRMH;
+        low = UFRML;
+    } while (high != UFRMH);
+
+    frame = ((uint16_t)(high & 0x07) << 8) | low;
+    if (frame < RecordFrameLow) RecordFrameHigh += 0x0800;
+    RecordFrameLow = frame;
+    return RecordFrameHigh | frame;
+}
+
+static void Record_Push(uint8_t buttons, uint16_t frame)
+{
+    uint8_t next = (RecordHead + 1) & (RECORD_RING - 1);
+
+    RecordLast = buttons;
+    RecordLastFrame = frame;
+
+    // The host isn't keeping up - count it, the report carries the total
+    if (next == RecordTail)
+    {
+        if (RecordDropped != 0xFFFF) RecordDropped++;
+        return;
+    }
+
+    RecordRing[RecordHead].Buttons = buttons;
+    RecordRing[RecordHead].FrameL = LSB(frame);
+    RecordRing[RecordHead].FrameH = MSB(frame);
+    RecordHead = next;
+}
+
+// Every pad sample goes through here, a compare when nothing changed
+void Record_Sample(uint8_t buttons)
+{
+    uint16_t frame;
+
+    if (!RecordOn) return;
+    frame = Record_Frame();
+
+    if (RecordRestart)
+    {
+        RecordRestart = 0;
+        RecordHead = RecordTail;
+        RecordDropped = 0;
+        RecordSequence = 0;
+        Record_Push(buttons, frame);
+        return;
+    }
+
+    if (buttons == RecordLast && (uint16_t)(frame - RecordLastFrame) < RECORD_HEARTBEAT) return;
+    Record_Push(buttons, frame);
+}
+
+// Scheduler task: one report of queued records whenever the endpoint is free
+void RecordTask(void)
+{
+    uint8_t *out = (uint8_t *)&VendorTxBuffer[5];
+    uint8_t *in;
+    uint8_t count = 0;
+    uint8_t n;
+
+    if (!RecordOn || RecordRestart || RecordHead == RecordTail) return;
+    if (!IsUsbReady || !IsHidTxReady(VendorInterfaceNumber)) return;
+
+    while (RecordTail != RecordHead && count < RecordsPerReport)
+    {
+        in = (uint8_t *)&RecordRing[RecordTail];
+        for (n = 0; n < sizeof(PadRecord); n++) *out++ = in[n];
+        RecordTail = (RecordTail + 1) & (RECORD_RING - 1);
+        count++;
+    }
+    while (out < (uint8_t *)&VendorTxBuffer[VendorReportByteCount]) *out++ = 0;
+
+    VendorTxBuffer[0] = RECORD_STREAM_ID;
+    VendorTxBuffer[1] = RecordSequence++;
+    VendorTxBuffer[2] = count;
+    VendorTxBuffer[3] = LSB(RecordDropped);
+    VendorTxBuffer[4] = MSB(RecordDropped);
+    HIDSend(VendorInterfaceNumber);
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+
+/*
+    Pad recording stream (RecordEnabled, see UsbDescriptors.h).
+
+    While streaming, every pad sample that differs from the one before
+    makes a record: the raw button byte and the 16 bit USB frame number it
+    was sampled in (the 11 bit hardware number, extended in software). A
+    pad that doesn't change makes nothing, apart from one repeat record
+    every RECORD_HEARTBEAT frames so the host can keep unwrapping the frame
+    number. While streaming, PadTask() samples on every frame whatever
+    the idle rate, so a record is exact to the frame - at most 1000
+    records/s.
+
+    Records queue in a RECORD_RING ring and RecordTask() sends them as input
+    report RECORD_STREAM_ID on the vendor interface IN endpoint (1ms
+    interval), up to RecordsPerReport at a time:
+      ReportId Sequence Count Dropped(LSB MSB) Records[RecordsPerReport]
+    Sequence goes up by one per report, so reports the host lost show up
+    too. Dropped counts records that didn't fit in the ring since
+    streaming started - it only ever goes up, nothing is silently lost.
+
+    The host starts (1) and stops (0) the stream with
+    SET_REPORT(Feature, RECORD_CONTROL_ID) - starting clears the counters
+    and opens with a record of the current pad state. A bus reset stops it.
+    tools/record.c captures the stream to a file.
+
+    Include after Usb.h (RecordEnabled).
+*/
+
+#define RECORD_STREAM_ID    0x01    // Input report
+#define RECORD_CONTROL_ID   0x04    // Feature report
+#ifndef RECORD_RING
+#define RECORD_RING         32      // Power of two, 3 bytes of RAM each
+#endif
+#define RECORD_HEARTBEAT    0x4000  // Frames between records of an unchanged pad
+#define RecordsPerReport    ((VendorReportByteCount - 5) / sizeof(PadRecord))
+
+typedef struct _PadRecord
+{
+    uint8_t Buttons;        // read_buttons()
+    uint8_t FrameL;         // USB frame number, extended to 16 bits
+    uint8_t FrameH;
+} PadRecord;
+
+#if RecordEnabled
+
+extern volatile uint8_t RecordOn;
+
+void Record_Control(uint8_t on);
+void Record_Sample(uint8_t buttons);
+void RecordTask(void);
+
+#else
+
+#define Record_Control(on)
+#define Record_Sample(buttons)
+
+#endif
+
+#endif /* RECORD_H */
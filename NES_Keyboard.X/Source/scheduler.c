@@ -0,0 +1,54 @@
+#include <stdint.h>
+#include <htc.h>
+#include "scheduler.h"
+
+void Scheduler_Initialize()
+{
+    // Timer1 free running from Fosc/4, no prescaler - one count per cycle
+    T1CON = 0x01;
+    T1GCON = 0x00;
+}
+
+// 16 bit Timer1 read that can't be torn by the low byte rolling over
+uint16_t Scheduler_Cycles()
+{
+    uint8_t high;
+    uint8_t low;
+
+    do  // loop:TimerReread
+    {
+        high = TMR1H;
+        low = TMR1L;
+    } while (high != TMR1H);
+
+    return ((uint16_t)high << 8) | low;
+}
+
+void Scheduler_Run(Task *tasks, uint8_t count, uint8_t now)
+{
+    uint8_t i;
+    uint8_t waited;
+    uint16_t start;
+    Task *task;
+
+    for (i = 0; i < count; i++)  // loop:TaskScan
+    {
+        task = &tasks[i];
+
+        if (task->Period != 0)
+        {
+            waited = now - task->Release;
+            if (waited < task->Period) continue;
+
+            // Started later than allowed - count it and drop the backlog
+            if ((uint8_t)(waited - task->Period) > task->Deadline && task->Misses != 0xFF)
+                task->Misses++;
+            task->Release = now;
+        }
+
+        start = Scheduler_Cycles();
+        task->Run();
+        task->LastCycles = Scheduler_Cycles() - start;
+        if (task->LastCycles > task->MaxCycles) task->MaxCycles = task->LastCycles;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+/*
+    Cooperative scheduler driven by the USB frame counter (1ms per tick).
+
+    A task is released every Period frames (0 = on every pass of the main
+    loop) and should start within Deadline frames of becoming due, otherwise
+    a miss is counted. Tasks run to completion in table order, so the table
+    order is the priority. Cycles are Timer1 counts at Fosc/4 (12 per us)
+    and include any time spent in the ISR while the task ran.
+*/
+
+typedef struct _Task
+{
+    void (*Run)(void);
+    uint8_t Period;         // Frames between releases (0 = every pass)
+    uint8_t Deadline;       // Frames a due task may wait before it's a miss
+    uint8_t Release;        // FrameCount at the last release
+    uint8_t Misses;         // Deadline misses (saturates)
+    uint16_t LastCycles;    // Cycles taken by the last run
+    uint16_t MaxCycles;     // Longest run so far
+} Task;
+
+#define TASK(run, period, deadline) { run, period, deadline, 0, 0, 0, 0 }
+
+void Scheduler_Initialize();
+void Scheduler_Run(Task *tasks, uint8_t count, uint8_t now);
+uint16_t Scheduler_Cycles();
+
+#endif /* SCHEDULER_H */
@@ -0,0 +1,127 @@
+#include <stdint.h>
+#include <htc.h>
+#include "Usb.h"
+#include "scheduler.h"
+#include "telemetry.h"
+
+#if VendorEnabled
+
+// The report goes out as is, so it has to match the descriptor
+typedef char TelemetrySizeCheck[(sizeof(TelemetryReport) == TelemetryReportByteCount) ? 1 : -1];
+
+TelemetryReport Telemetry;
+TelemetryReport TelemetrySnapshot;  // What a GET_REPORT sends, see Telemetry_Snapshot()
+
+uint16_t SofCycles;         // Timer1 at the last SOF
+uint16_t ArmCycles;         // Timer1 when the keyboard report was armed
+uint8_t ArmFrame;           // FrameCount when the keyboard report was armed
+uint8_t Armed;              // Keyboard report waiting for the host
+
+void Telemetry_Reset()
+{
+    uint8_t *p = (uint8_t *)&Telemetry;
+    uint8_t n;
+
+    for (n = 0; n < sizeof(Telemetry); n++) p[n] = 0;
+    Telemetry.ReportId = TELEMETRY_REPORT_ID;
+    Telemetry.Version = TELEMETRY_VERSION;
+}
+
+// 16 bit increment the ISR can't see half done. Called from main and from
+// the ISR (HIDSend()), so GIE goes back the way it was.
+void Telemetry_Count(uint16_t *counter)
+{
+    uint8_t gie = INTCONbits.GIE;
+
+    INTCONbits.GIE = 0;
+    (*counter)++;
+    INTCONbits.GIE = gie;
+}
+
+// Bin 0 below 128 counts, then one bin per power of two (at most 7 shifts)
+void Telemetry_Log2(uint16_t *bins, uint16_t cycles)
+{
+    uint8_t bin = 0;
+
+    cycles >>= TELEMETRY_LOG2_SHIFT;
+    while (cycles && bin < (TELEMETRY_BINS - 1))  // loop:Log2Shift
+    {
+        cycles >>= 1;
+        bin++;
+    }
+    Telemetry_Count(&bins[bin]);
+}
+
+// Copy the whole report for a GET_REPORT (ISR). It goes out in two EP0
+// packets, and without the copy everything could move between the two.
+void Telemetry_Snapshot()
+{
+    uint8_t *from = (uint8_t *)&Telemetry;
+    uint8_t *to = (uint8_t *)&TelemetrySnapshot;
+    uint8_t n;
+
+    for (n = 0; n < sizeof(Telemetry); n++) to[n] = from[n];  // loop:SnapshotCopy
+}
+
+// UEIR snapshot, one counter per error type
+void Telemetry_UsbErrors(uint8_t flags)
+{
+    if (flags & 0x01) Telemetry.UsbErrors[0]++;     // PID check failure
+    if (flags & 0x02) Telemetry.UsbErrors[1]++;     // CRC5 host error
+    if (flags & 0x04) Telemetry.UsbErrors[2]++;     // CRC16 failure
+    if (flags & 0x08) Telemetry.UsbErrors[3]++;     // Data field not a multiple of 8 bits
+    if (flags & 0x10) Telemetry.UsbErrors[4]++;     // Bus turnaround time-out
+    if (flags & 0x80) Telemetry.UsbErrors[7]++;     // Bit stuff error
+}
+
+void Telemetry_Isr(uint16_t cycles)
+{
+    if (cycles > Telemetry.IsrMaxCycles) Telemetry.IsrMaxCycles = cycles;
+}
+
+// Keyboard report handed to the SIE - called before UOWN is set, so the
+// ISR can't see the IN complete before the stamps are written
+void Telemetry_Armed()
+{
+    ArmCycles = Scheduler_Cycles();
+    ArmFrame = FrameCount;
+    Armed = 1;
+    Telemetry_Count(&Telemetry.Reports);
+}
+
+// Keyboard IN transaction complete (ISR)
+void Telemetry_Collected()
+{
+    uint16_t bin;
+
+    if (!Armed) return;
+    Armed = 0;
+
+    // Timer1 wraps every 5.4ms, anything that old goes in the last bin
+    bin = TELEMETRY_BINS - 1;
+    if ((uint8_t)(FrameCount - ArmFrame) < 5)
+    {
+        bin = (uint16_t)(Scheduler_Cycles() - ArmCycles) >> TELEMETRY_LINEAR_SHIFT;
+        if (bin > TELEMETRY_BINS - 1) bin = TELEMETRY_BINS - 1;
+    }
+    Telemetry.CollectLatency[bin]++;
+}
+
+// Start Of Frame (ISR)
+void Telemetry_Sof()
+{
+    SofCycles = Scheduler_Cycles();
+}
+
+// Counts since the last SOF
+uint16_t Telemetry_SinceSof(uint16_t now)
+{
+    uint16_t sof;
+
+    INTCONbits.GIE = 0;
+    sof = SofCycles;
+    INTCONbits.GIE = 1;
+    return now - sof;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+/*
+    Field telemetry, read by the host as feature report TELEMETRY_REPORT_ID
+    on the vendor interface (see UsbDescriptors.h and tools/telemetry.c), so
+    reading it never touches the keyboard endpoint.
+
+    Every update is a counter increment or one histogram bin, no loops over
+    the data. Updates from main go through Telemetry_Count(), which keeps
+    the ISR out for the two byte increment, and a GET_REPORT is answered
+    from TelemetrySnapshot, copied in the ISR when the request comes in.
+    Times are Timer1 counts at Fosc/4 (12 per us). Histograms have
+    TELEMETRY_BINS bins, the last one also catches everything above it:
+      StageLatency    pad sample -> report staged, bin n < 128 << n counts
+      SampleJitter    SOF -> pad sample,           bin n < 128 << n counts
+      CollectLatency  report armed -> IN collected by the host,
+                      bin n < (n + 1) * 4096 counts (341us steps)
+
+    Include after Usb.h (VendorEnabled).
+*/
+
+#define TELEMETRY_REPORT_ID     0x01
+#define TELEMETRY_VERSION       0x01
+#define TELEMETRY_BINS          8
+#define TELEMETRY_LOG2_SHIFT    7       // First log2 bin edge, 128 counts
+#define TELEMETRY_LINEAR_SHIFT  12      // Linear bin width, 4096 counts
+
+typedef struct _TelemetryReport
+{
+    uint8_t ReportId;                       // TELEMETRY_REPORT_ID
+    uint8_t Version;                        // TELEMETRY_VERSION
+    uint16_t BusResets;
+    uint16_t Reports;                       // Keyboard reports armed
+    uint16_t Dropped;                       // HIDSend() found UOWN still set
+    uint16_t IsrMaxCycles;                  // Longest interrupt
+    uint16_t UsbErrors[8];                  // One per UEIR bit (PID, CRC5, CRC16, DFN8, BTO, -, -, BTS)
+    uint16_t StageLatency[TELEMETRY_BINS];
+    uint16_t SampleJitter[TELEMETRY_BINS];
+    uint16_t CollectLatency[TELEMETRY_BINS];
+} TelemetryReport;
+
+#if VendorEnabled
+
+extern TelemetryReport Telemetry;
+extern TelemetryReport TelemetrySnapshot;
+
+void Telemetry_Reset();
+void Telemetry_Count(uint16_t *counter);
+void Telemetry_Snapshot();
+void Telemetry_Log2(uint16_t *bins, uint16_t cycles);
+void Telemetry_UsbErrors(uint8_t flags);
+void Telemetry_Isr(uint16_t cycles);
+void Telemetry_Armed();
+void Telemetry_Collected();
+void Telemetry_Sof();
+uint16_t Telemetry_SinceSof(uint16_t now);
+
+#define TELEMETRY_COUNT(counter)            Telemetry_Count(&Telemetry.counter)
+#define TELEMETRY_LOG2(histogram, cycles)   Telemetry_Log2(Telemetry.histogram, (cycles))
+
+#else
+
+#define Telemetry_Reset()                   ((void)0)
+#define Telemetry_UsbErrors(flags)          ((void)0)
+#define Telemetry_Isr(cycles)               ((void)0)
+#define Telemetry_Armed()                   ((void)0)
+#define Telemetry_Collected()               ((void)0)
+#define Telemetry_Sof()                     ((void)0)
+#define TELEMETRY_COUNT(counter)            ((void)0)
+#define TELEMETRY_LOG2(histogram, cycles)   ((void)0)
+
+#endif
+
+#endif /* TELEMETRY_H */
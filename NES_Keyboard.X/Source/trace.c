@@ -0,0 +1,80 @@
+#include <stdint.h>
+#include <htc.h>
+#include "Usb.h"
+#include "trace.h"
+
+#if TraceEnabled
+
+// The drain report is built in ControlTransferBuffer
+typedef char TraceSizeCheck[(TraceReportByteCount <= E0SZ) ? 1 : -1];
+
+TraceRecord TraceRing[TRACE_RECORDS];
+uint8_t TraceHead;          // Next record to write
+uint8_t TraceTail;          // Oldest record not drained yet
+uint8_t TraceUsed;          // Records waiting to be drained
+uint16_t TraceLost;         // Records overwritten before they were drained
+
+// Claim the next record, stamp it and return its data bytes
+uint8_t *Trace_Next(uint8_t type)
+{
+    TraceRecord *record = &TraceRing[TraceHead];
+
+    TraceHead = (TraceHead + 1) & (TRACE_RECORDS - 1);
+    if (TraceUsed == TRACE_RECORDS)
+    {
+        TraceTail = TraceHead;
+        if (TraceLost != 0xFFFF) TraceLost++;
+    }
+    else TraceUsed++;
+
+    record->FrameL = UFRML;
+    record->TypeFrameH = (uint8_t)(type << 3) | (UFRMH & 0x07);
+    return record->Data;
+}
+
+// SETUP packet, all but wIndex1 and wLength1
+void Trace_Setup(const volatile uint8_t *setup)
+{
+    uint8_t *data = Trace_Next(TRACE_SETUP);
+
+    data[0] = setup[0];
+    data[1] = setup[1];
+    data[2] = setup[2];
+    data[3] = setup[3];
+    data[4] = setup[4];
+    data[5] = setup[6];
+}
+
+// Move the oldest records into a drain report, returns its length
+uint8_t Trace_Drain(uint8_t *report, uint16_t length)
+{
+    uint8_t *out = report + 4;
+    uint8_t *in;
+    uint8_t count = 0;
+    uint8_t fit = TraceRecordsPerReport;
+    uint8_t n;
+
+    // A short read only takes the records it will see, the rest stay queued
+    if (length < TraceReportByteCount)
+        fit = (length > 4) ? (uint8_t)((length - 4) / sizeof(TraceRecord)) : 0;
+
+    while (TraceUsed && count < fit)
+    {
+        in = (uint8_t *)&TraceRing[TraceTail];
+        for (n = 0; n < sizeof(TraceRecord); n++) *out++ = in[n];
+        TraceTail = (TraceTail + 1) & (TRACE_RECORDS - 1);
+        TraceUsed--;
+        count++;
+    }
+    // Unused records read as zero (type 0)
+    while (out < report + TraceReportByteCount) *out++ = 0;
+
+    report[0] = TRACE_REPORT_ID;
+    report[1] = count;
+    report[2] = LSB(TraceLost);
+    report[3] = MSB(TraceLost);
+    if (length >= 4) TraceLost = 0;
+    return TraceReportByteCount;
+}
+
+#endif
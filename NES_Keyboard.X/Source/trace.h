@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+    USB protocol event trace (TraceEnabled, see UsbDescriptors.h).
+
+    A ring of 8 byte records written from the USB ISR only, so no locking.
+    A record is the 11 bit USB frame number with the event type in the top
+    5 bits, then 6 bytes that depend on the type:
+      TRACE_SETUP       bmRequestType bRequest wValue0 wValue1 wIndex0 wLength0
+      TRACE_TOKEN       USTAT BDnSTAT CtrlTransferStage BDnCNT
+      TRACE_REFUSED     bmRequestType bRequest          (EP0 stalled)
+      TRACE_STALL       UEP0
+      TRACE_RESET       UADDR DeviceState               (before the reset)
+      TRACE_ERROR       UEIR
+      TRACE_SUSPEND     -
+      TRACE_RESUME      -
+    When the ring is full the oldest record is dropped and counted.
+
+    The host drains it with GET_REPORT(Feature, TRACE_REPORT_ID) on the
+    vendor interface, up to TraceRecordsPerReport records at a time:
+      ReportId Count Lost(LSB MSB) Records[TraceRecordsPerReport]
+    Draining removes the records, but only as many as fit in the host's
+    wLength, and the drain's own transfer is not traced, so an idle device
+    answers with Count 0. tools/tracedump.c decodes them.
+
+    Include after Usb.h (TraceEnabled).
+*/
+
+#define TRACE_REPORT_ID     0x02
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS       32      // Power of two, 8 bytes of RAM each
+#endif
+
+#define TRACE_SETUP         0x01
+#define TRACE_TOKEN         0x02
+#define TRACE_REFUSED       0x03
+#define TRACE_STALL         0x04
+#define TRACE_RESET         0x05
+#define TRACE_ERROR         0x06
+#define TRACE_SUSPEND       0x07
+#define TRACE_RESUME        0x08
+
+typedef struct _TraceRecord
+{
+    uint8_t FrameL;         // USB frame number LSB
+    uint8_t TypeFrameH;     // Type << 3 | frame number bits 8..10
+    uint8_t Data[6];
+} TraceRecord;
+
+#if TraceEnabled
+
+uint8_t *Trace_Next(uint8_t type);
+void Trace_Setup(const volatile uint8_t *setup);
+uint8_t Trace_Drain(uint8_t *report, uint16_t length);
+
+#define TRACE(type, a, b, c, d) do { uint8_t *t_ = Trace_Next(type); \
+    t_[0] = (a); t_[1] = (b); t_[2] = (c); t_[3] = (d); } while (0)
+
+#else
+
+#define Trace_Setup(setup)      ((void)0)
+#define TRACE(type, a, b, c, d) do { } while (0)
+
+#endif
+
+#endif /* TRACE_H */
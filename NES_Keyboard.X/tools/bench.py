@@ -0,0 +1,1229 @@
+#!/usr/bin/env python3
+"""
+Instruction level test bench for the XC8 build: the production hex runs on
+a model of the PIC16F1455 core, with the pad's 4021 on the board's pins
+and a scripted USB host behind a model of the SIE, and the bench measures
+the real instruction cycles of NES_read_pad(), the interrupt and the
+report path - __delay_us() loops, bank switching, FSR reads from flash
+and the interrupt preempting a shift all included.
+
+    python3 tools/bench.py [options] IMAGE.hex IMAGE.map [TRACE ...]
+
+    --board N       PCB revision the 4021 is wired for (board.h, default 2)
+    --frames N      frames to run after enumeration (default: the traces
+                    and 100 frames, 1000 without a trace)
+    -s FILE         save this run's figures
+    -c FILE         compare against a saved run, exit 1 on a regression
+    -t PERCENT      allowed growth of mean and max (default 10)
+
+A trace is the tools/sim pad format: the frame and the pad byte in hex,
+bit set = pressed (see tools/sim/golden.c). Traces play one after another
+from the frame the device is configured, the 4021 loads whatever the
+trace has at that moment when the firmware raises its latch.
+
+The host stub does what tools/sim/host.c does, on the cycle: a bus reset
+once the firmware turns the module on, a SOF every 12000 cycles, the
+enumeration requests as SETUP/IN/OUT tokens on endpoint 0, 10us apart
+while a transfer is going, and an IN poll of the keyboard endpoint at its
+bInterval, 100us into the frame. Tokens go through the BDT as the SIE
+does: ownership, data toggles, PKTDIS after a SETUP and the 4 deep USTAT
+FIFO behind TRNIF.
+
+Measured, in cycles (Fosc/4, 12 per us):
+    function calls  from the CALL to its RETURN, for every function of
+                    FUNCTIONS the map has, callees and interrupts included
+    ISRCode         from the interrupt (INTERRUPT_LATENCY) to RETFIE
+    sample to armed from the 4021 latching a new pad state to the
+                    keyboard IN descriptor handed to the SIE
+
+With -c a figure whose mean or max grew by more than -t percent is a
+regression, a figure missing on either side is noted. -s saves after the
+comparison and only when it passed, so "-c last -s last" compares each
+build with the last good one. make bench does that after every build.
+
+Exit status 1 on a regression, 2 when the firmware did something the
+bench doesn't model (see BenchError).
+
+Not modelled: the analog and timer 0/2 peripherals, the watchdog, sleep
+(the host never stops the SOFs, so the firmware never suspends) and the
+flash self write. Timer1 counts but never raises its interrupt.
+"""
+
+import re
+import sys
+
+CYCLES_PER_US = 12
+CYCLES_PER_FRAME = 12000
+INTERRUPT_LATENCY = 5       # Cycles from the interrupt to the first instruction at 0x0004, as budget.py
+STACK_LEVELS = 16
+PROGRAM_WORDS = 0x2000
+
+FUNCTIONS = ("NES_read_pad", "NES_read_paddle", "PadTask", "PaddleTask", "PrepareTxBuffer", "HIDSend",
+             "ProcessUSBTransactions")
+
+# Core registers, in every bank
+INDF0, INDF1, PCL, STATUS, FSR0L, FSR0H, FSR1L, FSR1H, BSR, WREG, PCLATH, INTCON = range(12)
+C, DC, Z = 0x01, 0x02, 0x04
+
+# SFRs by their banked address (PIC16F1455 data sheet, table 3-8)
+PORTA, PORTC, PIR1, PIR2 = 0x00C, 0x00E, 0x011, 0x012
+TMR1L, TMR1H, T1CON = 0x016, 0x017, 0x018
+TRISA, TRISC, PIE1, PIE2, OSCSTAT = 0x08C, 0x08E, 0x091, 0x092, 0x09A
+LATA, LATC = 0x10C, 0x10E
+UCON, USTAT, UIR, UCFG, UIE, UEIR, UFRMH, UFRML, UADDR, UEIE, UEP0 = range(0xE8E, 0xE99)
+
+# UCON, UIR bits
+USBEN, PKTDIS, SUSPND = 0x08, 0x10, 0x02
+URSTIF, UERRIF, TRNIF, SOFIF, STALLIF = 0x01, 0x02, 0x08, 0x40, 0x20
+USBIF = 0x04                # PIR2
+
+# Buffer descriptors
+BD_UOWN, BD_DTS, BD_DTSEN, BD_BSTALL = 0x80, 0x40, 0x08, 0x04
+PID_OUT, PID_IN, PID_SETUP = 0x01, 0x09, 0x0D
+USTAT_FIFO = 4
+
+ACK, NAK, STALL, NONE = "ACK", "NAK", "STALL", "no answer"
+
+# The PCBs as routed: PORTC bits of the 4021's data, latch and clock
+BOARDS = {1: (3, 5, 4), 2: (3, 4, 5)}
+
+# Host stub timing
+RESET_AFTER = 2 * CYCLES_PER_FRAME          # From USBEN to the bus reset
+RESET_RECOVERY = 10 * CYCLES_PER_FRAME      # From the reset to the first request
+ADDRESS_RECOVERY = 2 * CYCLES_PER_FRAME     # From SET_ADDRESS to the next request
+TOKEN_SPACING = 10 * CYCLES_PER_US
+POLL_OFFSET = 100 * CYCLES_PER_US
+TRANSFER_TIMEOUT = 50 * CYCLES_PER_FRAME
+
+
+class BenchError(Exception):
+    pass
+
+
+# Files
+
+def read_hex(path):
+    words = {}
+    high = 0
+    data = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith(":"):
+                continue
+            raw = bytes.fromhex(line[1:])
+            count, address, kind = raw[0], (raw[1] << 8) | raw[2], raw[3]
+            if kind == 0x00:
+                for i in range(count):
+                    data[(high << 16) + address + i] = raw[4 + i]
+            elif kind == 0x04:
+                high = (raw[4] << 8) | raw[5]
+            elif kind == 0x01:
+                break
+    for address, byte in data.items():
+        word = address >> 1
+        if word < PROGRAM_WORDS:
+            words[word] = words.get(word, 0) | (byte << (8 * (address & 1)))
+    return words
+
+
+def read_map(path):
+    """Symbol -> address from the map's symbol table"""
+    symbol = re.compile(r"^(\S+)\s+(\S+)\s+([0-9A-Fa-f]+)\s*$")
+    symbols = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = symbol.match(line)
+            if m:
+                symbols.setdefault(m.group(1), int(m.group(3), 16))
+    return symbols
+
+
+def read_trace(path):
+    entries = []
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            words = line.split("#")[0].split()
+            if not words:
+                continue
+            if len(words) < 2:
+                raise SystemExit("%s:%d: expected a frame and the pad byte" % (path, number))
+            entries.append((int(words[0]), int(words[1], 16) & 0xFF))
+    return entries
+
+
+def linear(address):
+    """Data address as the FSRs and the SIE see it -> banked address, None outside RAM"""
+    if address < 0x1000:
+        return address
+    if 0x2000 <= address < 0x29B0:
+        n = address - 0x2000
+        return ((n // 80) << 7) | (0x20 + n % 80)
+    return None
+
+
+def signed(value, bits):
+    return value - (1 << bits) if value & (1 << (bits - 1)) else value
+
+
+# Core
+
+class Pic:
+    def __init__(self, program):
+        self.program = program
+        self.code = [self.decode(program.get(pc)) for pc in range(PROGRAM_WORDS)]
+        self.ram = bytearray(0x1000)
+        self.read_hooks = {}
+        self.write_hooks = {}
+        self.pc = 0
+        self.w = 0
+        self.status = 0x18
+        self.bsr = 0
+        self.pclath = 0
+        self.fsr = [0, 0]
+        self.intcon = 0
+        self.stack = []
+        self.frames = []            # Per stack level: (function, start) of a watched call, or None
+        self.shadow = None
+        self.cycles = 0
+        self.extra = 0              # Cycles an instruction took on top of its own (flash reads, PCL)
+        self.jump = None            # PCL written
+        self.irq = False
+        self.watch = {}
+        self.calls = {}
+        self.on_irq = None
+
+    # Data memory
+
+    def read(self, address):
+        offset = address & 0x7F
+        if offset < 0x0C:
+            return self.core_read(offset)
+        if offset >= 0x70:
+            address = offset
+        hook = self.read_hooks.get(address)
+        return hook() if hook else self.ram[address]
+
+    def write(self, address, value):
+        offset = address & 0x7F
+        if offset < 0x0C:
+            self.core_write(offset, value)
+            return
+        if offset >= 0x70:
+            address = offset
+        hook = self.write_hooks.get(address)
+        if hook:
+            hook(value)
+        else:
+            self.ram[address] = value
+
+    def indirect_read(self, fsr):
+        if fsr & 0x8000:
+            self.extra += 1
+            return self.program.get(fsr & 0x7FFF, 0x3FFF) & 0xFF
+        address = linear(fsr)
+        if address is None or (address & 0x7F) in (INDF0, INDF1):
+            return 0
+        return self.read(address)
+
+    def indirect_write(self, fsr, value):
+        address = linear(fsr)
+        if fsr & 0x8000 or address is None or (address & 0x7F) in (INDF0, INDF1):
+            return
+        self.write(address, value)
+
+    def core_read(self, r):
+        if r == INDF0 or r == INDF1:
+            return self.indirect_read(self.fsr[r])
+        if r == PCL:
+            return self.pc & 0xFF
+        if r == STATUS:
+            return self.status
+        if r <= FSR1H:
+            fsr = self.fsr[(r - FSR0L) >> 1]
+            return (fsr >> 8) if (r - FSR0L) & 1 else fsr & 0xFF
+        if r == BSR:
+            return self.bsr
+        if r == WREG:
+            return self.w
+        if r == PCLATH:
+            return self.pclath
+        return self.intcon
+
+    def core_write(self, r, value):
+        if r == INDF0 or r == INDF1:
+            self.indirect_write(self.fsr[r], value)
+        elif r == PCL:
+            self.jump = value
+        elif r == STATUS:
+            self.status = (self.status & 0x18) | (value & 0x07)
+        elif r <= FSR1H:
+            n = (r - FSR0L) >> 1
+            if (r - FSR0L) & 1:
+                self.fsr[n] = (self.fsr[n] & 0x00FF) | (value << 8)
+            else:
+                self.fsr[n] = (self.fsr[n] & 0xFF00) | value
+        elif r == BSR:
+            self.bsr = value & 0x1F
+        elif r == WREG:
+            self.w = value
+        elif r == PCLATH:
+            self.pclath = value & 0x7F
+        else:
+            self.intcon = value
+            self.update_irq()
+
+    def update_irq(self):
+        ram = self.ram
+        pending = (self.intcon >> 3) & self.intcon & 0x07
+        if self.intcon & 0x40:
+            pending |= (ram[PIR1] & ram[PIE1]) | (ram[PIR2] & ram[PIE2])
+        self.irq = bool(pending)
+
+    # Instructions, each returns its cycles
+
+    def store(self, f, d, value):
+        value &= 0xFF
+        if d:
+            self.write((self.bsr << 7) | f, value)
+        else:
+            self.w = value
+
+    def fetch(self, f):
+        return self.read((self.bsr << 7) | f)
+
+    def flag_z(self, value):
+        self.status = (self.status & ~Z) | (Z if value & 0xFF == 0 else 0)
+
+    def add(self, a, b, carry):
+        result = a + b + carry
+        status = self.status & ~(C | DC | Z)
+        if result > 0xFF:
+            status |= C
+        if (a & 0x0F) + (b & 0x0F) + carry > 0x0F:
+            status |= DC
+        if result & 0xFF == 0:
+            status |= Z
+        self.status = status
+        return result & 0xFF
+
+    def subtract(self, a, b, borrow):
+        """a - b - borrow, C and DC set when nothing was borrowed"""
+        result = a - b - borrow
+        status = self.status & ~(C | DC | Z)
+        if result >= 0:
+            status |= C
+        if (a & 0x0F) - (b & 0x0F) - borrow >= 0:
+            status |= DC
+        if result & 0xFF == 0:
+            status |= Z
+        self.status = status
+        return result & 0xFF
+
+    def op_nop(self, a, b):
+        return 1
+
+    def op_bad(self, a, b):
+        raise BenchError("executed 0x%04X, outside the program" % ((self.pc - 1) & 0x1FFF))
+
+    def op_reset(self, a, b):
+        raise BenchError("RESET instruction at 0x%04X" % ((self.pc - 1) & 0x1FFF))
+
+    def op_movwf(self, f, b):
+        self.write((self.bsr << 7) | f, self.w)
+        return 1
+
+    def op_clrw(self, a, b):
+        self.w = 0
+        self.status |= Z
+        return 1
+
+    def op_clrf(self, f, b):
+        self.write((self.bsr << 7) | f, 0)
+        self.status |= Z
+        return 1
+
+    def op_subwf(self, f, d):
+        self.store(f, d, self.subtract(self.fetch(f), self.w, 0))
+        return 1
+
+    def op_subwfb(self, f, d):
+        self.store(f, d, self.subtract(self.fetch(f), self.w, 0 if self.status & C else 1))
+        return 1
+
+    def op_addwf(self, f, d):
+        self.store(f, d, self.add(self.fetch(f), self.w, 0))
+        return 1
+
+    def op_addwfc(self, f, d):
+        self.store(f, d, self.add(self.fetch(f), self.w, self.status & C))
+        return 1
+
+    def op_decf(self, f, d):
+        value = (self.fetch(f) - 1) & 0xFF
+        self.flag_z(value)
+        self.store(f, d, value)
+        return 1
+
+    def op_incf(self, f, d):
+        value = (self.fetch(f) + 1) & 0xFF
+        self.flag_z(value)
+        self.store(f, d, value)
+        return 1
+
+    def op_iorwf(self, f, d):
+        value = self.fetch(f) | self.w
+        self.flag_z(value)
+        self.store(f, d, value)
+        return 1
+
+    def op_andwf(self, f, d):
+        value = self.fetch(f) & self.w
+        self.flag_z(value)
+        self.store(f, d, value)
+        return 1
+
+    def op_xorwf(self, f, d):
+        value = self.fetch(f) ^ self.w
+        self.flag_z(value)
+        self.store(f, d, value)
+        return 1
+
+    def op_movf(self, f, d):
+        value = self.fetch(f)
+        self.flag_z(value)
+        self.store(f, d, value)
+        return 1
+
+    def op_comf(self, f, d):
+        value = ~self.fetch(f) & 0xFF
+        self.flag_z(value)
+        self.store(f, d, value)
+        return 1
+
+    def op_swapf(self, f, d):
+        value = self.fetch(f)
+        self.store(f, d, ((value << 4) | (value >> 4)) & 0xFF)
+        return 1
+
+    def op_rrf(self, f, d):
+        value = self.fetch(f)
+        carry = self.status & C
+        self.status = (self.status & ~C) | (value & 1)
+        self.store(f, d, (value >> 1) | (carry << 7))
+        return 1
+
+    def op_rlf(self, f, d):
+        value = self.fetch(f)
+        carry = self.status & C
+        self.status = (self.status & ~C) | (value >> 7)
+        self.store(f, d, (value << 1) | carry)
+        return 1
+
+    def op_lslf(self, f, d):
+        value = self.fetch(f)
+        self.status = (self.status & ~C) | (value >> 7)
+        self.flag_z(value << 1)
+        self.store(f, d, value << 1)
+        return 1
+
+    def op_lsrf(self, f, d):
+        value = self.fetch(f)
+        self.status = (self.status & ~C) | (value & 1)
+        self.flag_z(value >> 1)
+        self.store(f, d, value >> 1)
+        return 1
+
+    def op_asrf(self, f, d):
+        value = self.fetch(f)
+        self.status = (self.status & ~C) | (value & 1)
+        value = (value >> 1) | (value & 0x80)
+        self.flag_z(value)
+        self.store(f, d, value)
+        return 1
+
+    def op_decfsz(self, f, d):
+        value = (self.fetch(f) - 1) & 0xFF
+        self.store(f, d, value)
+        if value:
+            return 1
+        self.pc = (self.pc + 1) & 0x1FFF
+        return 2
+
+    def op_incfsz(self, f, d):
+        value = (self.fetch(f) + 1) & 0xFF
+        self.store(f, d, value)
+        if value:
+            return 1
+        self.pc = (self.pc + 1) & 0x1FFF
+        return 2
+
+    def op_bcf(self, f, bit):
+        address = (self.bsr << 7) | f
+        self.write(address, self.read(address) & ~(1 << bit) & 0xFF)
+        return 1
+
+    def op_bsf(self, f, bit):
+        address = (self.bsr << 7) | f
+        self.write(address, self.read(address) | (1 << bit))
+        return 1
+
+    def op_btfsc(self, f, bit):
+        if self.fetch(f) & (1 << bit):
+            return 1
+        self.pc = (self.pc + 1) & 0x1FFF
+        return 2
+
+    def op_btfss(self, f, bit):
+        if not self.fetch(f) & (1 << bit):
+            return 1
+        self.pc = (self.pc + 1) & 0x1FFF
+        return 2
+
+    def op_movlw(self, k, b):
+        self.w = k
+        return 1
+
+    def op_addlw(self, k, b):
+        self.w = self.add(self.w, k, 0)
+        return 1
+
+    def op_sublw(self, k, b):
+        self.w = self.subtract(k, self.w, 0)
+        return 1
+
+    def op_andlw(self, k, b):
+        self.w &= k
+        self.flag_z(self.w)
+        return 1
+
+    def op_iorlw(self, k, b):
+        self.w |= k
+        self.flag_z(self.w)
+        return 1
+
+    def op_xorlw(self, k, b):
+        self.w ^= k
+        self.flag_z(self.w)
+        return 1
+
+    def op_movlb(self, k, b):
+        self.bsr = k
+        return 1
+
+    def op_movlp(self, k, b):
+        self.pclath = k
+        return 1
+
+    def op_addfsr(self, n, k):
+        self.fsr[n] = (self.fsr[n] + k) & 0xFFFF
+        return 1
+
+    def op_moviw(self, n, mode):
+        fsr = self.fsr
+        if mode == 0:
+            fsr[n] = (fsr[n] + 1) & 0xFFFF
+        elif mode == 1:
+            fsr[n] = (fsr[n] - 1) & 0xFFFF
+        self.w = self.indirect_read(fsr[n])
+        self.flag_z(self.w)
+        if mode == 2:
+            fsr[n] = (fsr[n] + 1) & 0xFFFF
+        elif mode == 3:
+            fsr[n] = (fsr[n] - 1) & 0xFFFF
+        return 1
+
+    def op_movwi(self, n, mode):
+        fsr = self.fsr
+        if mode == 0:
+            fsr[n] = (fsr[n] + 1) & 0xFFFF
+        elif mode == 1:
+            fsr[n] = (fsr[n] - 1) & 0xFFFF
+        self.indirect_write(fsr[n], self.w)
+        if mode == 2:
+            fsr[n] = (fsr[n] + 1) & 0xFFFF
+        elif mode == 3:
+            fsr[n] = (fsr[n] - 1) & 0xFFFF
+        return 1
+
+    def op_moviw_k(self, n, k):
+        self.w = self.indirect_read((self.fsr[n] + k) & 0xFFFF)
+        self.flag_z(self.w)
+        return 1
+
+    def op_movwi_k(self, n, k):
+        self.indirect_write((self.fsr[n] + k) & 0xFFFF, self.w)
+        return 1
+
+    def push(self, target):
+        if len(self.stack) == STACK_LEVELS:
+            raise BenchError("hardware stack overflow at 0x%04X" % ((self.pc - 1) & 0x1FFF))
+        self.stack.append(self.pc)
+        name = self.watch.get(target)
+        self.frames.append((name, self.cycles) if name else None)
+        self.pc = target
+
+    def pop(self, extra):
+        if not self.stack:
+            raise BenchError("hardware stack underflow at 0x%04X" % ((self.pc - 1) & 0x1FFF))
+        self.pc = self.stack.pop()
+        frame = self.frames.pop()
+        if frame:
+            self.calls.setdefault(frame[0], []).append(self.cycles + extra - frame[1])
+
+    def op_call(self, k, b):
+        self.push(((self.pclath & 0x78) << 8) | k)
+        return 2
+
+    def op_callw(self, a, b):
+        self.push((self.pclath << 8) | self.w)
+        return 2
+
+    def op_goto(self, k, b):
+        self.pc = ((self.pclath & 0x78) << 8) | k
+        return 2
+
+    def op_bra(self, k, b):
+        self.pc = (self.pc + k) & 0x1FFF
+        return 2
+
+    def op_brw(self, a, b):
+        self.pc = (self.pc + self.w) & 0x1FFF
+        return 2
+
+    def op_return(self, a, b):
+        self.pop(2)
+        return 2
+
+    def op_retlw(self, k, b):
+        self.w = k
+        self.pop(2)
+        return 2
+
+    def op_retfie(self, a, b):
+        self.w, self.status, self.bsr, self.fsr[0], self.fsr[1], self.pclath = self.shadow
+        self.intcon |= 0x80
+        self.pop(2)
+        return 2
+
+    def op_sleep(self, a, b):
+        raise BenchError("SLEEP at 0x%04X, the bench doesn't model it" % ((self.pc - 1) & 0x1FFF))
+
+    def decode(self, word):
+        if word is None:
+            return self.op_bad, 0, 0
+        top = word >> 8
+        if word & 0x3F80 == 0x0080:
+            return self.op_movwf, word & 0x7F, 0
+        if top == 0x00:
+            if word == 0x0001:
+                return self.op_reset, 0, 0
+            if word == 0x0008:
+                return self.op_return, 0, 0
+            if word == 0x0009:
+                return self.op_retfie, 0, 0
+            if word == 0x000A:
+                return self.op_callw, 0, 0
+            if word == 0x000B:
+                return self.op_brw, 0, 0
+            if 0x0010 <= word <= 0x0017:
+                return self.op_moviw, (word >> 2) & 1, word & 3
+            if 0x0018 <= word <= 0x001F:
+                return self.op_movwi, (word >> 2) & 1, word & 3
+            if 0x0020 <= word <= 0x003F:
+                return self.op_movlb, word & 0x1F, 0
+            if word == 0x0063:
+                return self.op_sleep, 0, 0
+            return self.op_nop, 0, 0      # NOP, CLRWDT, OPTION, TRIS
+        if top == 0x01:
+            return (self.op_clrf, word & 0x7F, 0) if word & 0x80 else (self.op_clrw, 0, 0)
+        f, d = word & 0x7F, (word >> 7) & 1
+        if top < 0x10:
+            return {0x02: self.op_subwf, 0x03: self.op_decf, 0x04: self.op_iorwf, 0x05: self.op_andwf,
+                    0x06: self.op_xorwf, 0x07: self.op_addwf, 0x08: self.op_movf, 0x09: self.op_comf,
+                    0x0A: self.op_incf, 0x0B: self.op_decfsz, 0x0C: self.op_rrf, 0x0D: self.op_rlf,
+                    0x0E: self.op_swapf, 0x0F: self.op_incfsz}[top], f, d
+        if top < 0x20:
+            op = (self.op_bcf, self.op_bsf, self.op_btfsc, self.op_btfss)[(word >> 10) & 3]
+            return op, f, (word >> 7) & 7
+        if top < 0x28:
+            return self.op_call, word & 0x7FF, 0
+        if top < 0x30:
+            return self.op_goto, word & 0x7FF, 0
+        k = word & 0xFF
+        if top == 0x30:
+            return self.op_movlw, k, 0
+        if top == 0x31:
+            if word & 0x80:
+                return self.op_movlp, word & 0x7F, 0
+            return self.op_addfsr, (word >> 6) & 1, signed(word & 0x3F, 6)
+        if top in (0x32, 0x33):
+            return self.op_bra, signed(word & 0x1FF, 9), 0
+        if top == 0x3F:
+            op = self.op_movwi_k if word & 0x80 else self.op_moviw_k
+            return op, (word >> 6) & 1, signed(word & 0x3F, 6)
+        return {0x34: (self.op_retlw, k, 0), 0x35: (self.op_lslf, f, d), 0x36: (self.op_lsrf, f, d),
+                0x37: (self.op_asrf, f, d), 0x38: (self.op_iorlw, k, 0), 0x39: (self.op_andlw, k, 0),
+                0x3A: (self.op_xorlw, k, 0), 0x3B: (self.op_subwfb, f, d), 0x3C: (self.op_sublw, k, 0),
+                0x3D: (self.op_addwfc, f, d), 0x3E: (self.op_addlw, k, 0)}[top]
+
+    def interrupt(self):
+        self.shadow = (self.w, self.status, self.bsr, self.fsr[0], self.fsr[1], self.pclath)
+        self.intcon &= ~0x80
+        self.cycles += INTERRUPT_LATENCY
+        self.push(0x0004)
+        self.frames[-1] = ("ISRCode", self.cycles - INTERRUPT_LATENCY)
+
+    def run(self, until, event):
+        """Execute until the cycle count reaches until, calling event() when it reaches self.next_event"""
+        code = self.code
+        while self.cycles < until:
+            if self.cycles >= self.next_event:
+                event()
+            if self.irq and self.intcon & 0x80:
+                self.interrupt()
+                continue
+            op, a, b = code[self.pc]
+            self.pc = (self.pc + 1) & 0x1FFF
+            cycles = op(a, b)
+            if self.jump is not None:
+                self.pc = (self.pclath << 8) | self.jump
+                self.jump = None
+                cycles += 1
+            if self.extra:
+                cycles += self.extra
+                self.extra = 0
+            self.cycles += cycles
+
+
+# Board: the 4021 on PORTC, Timer1
+
+class Board:
+    def __init__(self, pic, revision):
+        self.pic = pic
+        self.data, self.latch, self.clock = BOARDS[revision]
+        self.pad = 0                # Buttons held, bit set = pressed
+        self.shift = 0xFF
+        self.last_latch = 0
+        self.last_clock = 0
+        self.latched = None         # Pad state at the last latch that changed it
+        self.changed_at = None      # ... and when, until the report is armed
+        self.t1 = 0
+        self.t1_at = 0
+        ram = pic.ram
+        ram[TRISA] = ram[TRISC] = 0xFF
+        ram[OSCSTAT] = 0xFF         # Every clock ready
+        pic.read_hooks[PORTA] = lambda: (ram[LATA] & ~ram[TRISA] | ram[TRISA]) & 0xFF
+        pic.read_hooks[PORTC] = self.read_portc
+        pic.write_hooks[PORTA] = lambda v: pic.write(LATA, v)
+        pic.write_hooks[PORTC] = lambda v: self.write_latc(v)
+        pic.write_hooks[LATC] = self.write_latc
+        pic.read_hooks[TMR1L] = lambda: self.timer1() & 0xFF
+        pic.read_hooks[TMR1H] = lambda: self.timer1() >> 8
+        pic.write_hooks[TMR1L] = lambda v: self.write_timer1((self.timer1() & 0xFF00) | v)
+        pic.write_hooks[TMR1H] = lambda v: self.write_timer1((self.timer1() & 0x00FF) | (v << 8))
+        pic.write_hooks[T1CON] = self.write_t1con
+        for register in (PIR1, PIR2, PIE1, PIE2):
+            pic.write_hooks[register] = self.make_irq_write(register)
+
+    def make_irq_write(self, register):
+        def write(value):
+            self.pic.ram[register] = value
+            self.pic.update_irq()
+        return write
+
+    def read_portc(self):
+        ram = self.pic.ram
+        pins = 0xFF & ~(1 << self.data) | ((self.shift & 1) << self.data)
+        return (ram[LATC] & ~ram[TRISC] | pins & ram[TRISC]) & 0xFF
+
+    def write_latc(self, value):
+        self.pic.ram[LATC] = value
+        latch = (value >> self.latch) & 1
+        clock = (value >> self.clock) & 1
+        if latch and not self.last_latch and self.pad != self.latched:
+            self.latched = self.pad
+            if self.changed_at is None:
+                self.changed_at = self.pic.cycles
+        if latch:
+            self.shift = ~self.pad & 0xFF
+        elif clock and not self.last_clock:
+            self.shift = (self.shift >> 1) | 0x80
+        self.last_latch = latch
+        self.last_clock = clock
+
+    def timer1(self):
+        t1con = self.pic.ram[T1CON]
+        if not t1con & 0x01:
+            return self.t1
+        ticks = self.pic.cycles - self.t1_at
+        if (t1con >> 6) & 3 == 1:
+            ticks *= 4              # Fosc, Fosc/4 otherwise
+        return (self.t1 + (ticks >> ((t1con >> 4) & 3))) & 0xFFFF
+
+    def write_timer1(self, value):
+        self.t1 = value
+        self.t1_at = self.pic.cycles
+
+    def write_t1con(self, value):
+        self.t1 = self.timer1()
+        self.t1_at = self.pic.cycles
+        self.pic.ram[T1CON] = value
+
+
+# SIE, as seen from the bus
+
+class Sie:
+    def __init__(self, pic, bdt):
+        self.pic = pic
+        self.bdt = bdt              # Linear address of the BDT
+        self.fifo = []
+        self.address = 0            # The host's tokens go to
+        ram = pic.ram
+        pic.write_hooks[UIR] = self.write_uir
+        for register in (UIE, UEIR, UEIE, PIR2):
+            pic.write_hooks[register] = self.make_write(register)
+        self.ram = ram
+
+    def make_write(self, register):
+        def write(value):
+            self.ram[register] = value
+            self.update()
+        return write
+
+    def write_uir(self, value):
+        ram = self.ram
+        cleared = ram[UIR] & ~value & TRNIF
+        ram[UIR] = value
+        if cleared:
+            self.advance()
+        self.update()
+
+    def update(self):
+        """USBIF follows the enabled flags, clearing it with one still up doesn't stick"""
+        ram = self.ram
+        if (ram[UIR] & ram[UIE]) or (ram[UEIR] & ram[UEIE]):
+            ram[PIR2] |= USBIF
+        self.pic.update_irq()
+
+    def advance(self):
+        """A cleared TRNIF brings the next completed transaction in"""
+        ram = self.ram
+        if ram[UIR] & TRNIF or not self.fifo:
+            return
+        ram[USTAT] = self.fifo.pop(0)
+        ram[UIR] |= TRNIF
+
+    def complete(self, ustat):
+        self.fifo.append(ustat)
+        self.advance()
+        self.update()
+
+    def flag(self, bits):
+        self.ram[UIR] |= bits
+        self.update()
+
+    def bd(self, n):
+        return linear(self.bdt + 4 * n)
+
+    def buffer(self, bd, count):
+        address = self.ram[bd + 2] | (self.ram[bd + 3] << 8)
+        out = []
+        for i in range(count):
+            at = linear(address + i) if address >= 0x2000 else address + i
+            if at is None:
+                raise BenchError("BDT points at 0x%04X, outside RAM" % address)
+            out.append(at)
+        return out
+
+    def token(self, ep, direction_in):
+        ram = self.ram
+        if not ram[UCON] & USBEN or ram[UCON] & SUSPND or self.address != ram[UADDR]:
+            return None, NONE
+        if ep > 7 or not ram[UEP0 + ep] & (0x02 if direction_in else 0x04):
+            return None, NONE
+        if ram[UCON] & PKTDIS or len(self.fifo) + bool(ram[UIR] & TRNIF) >= USTAT_FIFO:
+            return None, NAK
+        bd = self.bd(ep * 2 + direction_in)
+        if not ram[bd] & BD_UOWN:
+            return None, NAK
+        return bd, ACK
+
+    def setup(self, packet):
+        bd, handshake = self.token(0, 0)
+        if bd is None:
+            return handshake
+        for at, byte in zip(self.buffer(bd, 8), packet):
+            self.pic.write(at, byte)
+        self.ram[bd + 1] = 8
+        self.ram[bd] = PID_SETUP << 2
+        self.ram[UCON] |= PKTDIS
+        self.complete(0x00)
+        return ACK
+
+    def out(self, ep, toggle, data):
+        ram = self.ram
+        bd, handshake = self.token(ep, 0)
+        if bd is None:
+            return handshake
+        if ram[bd] & BD_BSTALL:
+            self.flag(STALLIF)
+            return STALL
+        if ram[bd] & BD_DTSEN and bool(ram[bd] & BD_DTS) != bool(toggle):
+            return ACK              # Dropped, the host doesn't know
+        data = data[:ram[bd + 1]]
+        for at, byte in zip(self.buffer(bd, len(data)), data):
+            self.pic.write(at, byte)
+        ram[bd + 1] = len(data)
+        ram[bd] = (PID_OUT << 2) | (BD_DTS if toggle else 0)
+        self.complete(ep << 3)
+        return ACK
+
+    def into(self, ep):
+        """IN token: (handshake, toggle, data)"""
+        ram = self.ram
+        bd, handshake = self.token(ep, 1)
+        if bd is None:
+            return handshake, 0, b""
+        if ram[bd] & BD_BSTALL:
+            self.flag(STALLIF)
+            return STALL, 0, b""
+        toggle = 1 if ram[bd] & BD_DTS else 0
+        data = bytes(self.pic.read(at) for at in self.buffer(bd, ram[bd + 1]))
+        ram[bd] = (PID_IN << 2) | (ram[bd] & BD_DTS)
+        self.complete((ep << 3) | 0x04)
+        return ACK, toggle, data
+
+
+# Host
+
+class Host:
+    """Enumerates the device, then polls the keyboard endpoint and plays the traces"""
+
+    def __init__(self, pic, sie, board, timeline, packet_size):
+        """packet_size is the endpoint 0 size assumed until the device descriptor gives it"""
+        self.pic = pic
+        self.sie = sie
+        self.board = board
+        self.timeline = timeline
+        self.packet_size = packet_size
+        self.state = "off"
+        self.next_sof = None
+        self.frame = 0
+        self.configured_frame = None
+        self.transfers = []
+        self.transfer = None
+        self.transfer_at = None
+        self.keyboard = 1
+        self.interval = 1
+        self.poll_toggle = 0
+        self.poll_due = None
+        self.reports = 0
+        self.toggle_errors = 0
+        self.step = 0
+        pic.next_event = CYCLES_PER_FRAME
+
+    def event(self):
+        pic = self.pic
+        now = pic.cycles
+        ram = pic.ram
+        if self.state == "off":
+            if ram[UCON] & USBEN:
+                self.state = "reset"
+                pic.next_event = now + RESET_AFTER
+            else:
+                pic.next_event = now + CYCLES_PER_FRAME
+            return
+        if self.state == "reset":
+            self.sie.fifo = []
+            self.sie.address = 0
+            self.sie.flag(URSTIF)
+            self.next_sof = now + CYCLES_PER_FRAME
+            self.state = "enumerate"
+            self.transfers = self.enumeration()
+            self.transfer_at = now + RESET_RECOVERY
+        if now >= self.next_sof:
+            self.sof()
+        if self.transfer_at is not None and now >= self.transfer_at:
+            self.control()
+        if self.poll_due is not None and now >= self.poll_due:
+            self.poll()
+        wake = [self.next_sof]
+        if self.transfer_at is not None:
+            wake.append(self.transfer_at)
+        if self.poll_due is not None:
+            wake.append(self.poll_due)
+        pic.next_event = max(min(wake), now + 1)
+
+    def sof(self):
+        ram = self.pic.ram
+        self.frame = (self.frame + 1) & 0x7FF
+        ram[UFRML] = self.frame & 0xFF
+        ram[UFRMH] = self.frame >> 8
+        self.sie.flag(SOFIF)
+        self.next_sof += CYCLES_PER_FRAME
+        if self.configured_frame is None:
+            return
+        frame = self.frame_count - self.configured_frame
+        self.frame_count += 1
+        while self.step < len(self.timeline) and self.timeline[self.step][0] <= frame:
+            self.board.pad = self.timeline[self.step][1]
+            self.step += 1
+        if frame % self.interval == 0:
+            self.poll_due = self.pic.cycles + POLL_OFFSET
+
+    # Endpoint 0
+
+    def enumeration(self):
+        return [
+            (0x80, 0x06, 0x0100, 0, 18, self.device),
+            (0x00, 0x05, 5, 0, 0, None),
+            (0x80, 0x06, 0x0200, 0, 9, self.configuration_length),
+            (0x00, 0x09, 1, 0, 0, self.configured),
+            (0x21, 0x0A, 0, 0, 0, None),
+        ]
+
+    def device(self, data):
+        if len(data) >= 8:
+            self.packet_size = data[7]
+
+    def configuration_length(self, data):
+        total = data[2] | (data[3] << 8)
+        self.transfers.insert(0, (0x80, 0x06, 0x0200, 0, total, self.configuration))
+
+    def configuration(self, data):
+        at = 0
+        interface = None
+        while at + 1 < len(data) and data[at]:
+            if data[at + 1] == 0x04:
+                interface = data[at + 2]
+            elif data[at + 1] == 0x05 and data[at + 2] & 0x80 and interface == 0:
+                self.keyboard = data[at + 2] & 0x0F
+                self.interval = max(data[at + 6], 1)
+            at += data[at]
+
+    def configured(self, data):
+        self.configured_frame = 0
+        self.frame_count = 0
+
+    def control(self):
+        now = self.pic.cycles
+        if self.transfer is None:
+            if not self.transfers:
+                self.transfer_at = None
+                return
+            request = self.transfers.pop(0)
+            self.transfer = {"request": request, "stage": "setup", "data": b"", "toggle": 1, "start": now}
+        transfer = self.transfer
+        kind, request, value, index, length, done = transfer["request"]
+        stage = transfer["stage"]
+        if now - transfer["start"] > TRANSFER_TIMEOUT:
+            raise BenchError("request 0x%02X 0x%02X 0x%04X: no answer in the %s stage" %
+                             (kind, request, value, stage))
+
+        if stage == "setup":
+            packet = bytes((kind, request, value & 0xFF, value >> 8, index & 0xFF, index >> 8,
+                            length & 0xFF, length >> 8))
+            handshake = self.sie.setup(packet)
+            if handshake == ACK:
+                transfer["stage"] = "status in" if length == 0 else "data in" if kind & 0x80 else "data out"
+        elif stage == "data in":
+            handshake, toggle, data = self.sie.into(0)
+            if handshake == ACK and toggle == transfer["toggle"]:
+                transfer["toggle"] ^= 1
+                transfer["data"] += data
+                if len(data) < self.packet_size or len(transfer["data"]) >= length:
+                    transfer["stage"] = "status out"
+        elif stage == "status out":
+            handshake = self.sie.out(0, 1, b"")
+            if handshake == ACK:
+                transfer["stage"] = "done"
+        elif stage == "status in":
+            handshake, toggle, data = self.sie.into(0)
+            if handshake == ACK:
+                transfer["stage"] = "done"
+        else:
+            raise BenchError("host stub has no %s stage" % stage)
+        if handshake == STALL:
+            raise BenchError("request 0x%02X 0x%02X 0x%04X stalled" % (kind, request, value))
+        self.transfer_at = now + TOKEN_SPACING
+        if transfer["stage"] == "done":
+            # The next transfer waits for the next frame, as a host schedules them
+            self.transfer = None
+            self.transfer_at = self.next_sof + TOKEN_SPACING
+            if request == 0x05:
+                self.sie.address = value
+                self.transfer_at = max(self.transfer_at, now + ADDRESS_RECOVERY)
+            if done:
+                done(transfer["data"])
+
+    # Keyboard endpoint
+
+    def poll(self):
+        self.poll_due = None
+        handshake, toggle, data = self.sie.into(self.keyboard)
+        if handshake != ACK:
+            return
+        if toggle != self.poll_toggle:
+            self.toggle_errors += 1
+            return
+        self.poll_toggle ^= 1
+        self.reports += 1
+
+
+# Results
+
+def summary(samples):
+    return len(samples), min(samples), sum(samples) / len(samples), max(samples)
+
+
+def read_saved(path):
+    saved = {}
+    with open(path) as f:
+        for line in f:
+            words = line.split()
+            if len(words) == 5 and not line.startswith("#"):
+                saved[words[0]] = (int(words[1]), int(words[2]), float(words[3]), int(words[4]))
+    return saved
+
+
+def compare(figures, saved, tolerance):
+    failed = 0
+    for name in sorted(set(figures) | set(saved)):
+        if name not in saved:
+            print("NEW %-26s nothing to compare with" % name)
+            continue
+        if name not in figures:
+            print("GONE %-25s in the saved run only" % name)
+            continue
+        for what, now, then in (("mean", figures[name][2], saved[name][2]), ("max", figures[name][3], saved[name][3])):
+            if now > then * (1 + tolerance / 100.0):
+                print("REGRESSION %-19s %s %.1f > %.1f (+%.1f%%)" % (name, what, now, then, 100.0 * (now - then) / then))
+                failed = 1
+    return failed
+
+
+def usage():
+    sys.exit(__doc__)
+
+
+def main():
+    args = sys.argv[1:]
+    options = {"--board": 2, "--frames": None, "-t": 10}
+    save = compare_to = None
+    files = []
+    while args:
+        arg = args.pop(0)
+        if arg in ("-s", "-c") and args:
+            if arg == "-s":
+                save = args.pop(0)
+            else:
+                compare_to = args.pop(0)
+        elif arg in options and args:
+            options[arg] = int(args.pop(0), 0)
+        elif arg.startswith("-"):
+            usage()
+        else:
+            files.append(arg)
+    hexes = [f for f in files if f.endswith(".hex")]
+    maps = [f for f in files if f.endswith(".map")]
+    traces = [f for f in files if not f.endswith((".hex", ".map"))]
+    if len(hexes) != 1 or len(maps) != 1 or options["--board"] not in BOARDS:
+        usage()
+
+    program = read_hex(hexes[0])
+    symbols = read_map(maps[0])
+    timeline = []
+    start = 0
+    for path in traces:
+        entries = read_trace(path)
+        timeline += [(start + frame, buttons) for frame, buttons in entries]
+        if entries:
+            start += entries[-1][0] + 1
+    frames = options["--frames"]
+    if frames is None:
+        frames = start + 100 if traces else 1000
+
+    pic = Pic(program)
+    for name in FUNCTIONS:
+        if "_" + name in symbols:
+            pic.watch[symbols["_" + name]] = name
+    bdt = symbols.get("_Interfaces", 0x2000)
+    if bdt < 0x1000:
+        bdt = 0x2000 + (bdt >> 7) * 80 + (bdt & 0x7F) - 0x20
+    board = Board(pic, options["--board"])
+    sie = Sie(pic, bdt)
+    host = Host(pic, sie, board, timeline, 8)
+
+    # Every armed keyboard report ends a sample to armed measurement
+    armed = []
+
+    def watch_keyboard_bd():
+        address = sie.bd(host.keyboard * 2 + 1)
+        pic.write_hooks.pop(address, None)
+
+        def write(value):
+            if value & BD_UOWN and not pic.ram[address] & BD_UOWN and board.changed_at is not None:
+                armed.append(pic.cycles - board.changed_at)
+                board.changed_at = None
+            pic.ram[address] = value
+        pic.write_hooks[address] = write
+
+    configured = host.configured
+
+    def on_configured(data):
+        configured(data)
+        watch_keyboard_bd()
+        board.changed_at = None
+    host.configured = on_configured
+    host.transfers = host.enumeration()
+
+    try:
+        while host.configured_frame is None:
+            if pic.cycles > 2000 * CYCLES_PER_FRAME:
+                raise BenchError("not configured after 2000 frames")
+            pic.run(pic.cycles + CYCLES_PER_FRAME, host.event)
+        pic.calls.clear()
+        pic.run(pic.cycles + frames * CYCLES_PER_FRAME, host.event)
+    except BenchError as e:
+        print("bench: %s at cycle %d" % (e, pic.cycles), file=sys.stderr)
+        sys.exit(2)
+
+    figures = {}
+    for name, samples in pic.calls.items():
+        figures[name] = summary(samples)
+    if armed:
+        figures["sample-to-armed"] = summary(armed)
+
+    print("%-28s %7s %8s %9s %8s %8s" % ("Cycles", "calls", "min", "mean", "max", "max us"))
+    for name in sorted(figures, key=lambda n: (n != "ISRCode", n.lower())):
+        count, low, mean, high = figures[name]
+        print("%-28s %7d %8d %9.1f %8d %8.1f" % (name, count, low, mean, high, high / float(CYCLES_PER_US)))
+    for name in FUNCTIONS:
+        if "_" + name not in symbols:
+            continue
+        if name not in figures:
+            print("NOT CALLED %-17s in the map, but the run never called it" % name)
+    print("%d frames, %d keyboard reports, %d toggle errors, %d cycles" %
+          (frames, host.reports, host.toggle_errors, pic.cycles))
+
+    failed = 0
+    if compare_to:
+        try:
+            saved = read_saved(compare_to)
+        except IOError:
+            print("no saved run in %s, nothing to compare with" % compare_to)
+            saved = None
+        if saved is not None:
+            failed = compare(figures, saved, options["-t"])
+    if save and not failed:
+        with open(save, "w") as f:
+            f.write("# name calls min mean max, cycles (tools/bench.py)\n")
+            for name in sorted(figures):
+                count, low, mean, high = figures[name]
+                f.write("%s %d %d %.1f %d\n" % (name, count, low, mean, high))
+    sys.exit(failed)
+
+
+if __name__ == "__main__":
+    main()
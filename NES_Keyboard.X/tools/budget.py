@@ -0,0 +1,582 @@
+#!/usr/bin/env python3
+"""
+Per-module RAM / flash budget from an XC8 map file, worst case cycles and
+hardware stack depth from the listing, checked against tools/budget.cfg.
+
+XC8 links the whole program as one object, so the map has no per-file
+breakdown. Instead every symbol in the map's symbol table is sized by the
+distance to the next symbol in the same psect (or the psect end) and then
+charged to the source file that defines it.
+
+    python3 tools/budget.py [-c tools/budget.cfg] IMAGE.map [IMAGE.lst] Source/*.c Source/*.h
+
+Flash is in program words. Absolute objects (the BDT and USB buffers) are
+placed by UsbDescriptors.h and not counted here.
+
+Cycles are worst case instruction cycles (Fosc/4, 12 per us) of each
+function including its callees, decoded from the opcodes in the listing.
+Loops counted down by decfsz/incfsz are bounded by their counter (the
+literal it is loaded with, 256 otherwise), including the __delay_us()
+loops. Any other loop needs a name, a "// loop:Name" comment on the line
+of its for, while or do, and a "loop Name N" bound in the config, N being
+how many times its body can start per entry to the loop; until it has one
+its function and every caller is reported as unbounded. Library routines
+have no source, their loops go by the function's name. Indirect calls are
+charged the slowest function XC8 says they can reach.
+
+The stack is the deepest call chain from main plus the deepest one from
+the interrupt, against the 16 levels of the PIC16F1455's hardware stack.
+
+With -c every budget in the config is checked and the exit status is 1 if
+any is exceeded, if a budgeted function is neither in the listing nor
+defined in the sources, or if a loop bound names neither a loop: marker
+nor a function. A budgeted function the options leave out is only noted.
+make budget runs it, and so does every make build.
+"""
+
+import re
+import sys
+from collections import defaultdict
+
+RAM_PREFIXES = ("bss", "data", "nv", "cstack")
+FLASH_PREFIXES = ("text", "maintext", "intentry", "init", "cinit", "stringtext", "idata", "const")
+PIC16F1455_RAM = 1024
+PIC16F1455_FLASH = 8192
+PIC16F1455_STACK = 16
+CYCLES_PER_US = 12.0
+INTERRUPT_LATENCY = 5   # Cycles from the interrupt to the first instruction at 0x0004
+
+SYMBOL = re.compile(r"^(\S+)\s+(\S+)\s+([0-9A-Fa-f]+)\s*$")
+PSECT = re.compile(r"^\s*(\S+)\s+([0-9A-Fa-f]+)\s+([0-9A-Fa-f]+)\s+([0-9A-Fa-f]+)\s+")
+
+# Listing lines: line number, address, then opcode words and the mnemonic or a label
+CODE = re.compile(r"^\s*\d+\s+([0-9A-F]{4})((?:\s+[0-9A-F]{4})+)\s+([a-z]\w*)\s*([^;]*)")
+LABEL = re.compile(r"^\s*\d+\s+([0-9A-F]{4})\s+([\w$?@.]+):")
+SOURCE = re.compile(r";(?:\S*/)?([\w.]+\.[ch]): (\d+):")
+LOOP_LINE = re.compile(r"^\s*(?:\}\s*)?(?:for|while|do)\b")
+LOOP_MARKER = re.compile(r"//.*\bloop:(\w+)")
+EXIT = -1
+
+
+def read_map(path):
+    psects = {}
+    symbols = []
+    in_symbols = False
+    with open(path, errors="replace") as f:
+        for line in f:
+            if line.strip() == "Symbol Table":
+                in_symbols = True
+                continue
+            if in_symbols:
+                m = SYMBOL.match(line)
+                if m:
+                    symbols.append((m.group(1), m.group(2), int(m.group(3), 16)))
+                continue
+            # The first table has the psect lengths, later ones other columns
+            m = PSECT.match(line)
+            if m:
+                link, length = int(m.group(2), 16), int(m.group(4), 16)
+                psects.setdefault(m.group(1), (link, link + length))
+    return psects, symbols
+
+
+def size_symbols(psects, symbols):
+    by_psect = defaultdict(list)
+    for name, psect, addr in symbols:
+        # Compiler markers (__Lxxx, __ptextN...) would shadow the object at the
+        # same address, only __end_of_ is kept as a boundary
+        if name.startswith("__") and not name.startswith("__end_of_"):
+            continue
+        if psect in psects and psects[psect][0] <= addr <= psects[psect][1]:
+            by_psect[psect].append((addr, name))
+    sizes = {}
+    for psect, entries in by_psect.items():
+        entries.sort()
+        end = psects[psect][1]
+        for n, (addr, name) in enumerate(entries):
+            if name.startswith("__"):
+                continue
+            stop = entries[n + 1][0] if n + 1 < len(entries) else end
+            sizes[name] = (psect, max(stop - addr, 0))
+    return sizes
+
+
+def owners(sources):
+    # Top level definitions only: a type and a name at column 0
+    define = re.compile(r"^(?:static\s+|volatile\s+|const\s+)*[A-Za-z_][\w\s\*]*?\b([A-Za-z_]\w*)\s*(?:\[|\(|=|;|__at)")
+    found = {}
+    # Sources before headers, so a prototype never claims a function
+    for path in sorted(sources, key=lambda p: p.endswith(".h")):
+        with open(path, errors="replace") as f:
+            for line in f:
+                m = define.match(line)
+                if m and not line.startswith(("return", "typedef", "extern")):
+                    found.setdefault("_" + m.group(1), path.split("/")[-1])
+    return found
+
+
+def loop_markers(sources):
+    """Source lines a loop can be listed at -> the name in its loop: marker"""
+    found = {}
+    for path in sources:
+        name = path.split("/")[-1]
+        with open(path, errors="replace") as f:
+            lines = f.readlines()
+        for n, line in enumerate(lines):
+            m = LOOP_MARKER.search(line)
+            if not m or not LOOP_LINE.match(line):
+                continue
+            # XC8 puts a loop on the first statement of its body: a few
+            # lines down, never past the next loop, or the loop's own line
+            # when it is all on one
+            last = n + 1 if line.split("//")[0].rstrip().endswith(";") else min(n + 5, len(lines))
+            for at in range(n, last):
+                if at > n and LOOP_LINE.match(lines[at]):
+                    break
+                found["%s:%d" % (name, at + 1)] = m.group(1)
+    return found
+
+
+def kind(psect):
+    name = psect.lower()
+    if name.startswith(RAM_PREFIXES):
+        return "ram"
+    if name.startswith(FLASH_PREFIXES):
+        return "flash"
+    return None
+
+
+def module_totals(map_path, sources):
+    psects, symbols = read_map(map_path)
+    sizes = size_symbols(psects, symbols)
+    where = owners(sources)
+
+    totals = defaultdict(lambda: {"ram": 0, "flash": 0})
+    for name, (psect, size) in sizes.items():
+        k = kind(psect)
+        if k:
+            # Locals and parameters are Function@name in the compiled stack
+            owner = "_" + name.split("@")[0] if "@" in name else name
+            totals[where.get(owner, "(runtime)")][k] += size
+    return totals
+
+
+class Instruction:
+    def __init__(self, addr, words, mnemonic, operands, source):
+        self.addr = addr
+        self.words = words
+        self.mnemonic = mnemonic
+        self.operands = operands.strip()
+        self.source = source
+        self.cycles = 0
+        self.flow = "next"      # next, skip, jump, call, callw, computed, return, stop
+        self.target = None
+        page = None
+        for n, word in enumerate(words):
+            at = addr + n
+            if 0x3180 <= word <= 0x31FF:                        # movlp
+                page = (word & 0x7F) << 8
+                self.cycles += 1
+            elif 0x2000 <= word <= 0x2FFF:                      # call, goto
+                self.flow = "call" if word < 0x2800 else "jump"
+                self.target = (page if page is not None else at & 0x7800) | (word & 0x7FF)
+                self.cycles += 2
+            elif 0x3200 <= word <= 0x33FF:                      # bra
+                offset = word & 0x1FF
+                self.flow = "jump"
+                self.target = at + 1 + (offset - 0x200 if offset & 0x100 else offset)
+                self.cycles += 2
+            elif word in (0x0008, 0x0009) or 0x3400 <= word <= 0x34FF:  # return, retfie, retlw
+                self.flow = "return"
+                self.cycles += 2
+            elif word == 0x000A:
+                self.flow = "callw"
+                self.cycles += 2
+            elif word in (0x000B, 0x0082) or (word & 0xFF7F) == 0x0702 and word & 0x80:  # brw, movwf/addwf PCL
+                self.flow = "computed"
+                self.cycles += 2
+            elif word == 0x0001:                                # reset
+                self.flow = "stop"
+                self.cycles += 1
+            elif 0x1800 <= word <= 0x1FFF or (word & 0xFF00) in (0x0B00, 0x0F00):  # btfsc/btfss, decfsz/incfsz
+                self.flow = "skip"
+                self.cycles += 1
+            else:
+                self.cycles += 1
+
+    def counts(self, skip):
+        """The register this steps towards zero for the skip, if it does"""
+        word = self.words[-1]
+        if self is skip and (word & 0xFF00) in (0x0B00, 0x0F00) and word & 0x80:   # decfsz/incfsz f,f
+            return self.operands.split(",")[0].strip()
+        if skip.words[-1] != 0x1D03:    # skipz
+            return None
+        if word == 0x3EFF:              # addlw -1
+            return "9"
+        if (word & 0xFF80) == 0x0380:   # decf f,f
+            return self.operands.split(",")[0].strip()
+        return None
+
+    def writes(self, register):
+        operands = [o.strip() for o in self.operands.split(",")]
+        if self.flow in ("call", "callw"):
+            return register == "9"
+        if register == "9":
+            return (self.mnemonic.endswith("lw") or self.mnemonic == "moviw" or operands[-1] == "w"
+                    or (operands[0] == "9" and operands[-1] == "f"))
+        if operands[0] != register:
+            return False
+        return self.mnemonic in ("movwf", "clrf", "bsf", "bcf") or operands[-1] == "f"
+
+
+class Function:
+    def __init__(self, name):
+        self.name = name
+        self.calls = []
+        self.interrupt = False
+        self.code = []
+        self.timing = None
+
+
+def read_listing(path):
+    functions = {}
+    current = None
+    section = None
+    body = None
+    source = "?"
+    with open(path, errors="replace") as f:
+        for line in f:
+            if ";;" in line and not CODE.match(line):
+                text = line.split(";;", 1)[1].strip()
+                if text.startswith("*************** function "):
+                    current = functions.setdefault(text.split()[2][1:], Function(text.split()[2][1:]))
+                    section = None
+                elif text.startswith("This function calls:"):
+                    section = "calls"
+                elif text.startswith("This function is called by:"):
+                    section = "called by"
+                elif current and section == "calls" and text.startswith("_"):
+                    current.calls.append(text[1:])
+                elif current and section == "called by" and text.startswith("Interrupt level"):
+                    current.interrupt = True
+                elif not text.startswith("_") and text != "Nothing":
+                    section = None
+                continue
+
+            sources = SOURCE.findall(line)
+            if sources:
+                source = "%s:%s" % sources[-1]
+            m = LABEL.match(line)
+            if m:
+                label = m.group(2)
+                if label.startswith("_") and label[1:] in functions:
+                    body = functions[label[1:]]
+                    source = body.name     # Library routines have no source lines
+                elif label.startswith("__end_of_"):
+                    body = None
+                continue
+            m = CODE.match(line)
+            if m and body is not None:
+                words = [int(w, 16) for w in m.group(2).split()]
+                body.code.append(Instruction(int(m.group(1), 16), words, m.group(3), m.group(4), source))
+    return functions
+
+
+class Timing:
+    def __init__(self, cycles=None, forever=None, problems=None):
+        self.cycles = cycles        # Worst case to the return, None if unbounded
+        self.forever = forever      # Cycles per pass when the function never returns
+        self.problems = problems or []
+
+
+def loop_bound(code, lo, hi, preds, bounds):
+    """Most times the body of the loop lo..hi can start per entry, or None"""
+    # Counted: the back jump follows a decfsz, or a skipz after a decrement
+    step = counter = None
+    if hi > lo and code[hi].flow == "jump" and code[hi - 1].flow == "skip":
+        for step in (hi - 1, hi - 2):
+            counter = code[step].counts(code[hi - 1]) if step >= lo else None
+            if counter:
+                break
+    if counter and not any(code[n].writes(counter) for n in range(lo, hi + 1) if n != step):
+        # Entered only by falling in from a straight run that loads the counter
+        if all(p == lo - 1 or lo <= p <= hi for p in preds[lo]):
+            n = lo - 1
+            while n >= 0 and lo - n <= 8 and code[n].flow == "next":
+                if code[n].writes(counter):
+                    loaded = code[n - 1] if counter != "9" and code[n].mnemonic == "movwf" else code[n]
+                    if loaded.mnemonic == "movlw":
+                        try:
+                            return int(loaded.operands, 0) or 256
+                        except ValueError:
+                            pass
+                    break
+                if preds[n] != [n - 1]:
+                    break
+                n -= 1
+        return bounds.get(code[lo].source, 256)
+    return bounds.get(code[lo].source)
+
+
+def analyse(function, functions, bounds, stack=()):
+    if function.timing is not None:
+        return function.timing
+    if function.name in stack:
+        return Timing(problems=["recursion through %s" % function.name])
+
+    code = function.code
+    index = {ins.addr: n for n, ins in enumerate(code)}
+    entries = {f.code[0].addr: f for f in functions.values() if f.code}
+    problems = []
+    cost = []
+    succ = []
+    for n, ins in enumerate(code):
+        extra = 0
+        edges = []
+        if ins.flow in ("call", "jump") and ins.target not in index or ins.flow == "call":
+            callee = entries.get(ins.target)
+            if callee is None and ins.flow == "jump":
+                ins.flow = "stop"   # main's ljmp back to start
+            elif callee is None:
+                problems.append("%s: %s to 0x%04X, not a function" % (ins.source, ins.mnemonic, ins.target))
+            else:
+                timing = analyse(callee, functions, bounds, stack + (function.name,))
+                if timing.cycles is None:
+                    problems.extend(timing.problems or ["%s never returns" % callee.name])
+                else:
+                    extra = timing.cycles
+        elif ins.flow == "callw":
+            slowest = 4     # No indirect callees: a brw into a retlw table
+            for name in function.calls:
+                if name in functions:
+                    timing = analyse(functions[name], functions, bounds, stack + (function.name,))
+                    if timing.cycles is None:
+                        problems.extend(timing.problems)
+                    else:
+                        slowest = max(slowest, timing.cycles)
+            extra = slowest
+
+        if ins.flow in ("next", "call", "callw"):
+            edges.append((n + 1, 0))
+        elif ins.flow == "skip":
+            edges += [(n + 1, 0), (n + 2, 1)]
+        elif ins.flow == "jump":
+            edges.append((index[ins.target], 0) if ins.target in index else (EXIT, 0))
+        elif ins.flow == "computed":
+            # A jump table: the gotos that follow
+            table = n + 1
+            while table < len(code) and code[table].flow in ("jump", "return"):
+                edges.append((table, 0))
+                table += 1
+            if not edges:
+                problems.append("%s: computed jump" % ins.source)
+        elif ins.flow == "return":
+            edges.append((EXIT, 0))
+        cost.append(ins.cycles + extra)
+        succ.append([(t if t < len(code) else EXIT, x) for t, x in edges])
+
+    preds = [[] for _ in code]
+    for n, edges in enumerate(succ):
+        for t, _ in edges:
+            if t != EXIT:
+                preds[t].append(n)
+
+    # Loops are the ranges under a backward jump, collapsed innermost first
+    # into one node costing their whole run
+    heads = {}
+    for n, edges in enumerate(succ):
+        for t, _ in edges:
+            if t != EXIT and t <= n:
+                heads[t] = max(heads.get(t, t), n)
+    loops = sorted(heads.items(), key=lambda loop: loop[1] - loop[0])
+    for a, (lo, hi) in enumerate(loops):
+        for lo2, hi2 in loops[a + 1:]:
+            if lo < lo2 <= hi < hi2 or lo2 < lo <= hi2 < hi:
+                problems.append("%s: loops overlap" % code[lo].source)
+
+    rep = list(range(len(code)))
+    span = {n: (n, n) for n in range(len(code))}
+    returns = set()
+
+    def longest(lo, hi, loop):
+        """Worst (pass, exit) through lo..hi: back to lo, and out of the range"""
+        members = sorted(set(rep[n] for n in range(lo, hi + 1)), key=lambda r: span[r][0])
+        best = {}
+        for r in members:
+            first = span[r][0]
+            if first == lo or first == 0 or any(not lo <= p <= hi for p in preds[first]):
+                best[r] = cost[r]
+        back = out = None
+        for r in members:
+            if r not in best:
+                continue
+            for n in range(span[r][0], span[r][1] + 1):
+                if rep[n] != r:
+                    continue
+                for t, x in succ[n]:
+                    reach = best[r] + x
+                    if t == EXIT or not lo <= t <= hi:
+                        out = max(out or 0, reach)
+                    elif rep[t] == r:
+                        continue
+                    elif loop and t == lo:
+                        back = max(back or 0, reach)
+                    elif span[rep[t]][0] <= span[r][0]:
+                        problems.append("%s: jump into a loop" % code[n].source)
+                    else:
+                        best[rep[t]] = max(best.get(rep[t], 0), reach + cost[rep[t]])
+        return back, out
+
+    forever = None
+    for lo, hi in loops:
+        bound = loop_bound(code, lo, hi, preds, bounds)
+        back, out = longest(lo, hi, True)
+        node = len(cost)
+        if out is None:
+            forever = back
+            cost.append(back)
+        elif bound is None:
+            problems.append("%s: loop with no bound" % code[lo].source)
+            cost.append(out)
+        else:
+            cost.append((bound - 1) * (back or 0) + out)
+        span[node] = (lo, hi)
+        for n in range(lo, hi + 1):
+            rep[n] = node
+
+    problems = list(dict.fromkeys(problems))
+    if forever is not None:
+        function.timing = Timing(forever=None if problems else forever, problems=problems)
+    elif not code:
+        function.timing = Timing(problems=["%s is not in the listing" % function.name])
+    else:
+        function.timing = Timing(None if problems else longest(0, len(code) - 1, False)[1], problems=problems)
+    return function.timing
+
+
+def stack_depth(name, functions, seen=()):
+    """Levels a call to the function needs and the deepest chain under it"""
+    if name in seen or name not in functions:
+        return 1, [name]
+    depth, chain = 0, []
+    for callee in functions[name].calls:
+        d, c = stack_depth(callee, functions, seen + (name,))
+        if d > depth:
+            depth, chain = d, c
+    return depth + 1, [name] + chain
+
+
+def read_budgets(path):
+    budgets = []
+    bounds = {}
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            words = line.split("#")[0].split()
+            if not words:
+                continue
+            if words[0] == "loop" and len(words) == 3:
+                bounds[words[1]] = int(words[2], 0)
+            elif words[0] == "cycles" and len(words) == 3:
+                budgets.append(("cycles", words[1], int(words[2], 0)))
+            elif words[0] in ("stack", "ram", "flash") and len(words) == 2:
+                budgets.append((words[0], None, int(words[1], 0)))
+            else:
+                sys.exit("%s:%d: can't parse '%s'" % (path, number, line.strip()))
+    return budgets, bounds
+
+
+def over(what, used, budget):
+    if used is None:
+        print("OVER BUDGET %-24s unbounded, budget %d" % (what, budget))
+        return 1
+    if used <= budget:
+        return 0
+    print("OVER BUDGET %-24s %d > %d" % (what, used, budget))
+    return 1
+
+
+def main():
+    args = sys.argv[1:]
+    config = None
+    if len(args) > 1 and args[0] == "-c":
+        config, args = args[1], args[2:]
+    maps = [a for a in args if a.endswith(".map")]
+    listings = [a for a in args if a.endswith(".lst")]
+    sources = [a for a in args if a.endswith((".c", ".h"))]
+    if len(maps) != 1 or len(listings) > 1 or not sources:
+        sys.exit(__doc__)
+    budgets, named = read_budgets(config) if config else ([], {})
+    markers = loop_markers(sources)
+    # analyse() looks loops up by source line, library routines by name
+    bounds = {line: named[name] for line, name in markers.items() if name in named}
+    bounds.update((name, bound) for name, bound in named.items() if name not in markers.values())
+
+    totals = module_totals(maps[0], sources)
+    ram = sum(t["ram"] for t in totals.values())
+    flash = sum(t["flash"] for t in totals.values())
+    print("%-20s %8s %8s" % ("Module", "RAM", "Flash"))
+    for module in sorted(totals, key=lambda m: -totals[m]["ram"]):
+        print("%-20s %8d %8d" % (module, totals[module]["ram"], totals[module]["flash"]))
+    print("%-20s %8d %8d" % ("Total", ram, flash))
+    print("%-20s %8d %8d" % ("Free", PIC16F1455_RAM - ram, PIC16F1455_FLASH - flash))
+
+    cycles = {}
+    stack = None
+    if listings:
+        functions = read_listing(listings[0])
+        problems = []
+        print()
+        print("%-28s %8s %8s %6s" % ("Function", "Cycles", "us", "Stack"))
+        for name in sorted(functions, key=lambda n: (not functions[n].interrupt, n.lower())):
+            function = functions[name]
+            timing = analyse(function, functions, bounds)
+            used = timing.cycles
+            if used is not None and function.interrupt:
+                used += INTERRUPT_LATENCY
+            cycles[name] = used
+            levels = stack_depth(name, functions)[0]
+            if used is not None:
+                print("%-28s %8d %8.1f %6d" % (name, used, used / CYCLES_PER_US, levels))
+            elif timing.forever is not None:
+                print("%-28s %8s %8s %6d   (%d cycles per pass)" % (name, "forever", "", levels, timing.forever))
+            else:
+                print("%-28s %8s %8s %6d" % (name, "?", "", levels))
+            problems += [p for p in timing.problems if p not in problems]
+
+        # main is jumped to, so its own level isn't used; an interrupt pushes one like a call
+        depth, chain = stack_depth("main", functions)
+        isr_depth, isr_chain = max(stack_depth(f, functions) for f in functions if functions[f].interrupt)
+        stack = depth - 1 + isr_depth
+        print("Stack %d of %d levels: %s, then %s" % (stack, PIC16F1455_STACK, " > ".join(chain),
+                                                  " > ".join(isr_chain)))
+        for problem in problems:
+            print("  " + problem)
+
+    failed = over("stack", stack, PIC16F1455_STACK) if stack is not None else 0
+    if listings:
+        # A marker in code the options left out is fine, a name nothing has isn't
+        for name in named:
+            if name not in markers.values() and name not in functions:
+                print("NO LOOP %-28s no loop:%s marker in the sources or function in the listing" % (name, name))
+                failed = 1
+    defined = owners(sources)
+    for what, name, budget in budgets:
+        if what == "cycles" and listings:
+            if name not in cycles and "_" + name in defined:
+                print("NOT BUILT %-26s left out by the options, its budget isn't checked" % name)
+            elif name not in cycles:
+                print("NO FUNCTION %-24s not in the listing or the sources, its budget can't be checked" % name)
+                failed = 1
+            else:
+                failed |= over("cycles " + name, cycles[name], budget)
+        elif what == "stack" and stack is not None:
+            failed |= over("stack", stack, budget)
+        elif what == "ram":
+            failed |= over("ram", ram, budget)
+        elif what == "flash":
+            failed |= over("flash", flash, budget)
+    sys.exit(failed)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,72 @@
+/*
+ * Finding the NES Keyboard vendor interface among the hidraw nodes, shared
+ * by the host tools in this directory.
+ */
+
+#ifndef NES_HIDRAW_H
+#define NES_HIDRAW_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/hidraw.h>
+
+#define VENDOR_ID           0x04D8
+#define PRODUCT_ID          0x01A6
+
+/* Start of the vendor interface report descriptor */
+static const uint8_t vendor_report[] = { 0x06, 0x00, 0xff, 0x09, 0x02 };
+
+static unsigned u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static int is_vendor_interface(int fd)
+{
+    struct hidraw_devinfo info;
+    struct hidraw_report_descriptor desc;
+    int size;
+
+    if (ioctl(fd, HIDIOCGRAWINFO, &info) < 0) return 0;
+    if ((uint16_t)info.vendor != VENDOR_ID || (uint16_t)info.product != PRODUCT_ID) return 0;
+    if (ioctl(fd, HIDIOCGRDESCSIZE, &size) < 0 || size < (int)sizeof(vendor_report)) return 0;
+    desc.size = size;
+    if (ioctl(fd, HIDIOCGRDESC, &desc) < 0) return 0;
+    return memcmp(desc.value, vendor_report, sizeof(vendor_report)) == 0;
+}
+
+static int find_device(void)
+{
+    char path[32];
+    int n;
+    int fd;
+
+    for (n = 0; n < 64; n++)
+    {
+        snprintf(path, sizeof(path), "/dev/hidraw%d", n);
+        fd = open(path, O_RDWR);
+        if (fd < 0) continue;
+        if (is_vendor_interface(fd))
+        {
+            fprintf(stderr, "Using %s\n", path);
+            return fd;
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+/* The node given on the command line, or the first vendor interface found */
+static int open_device(int argc, char **argv)
+{
+    int fd = (argc > 1) ? open(argv[1], O_RDWR) : find_device();
+
+    if (fd < 0) fprintf(stderr, "No NES Keyboard vendor interface found\n");
+    return fd;
+}
+
+#endif /* NES_HIDRAW_H */
@@ -0,0 +1,180 @@
+/*
+ * Replay a tools/record.c capture on the NES Keyboard (see
+ * Source/playback.h, firmware built with PlaybackEnabled): the device
+ * sends the recorded pad states as keyboard reports, frame for frame.
+ *
+ *   cc -O2 -o playback tools/playback.c
+ *   ./playback [-o] trace.bin [/dev/hidrawN]
+ *
+ * -o lets the real pad take over while any of its buttons is pressed.
+ * Gaps in the capture are played as if the last state was held.
+ */
+
+#include <stdlib.h>
+#include "nes_hidraw.h"
+
+#define REPORT_ID           0x05
+#define REPORT_SIZE         64
+#define STATUS_SIZE         9
+#define ENTRIES_PER_REPORT  ((REPORT_SIZE - 2) / 2)
+#define PLAYING             0x01
+#define OVERRIDE            0x02
+
+static uint8_t *entries;    /* Buttons, frames pairs */
+static size_t count;
+
+static void add(unsigned buttons, unsigned long frames)
+{
+    static size_t size;
+
+    /* Runs longer than 255 frames take several entries */
+    do
+    {
+        unsigned n = frames > 255 ? 255 : (unsigned)frames;
+
+        if (count == size)
+        {
+            size = size ? size * 2 : 1024;
+            entries = realloc(entries, size * 2);
+            if (entries == NULL)
+            {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        entries[count * 2] = (uint8_t)buttons;
+        entries[count * 2 + 1] = (uint8_t)n;
+        count++;
+        frames -= n;
+    } while (frames);
+}
+
+/* record.c entries -> (buttons, frames) runs, ending with the end marker */
+static int load(const char *path)
+{
+    uint8_t header[8];
+    uint8_t e[8];
+    unsigned long frame = 0;
+    unsigned buttons = 0;
+    int first = 1;
+    FILE *in = fopen(path, "rb");
+
+    if (in == NULL || fread(header, sizeof(header), 1, in) != 1 || memcmp(header, "NESREC\1", 7) != 0)
+    {
+        fprintf(stderr, "%s: not a record.c capture\n", path);
+        return -1;
+    }
+
+    while (fread(e, sizeof(e), 1, in) == 1)
+    {
+        unsigned long at = e[0] | (e[1] << 8) | ((unsigned long)e[2] << 16) | ((unsigned long)e[3] << 24);
+
+        if (e[5] != 0) continue;    /* Only changes start a new run */
+        if (!first && at > frame) add(buttons, at - frame);
+        first = 0;
+        frame = at;
+        buttons = e[4];
+    }
+    fclose(in);
+
+    if (!first) add(buttons, 1);
+    add(0, 0);
+    return 0;
+}
+
+static int status(int fd, uint8_t *report)
+{
+    memset(report, 0, STATUS_SIZE);
+    report[0] = REPORT_ID;
+    if (ioctl(fd, HIDIOCGFEATURE(STATUS_SIZE), report) < STATUS_SIZE)
+    {
+        perror("HIDIOCGFEATURE (firmware built without PlaybackEnabled?)");
+        return -1;
+    }
+    return 0;
+}
+
+static int command(int fd, unsigned value)
+{
+    uint8_t report[STATUS_SIZE] = { REPORT_ID, (uint8_t)value };
+
+    if (ioctl(fd, HIDIOCSFEATURE(sizeof(report)), report) < 0)
+    {
+        perror("HIDIOCSFEATURE");
+        return -1;
+    }
+    return 0;
+}
+
+/* Send the next report's worth of entries if the device has room for it */
+static int feed(int fd, size_t *sent, unsigned free)
+{
+    uint8_t report[REPORT_SIZE];
+    size_t n = count - *sent;
+
+    if (n > ENTRIES_PER_REPORT) n = ENTRIES_PER_REPORT;
+    if (n == 0 || n > free) return 0;
+
+    memset(report, 0, sizeof(report));
+    report[0] = REPORT_ID;
+    report[1] = (uint8_t)n;
+    memcpy(report + 2, entries + *sent * 2, n * 2);
+    if (write(fd, report, sizeof(report)) != (int)sizeof(report))
+    {
+        perror("write");
+        return -1;
+    }
+    *sent += n;
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t report[STATUS_SIZE];
+    unsigned mode = PLAYING;
+    size_t sent = 0;
+    int fd;
+    int result;
+
+    if (argc > 1 && strcmp(argv[1], "-o") == 0)
+    {
+        mode |= OVERRIDE;
+        argc--;
+        argv++;
+    }
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s [-o] trace.bin [/dev/hidrawN]\n", argv[0]);
+        return 1;
+    }
+    if (load(argv[1]) < 0) return 1;
+
+    fd = open_device(argc - 1, argv + 1);
+    if (fd < 0) return 1;
+
+    /* Empty the ring, preload it, then start playing */
+    if (command(fd, 0) < 0) return 1;
+    usleep(5000);
+    do
+    {
+        if (status(fd, report) < 0) return 1;
+        result = feed(fd, &sent, report[2]);
+        if (result < 0) return 1;
+        usleep(2000);
+    } while (result > 0);
+    if (command(fd, mode) < 0) return 1;
+    fprintf(stderr, "Playing %zu entries\n", count);
+
+    /* Keep the ring topped up until the end marker has played */
+    for (;;)
+    {
+        usleep(5000);
+        if (status(fd, report) < 0) return 1;
+        if (!(report[1] & PLAYING)) break;
+        if (feed(fd, &sent, report[2]) < 0) return 1;
+    }
+
+    printf("%u frames played, %u underruns, %u live overrides\n", u16(report + 7), u16(report + 3), u16(report + 5));
+    close(fd);
+    return u16(report + 3) ? 2 : 0;
+}
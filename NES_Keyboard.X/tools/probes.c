@@ -0,0 +1,62 @@
+/*
+ * Dump the NES Keyboard cycle probes (see Source/probe.h, firmware built
+ * with ProbesEnabled).
+ *
+ *   cc -O2 -o probes tools/probes.c
+ *   ./probes [/dev/hidrawN]
+ */
+
+#include "nes_hidraw.h"
+
+#define REPORT_ID           0x03
+#define PROBE_SIZE          10
+#define PROBE_COUNT         7
+#define REPORT_SIZE         (1 + PROBE_COUNT * PROBE_SIZE)
+#define CYCLES_PER_US       12.0
+
+static const char *names[PROBE_COUNT] =
+{
+    "read_buttons", "PrepareTxBuffer", "HIDSend", "USB bus reset", "USB SOF", "USB idle/stall/error",
+    "USB transaction"
+};
+
+static unsigned long u32(const uint8_t *p)
+{
+    return u16(p) | ((unsigned long)u16(p + 2) << 16);
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t report[REPORT_SIZE];
+    int fd;
+    int n;
+
+    fd = open_device(argc, argv);
+    if (fd < 0) return 1;
+
+    memset(report, 0, sizeof(report));
+    report[0] = REPORT_ID;
+    if (ioctl(fd, HIDIOCGFEATURE(sizeof(report)), report) < (int)sizeof(report))
+    {
+        perror("HIDIOCGFEATURE (firmware built without ProbesEnabled?)");
+        return 1;
+    }
+
+    printf("%-22s %8s %10s %10s %10s   (cycles at 12/us)\n", "Probe", "Count", "Min", "Mean", "Max");
+    for (n = 0; n < PROBE_COUNT; n++)
+    {
+        const uint8_t *p = report + 1 + n * PROBE_SIZE;
+        unsigned count = u16(p + 8);
+
+        if (count == 0)
+        {
+            printf("%-22s %8u\n", names[n], 0);
+            continue;
+        }
+        printf("%-22s %8u %10u %10.1f %10u   (%.1f us max)\n", names[n], count, u16(p),
+               (double)u32(p + 4) / count, u16(p + 2), u16(p + 2) / CYCLES_PER_US);
+    }
+
+    close(fd);
+    return 0;
+}
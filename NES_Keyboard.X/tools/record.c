@@ -0,0 +1,170 @@
+/*
+ * Capture the NES Keyboard pad recording stream (see Source/record.h,
+ * firmware built with RecordEnabled) to a binary trace file.
+ *
+ *   cc -O2 -o record tools/record.c
+ *   ./record trace.bin [/dev/hidrawN]
+ *
+ * Runs until interrupted, then stops the stream and prints a summary.
+ * The file is an 8 byte header, "NESREC", version 1, 0, then 8 byte
+ * little endian entries:
+ *
+ *   uint32 frame    USB frame (ms) since the first entry
+ *   uint8  buttons  raw pad byte (bit set = pressed)
+ *   uint8  kind     0 pad changed, 1 unchanged (heartbeat), 2 gap
+ *   uint16 lost     gap only: records lost around here, 0xFFFF if whole
+ *                   reports went missing on the host and nobody knows
+ *
+ * A gap entry repeats the frame and buttons of the entry before it.
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include "nes_hidraw.h"
+
+#define STREAM_ID           0x01
+#define CONTROL_ID          0x04
+#define REPORT_SIZE         64
+#define RECORD_SIZE         3
+#define HEADER_SIZE         5
+
+#define KIND_CHANGE         0
+#define KIND_REPEAT         1
+#define KIND_GAP            2
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static int control(int fd, int on)
+{
+    uint8_t report[2] = { CONTROL_ID, (uint8_t)on };
+
+    if (ioctl(fd, HIDIOCSFEATURE(sizeof(report)), report) < 0)
+    {
+        perror("HIDIOCSFEATURE (firmware built without RecordEnabled?)");
+        return -1;
+    }
+    return 0;
+}
+
+static void put_entry(FILE *out, unsigned long frame, unsigned buttons, unsigned kind, unsigned lost)
+{
+    uint8_t e[8];
+
+    e[0] = frame & 0xFF;
+    e[1] = (frame >> 8) & 0xFF;
+    e[2] = (frame >> 16) & 0xFF;
+    e[3] = (frame >> 24) & 0xFF;
+    e[4] = (uint8_t)buttons;
+    e[5] = (uint8_t)kind;
+    e[6] = lost & 0xFF;
+    e[7] = (lost >> 8) & 0xFF;
+    fwrite(e, sizeof(e), 1, out);
+}
+
+int main(int argc, char **argv)
+{
+    static const uint8_t header[8] = { 'N', 'E', 'S', 'R', 'E', 'C', 1, 0 };
+    uint8_t report[REPORT_SIZE];
+    struct pollfd pfd;
+    FILE *out;
+    unsigned long frame = 0;
+    unsigned long records = 0;
+    unsigned long changes = 0;
+    unsigned long lost_reports = 0;
+    unsigned dropped = 0;
+    unsigned last_raw = 0;
+    unsigned last_buttons = 0;
+    int expected = 0;
+    int started = 0;
+    int fd;
+    int length;
+    int n;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s trace.bin [/dev/hidrawN]\n", argv[0]);
+        return 1;
+    }
+    out = fopen(argv[1], "wb");
+    if (out == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    fwrite(header, sizeof(header), 1, out);
+
+    fd = open_device(argc - 1, argv + 1);
+    if (fd < 0) return 1;
+
+    /* Throw away whatever a previous stream left queued */
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, 0) > 0 && read(fd, report, sizeof(report)) > 0) ;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    if (control(fd, 1) < 0) return 1;
+    fprintf(stderr, "Recording to %s, ^C to stop\n", argv[1]);
+
+    while (!stop)
+    {
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        length = read(fd, report, sizeof(report));
+        if (length < 0)
+        {
+            perror("read");
+            break;
+        }
+        if (length < HEADER_SIZE || report[0] != STREAM_ID) continue;
+
+        /* A restarted stream begins at sequence 0 */
+        if (!started)
+        {
+            if (report[1] != 0) continue;
+            started = 1;
+        }
+        else if (report[1] != expected)
+        {
+            lost_reports += (report[1] - expected) & 0xFF;
+            put_entry(out, frame, last_buttons, KIND_GAP, 0xFFFF);
+        }
+        expected = (report[1] + 1) & 0xFF;
+
+        for (n = 0; n < report[2] && HEADER_SIZE + (n + 1) * RECORD_SIZE <= length; n++)
+        {
+            const uint8_t *r = report + HEADER_SIZE + n * RECORD_SIZE;
+            unsigned raw = u16(r + 1);
+            unsigned kind = KIND_CHANGE;
+
+            /* Frames are 16 bits, the device sends at least one record per 16384 */
+            if (records) frame += (raw - last_raw) & 0xFFFF;
+            if (records && r[0] == last_buttons) kind = KIND_REPEAT;
+            else changes++;
+            last_raw = raw;
+            last_buttons = r[0];
+            records++;
+            put_entry(out, frame, r[0], kind, 0);
+        }
+
+        if (u16(report + 3) != dropped)
+        {
+            put_entry(out, frame, last_buttons, KIND_GAP, (u16(report + 3) - dropped) & 0xFFFF);
+            fprintf(stderr, "%u records dropped by the device (ring full)\n", (u16(report + 3) - dropped) & 0xFFFF);
+            dropped = u16(report + 3);
+        }
+    }
+
+    control(fd, 0);
+    fclose(out);
+    close(fd);
+
+    printf("%lu records (%lu changes) over %lu ms, %u dropped by the device, %lu reports lost on the host\n",
+           records, changes, frame, dropped, lost_reports);
+    return (dropped || lost_reports) ? 2 : 0;
+}
@@ -0,0 +1,631 @@
+/*
+ * USB fault injection and recovery benchmark: the firmware built for the
+ * host as in sim.c, against a host that misbehaves on purpose.
+ *
+ *   make faults FAULT_ARGS="--repeat 50 --cycles 1000"
+ *   build/sim/nes_faults [--option value ...]
+ *
+ * Every scenario starts from a configured device with the pad released,
+ * injects its fault and then presses a button. Recovery is the number of
+ * frames (SOFs) from the end of the fault until a keyboard report shows
+ * the press, with whatever the host has to redo first (enumeration after
+ * a reset) included. After the release the device has to be where the
+ * first enumeration left it: Check() for the registers and BDs a working
+ * configured device needs, Snapshot() for everything else that has to
+ * match that first enumeration.
+ *
+ * The soak then runs --cycles rounds of random requests that change
+ * device state, a bus reset at a random point (idle, mid transfer, after
+ * SET_ADDRESS, after a detach) and enumeration, comparing the state after
+ * each with the first, so anything a bus reset leaves behind shows up as
+ * a leak.
+ *
+ * Exit status 1 when a scenario failed or state leaked, 2 when the
+ * simulation itself failed.
+ *
+ * The host side of the bus is host.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <htc.h>
+#include "Usb.h"
+#include "nes_keyboard.h"
+#include "host.h"
+
+#undef main     /* The firmware's is firmware_main() */
+
+#define MAX_FAILURES        10      /* Printed, the rest are only counted */
+#define ADDRESS_RECOVERY    SIM_MS(2)
+#define STORM_SPACING       SIM_US(10)
+
+/* Buffer descriptor bits, as in Usb.c */
+#define BD_UOWN             0x80
+#define BD_DTSEN            0x08
+#define BD_BSTALL           0x04
+#define BD_COUNT            (2 * (InterfaceCount + 1))
+
+#define CONFIGURED          0x05
+
+/* Firmware state the checks look at (Usb.c) */
+typedef struct
+{
+    uint8_t Stat;
+    uint8_t Cnt;
+    uint16_t ADDR;
+} Bd;
+
+extern volatile Bd Interfaces[];
+extern uint8_t RemoteWakeup;
+extern uint8_t SelfPowered;
+extern uint8_t CtrlTransferStage;
+extern uint8_t CurrentConfiguration;
+extern uint8_t HidIdleRate;
+extern uint8_t HidProtocol;
+extern uint8_t HidRxLen;
+
+/* Command line, all integers */
+typedef struct
+{
+    const char *Name;
+    long Value;
+    const char *Help;
+} Option;
+
+static Option options[] =
+{
+    { "seed",        1,      "random seed" },
+    { "repeat",      20,     "runs of each scenario" },
+    { "cycles",      100000, "soak attach/reset cycles (0 = no soak)" },
+    { "storm",       20,     "frames of NAK storm or bus errors" },
+    { "timeout",     500,    "frames a recovery may take before it fails" },
+    { "loop-cycles", 10,     "cycles charged per Timer1 read" },
+    { "isr-cycles",  60,     "cycles charged per interrupt" },
+};
+#define OptionCount (sizeof(options) / sizeof(options[0]))
+#define OPT(i)      (options[i].Value)
+enum { O_SEED, O_REPEAT, O_CYCLES, O_STORM, O_TIMEOUT, O_LOOP, O_ISR };
+
+static unsigned long storm_tokens;
+static unsigned long storm_naks;
+static unsigned long errors_injected;
+
+/* Results */
+typedef struct
+{
+    const char *Name;
+    int (*Inject)(void);
+} Scenario;
+
+typedef struct
+{
+    unsigned Runs;
+    unsigned Failed;
+    unsigned Min;
+    unsigned Max;
+    unsigned long Sum;
+} Recovery;
+
+typedef struct
+{
+    uint8_t DeviceState;
+    uint8_t Uaddr;
+    uint8_t Configuration;
+    uint8_t RemoteWakeup;
+    uint8_t SelfPowered;
+    uint8_t IdleRate;
+    uint8_t Protocol;
+    uint8_t RxLen;
+    uint8_t Stage;
+    uint8_t Uie;
+    uint8_t Ueie;
+    uint8_t Uep[8];
+    uint8_t Stat[BD_COUNT];         /* DTSEN and BSTALL of armed BDs */
+    uint8_t OutCnt[BD_COUNT / 2];
+    uint16_t Addr[BD_COUNT];
+} State;
+
+static State baseline;
+static unsigned failures;
+static unsigned long soak_done;
+static unsigned long soak_failed;
+static unsigned long soak_leaks;
+static unsigned long soak_frames;
+
+/* Device state */
+
+/* What a configured device needs to work at all */
+static int Check(void)
+{
+    unsigned i;
+    uint8_t expected;
+
+    if (DeviceState != CONFIGURED) return Host_Problem("device state %u, not configured", DeviceState);
+    if (UADDR != host_address) return Host_Problem("UADDR %u, the host uses %u", UADDR, host_address);
+    if (CurrentConfiguration != 1) return Host_Problem("configuration %u", CurrentConfiguration);
+    if (UCONbits.SUSPND) return Host_Problem("still suspended");
+    if (UCONbits.PKTDIS) return Host_Problem("packet processing still disabled");
+    if (UEIR) return Host_Problem("UEIR 0x%02X left set", UEIR);
+    if (UEP0 != 0x16) return Host_Problem("UEP0 0x%02X, not a control pipe", UEP0);
+    for (i = 0; i < 7; i++)
+    {
+        expected = i >= InterfaceCount ? 0x00 : RxBufferSize(i) ? 0x1E : 0x1A;
+        if (UEP[i + 1] != expected) return Host_Problem("UEP%u 0x%02X, expected 0x%02X", i + 1, UEP[i + 1], expected);
+    }
+    if (CtrlTransferStage != 0 || !(Interfaces[0].Stat & BD_UOWN))
+        return Host_Problem("endpoint 0 not waiting for a SETUP");
+    for (i = 0; i < BD_COUNT; i++)
+    {
+        if ((Interfaces[i].Stat & (BD_UOWN | BD_BSTALL)) == (BD_UOWN | BD_BSTALL)) return Host_Problem("EP%u %s left stalled", i / 2, i & 1 ? "IN" : "OUT");
+    }
+    return 0;
+}
+
+static void Snapshot(State *state)
+{
+    unsigned i;
+
+    memset(state, 0, sizeof(*state));
+    state->DeviceState = DeviceState;
+    state->Uaddr = UADDR;
+    state->Configuration = CurrentConfiguration;
+    state->RemoteWakeup = RemoteWakeup;
+    state->SelfPowered = SelfPowered;
+    state->IdleRate = HidIdleRate;
+    state->Protocol = HidProtocol;
+    state->RxLen = HidRxLen;
+    state->Stage = CtrlTransferStage;
+    state->Uie = UIE;
+    state->Ueie = UEIE;
+    memcpy(state->Uep, (const void *)UEP, sizeof(state->Uep));
+    for (i = 0; i < BD_COUNT; i++)
+    {
+        /* Once the SIE hands a BD back those bits are the PID. Whether an
+           IN BD is armed depends on the traffic, only its stall counts. */
+        if (Interfaces[i].Stat & BD_UOWN)
+            state->Stat[i] = Interfaces[i].Stat & ((i & 1) ? BD_BSTALL : (BD_DTSEN | BD_BSTALL));
+        if (!(i & 1)) state->OutCnt[i / 2] = Interfaces[i].Cnt;
+        /* EP0 IN points wherever the last data stage came from */
+        if (i != 1) state->Addr[i] = Interfaces[i].ADDR;
+    }
+}
+
+/* Anything that differs from the first enumeration */
+static int Leaked(void)
+{
+    State now;
+
+    Snapshot(&now);
+#define SAME(field, name) \
+    if (memcmp(&now.field, &baseline.field, sizeof(now.field))) return Host_Problem("leaked %s", name)
+    SAME(DeviceState, "device state");
+    SAME(Uaddr, "UADDR");
+    SAME(Configuration, "configuration");
+    SAME(RemoteWakeup, "remote wakeup");
+    SAME(SelfPowered, "self powered");
+    SAME(IdleRate, "idle rate");
+    SAME(Protocol, "HID protocol");
+    SAME(RxLen, "HID OUT length");
+    SAME(Stage, "control stage");
+    SAME(Uie, "UIE");
+    SAME(Ueie, "UEIE");
+    SAME(Uep, "endpoint control (UEPn)");
+    SAME(Stat, "BD status bits");
+    SAME(OutCnt, "OUT BD byte counts");
+    SAME(Addr, "BD addresses");
+#undef SAME
+    return 0;
+}
+
+/* Press a button on a released pad and count the frames until the host
+   sees it, from `start`, then release it again */
+static int Recover(uint64_t start, unsigned *recovered)
+{
+    uint64_t timeout = (uint64_t)OPT(O_TIMEOUT);
+
+    if (!host_configured && Host_Enumerate(1) < 0) return -1;
+
+    sim_pad = (uint8_t)(1 << (Host_Random() % BUTTON_COUNT));
+    while (host_buttons != sim_pad)
+    {
+        if (host_frames - start > timeout) return Host_Problem("press not seen after %u frames", (unsigned)timeout);
+        Host_Wait(sim_now + SIM_MS(1));
+    }
+    *recovered = (unsigned)(host_frames - start);
+
+    start = host_frames;
+    sim_pad = 0;
+    while (host_buttons != 0)
+    {
+        if (host_frames - start > timeout) return Host_Problem("release not seen after %u frames", (unsigned)timeout);
+        Host_Wait(sim_now + SIM_MS(1));
+    }
+    return 0;
+}
+
+/* Scenarios, each injects its fault into a configured device */
+
+/* IN tokens on every endpoint every 10us, with now and then a stray
+   zero length OUT on EP0 (a status stage nobody asked for) */
+static int NakStorm(void)
+{
+    uint64_t end = sim_now + SIM_MS(OPT(O_STORM));
+    uint8_t data[64];
+    uint8_t toggle;
+    uint8_t count;
+    unsigned i;
+    int handshake;
+
+    while (sim_now < end)
+    {
+        handshake = Sie_In(host_address, 0, &toggle, data, &count);
+        storm_tokens++;
+        if (handshake == SIE_NAK) storm_naks++;
+        else return Host_Expect(handshake, SIE_NAK, "IN on an idle endpoint 0");
+
+        for (i = 0; i < host_poll_count; i++)
+        {
+            storm_tokens++;
+            if (Host_Poll(&host_polls[i]) == SIE_NAK) storm_naks++;
+        }
+        /* NAKed while the last one is still being handled */
+        if (Host_Random() % 8 == 0)
+        {
+            handshake = Sie_Out(host_address, 0, 0, NULL, 0);
+            if (handshake != SIE_NAK && Host_Expect(handshake, SIE_ACK, "stray OUT on endpoint 0") < 0) return -1;
+        }
+        Host_Wait(sim_now + STORM_SPACING);
+    }
+    return 0;
+}
+
+/* Requests the device doesn't know get a STALL and EP0 takes the next
+   SETUP; a halted interrupt endpoint STALLs until CLEAR_FEATURE, and so do
+   requests for an endpoint the device doesn't have */
+static int Stalls(void)
+{
+    unsigned long stalls;
+    uint8_t endpoint = (uint8_t)(0x80 | host_keyboard->Endpoint);
+    uint8_t missing = (uint8_t)((Host_Random() & 0x80) | Host_Between(InterfaceCount + 1, 15));
+
+    if (Host_Expect(Host_Control(0xC0, 0x7F, 0, 0, 8, 0), SIE_STALL, "unknown vendor request") < 0) return -1;
+    if (Host_Expect(Host_Control(0x80, 0x06, 0x0700, 0, 9, 0), SIE_STALL, "GET_DESCRIPTOR other speed") < 0) return -1;
+    if (Host_Expect(Host_Control(0x80, 0x00, 0, 0, 2, 0), SIE_ACK, "GET_STATUS after a STALL") < 0) return -1;
+
+    if (Host_Expect(Host_Control(0x02, 0x03, 0, endpoint, 0, 0), SIE_ACK, "SET_FEATURE ENDPOINT_HALT") < 0) return -1;
+    if (Host_Expect(Host_Control(0x82, 0x00, 0, endpoint, 2, 0), SIE_ACK, "GET_STATUS endpoint") < 0) return -1;
+    if (host_data[0] != 1) return Host_Problem("halted endpoint reports status %u", host_data[0]);
+
+    stalls = host_keyboard->Stalls;
+    Host_Wait(sim_now + SIM_MS(Host_Between(2, 10)));
+    if (host_keyboard->Stalls == stalls) return Host_Problem("halted endpoint didn't STALL");
+
+    /* Like a real host, no polls until the halt is cleared, then DATA0 */
+    host_polling = 0;
+    if (Host_Expect(Host_Control(0x02, 0x01, 0, endpoint, 0, 0), SIE_ACK, "CLEAR_FEATURE ENDPOINT_HALT") < 0) return -1;
+    host_keyboard->Toggle = 0;
+    host_polling = 1;
+    if (Host_Expect(Host_Control(0x82, 0x00, 0, endpoint, 2, 0), SIE_ACK, "GET_STATUS endpoint") < 0) return -1;
+    if (host_data[0] != 0) return Host_Problem("cleared endpoint reports status %u", host_data[0]);
+
+    if (Host_Expect(Host_Control(0x02, 0x03, 0, missing, 0, 0), SIE_STALL, "SET_FEATURE on a missing endpoint") < 0) return -1;
+    if (Host_Expect(Host_Control(0x02, 0x01, 0, missing, 0, 0), SIE_STALL, "CLEAR_FEATURE on a missing endpoint") < 0) return -1;
+    if (Host_Expect(Host_Control(0x82, 0x00, 0, missing, 2, 0), SIE_STALL, "GET_STATUS on a missing endpoint") < 0) return -1;
+    return Host_Expect(Host_Control(0x80, 0x00, 0, 0, 2, 0), SIE_ACK, "GET_STATUS after a STALL");
+}
+
+/* Transfers with nothing between them, each SETUP right behind the status
+   stage of the last one, before the firmware has handled it, or in place
+   of the status stage of a read. EP0 has to take every SETUP whatever
+   stage it is in. */
+static int BackToBack(void)
+{
+    unsigned rounds = (unsigned)Host_Between(1, 8);
+
+    while (rounds--)
+    {
+        if (Host_Expect(Host_Control(0x21, 0x0A, 0, HidInterfaceNumber, 0, 0), SIE_ACK, "SET_IDLE") < 0) return -1;
+        host_data[0] = 0;
+        if (Host_Expect(Host_Control(0x21, 0x09, 0x0200, HidInterfaceNumber, 1, 0), SIE_ACK, "SET_REPORT") < 0) return -1;
+        if (Host_Expect(Host_Control(0x80, 0x00, 0, 0, 2, 0), SIE_ACK, "GET_STATUS") < 0) return -1;
+        /* Leaves out the status stage, the next SETUP ends it */
+        Host_Control(0x80, 0x06, 0x0200, 0, sizeof(host_data), 2);
+        if (Host_Expect(Host_Control(0x80, 0x06, 0x0100, 0, 18, 0), SIE_ACK, "GET_DESCRIPTOR device") < 0) return -1;
+        if (host_length != 18) return Host_Problem("device descriptor read %u bytes", host_length);
+    }
+    return 0;
+}
+
+/* Bus reset after the SETUP or the first data packet of a long IN */
+static int ResetMidIn(void)
+{
+    Host_Control(0x80, 0x06, 0x0200, 0, sizeof(host_data), (unsigned)Host_Between(1, 2));
+    return Host_Reset();
+}
+
+/* Bus reset between the SETUP and the data of a SET_REPORT */
+static int ResetMidOut(void)
+{
+    host_data[0] = (uint8_t)Host_Random();
+    Host_Control(0x21, 0x09, 0x0200, HidInterfaceNumber, 1, 1);
+    return Host_Reset();
+}
+
+/* Bus reset with a SETUP the firmware hasn't taken yet: the reset throws
+   it away, and endpoint 0 has to wait for the next one all the same */
+static int SetupPendingReset(void)
+{
+    static const uint8_t get_status[8] = { 0x80, 0x00, 0, 0, 0, 0, 2, 0 };
+
+    if (Host_Expect(Sie_Setup(host_address, get_status), SIE_ACK, "SETUP") < 0) return -1;
+    return Host_Reset();
+}
+
+/* SET_ADDRESS, with or without its status stage, then a bus reset: the
+   device has to be back at host_address 0 */
+static int AddressReset(void)
+{
+    unsigned full = Host_Random() & 1;
+
+    if (Host_Reset() < 0) return -1;
+    if (full)
+    {
+        if (Host_Expect(Host_Control(0x00, 0x05, HOST_ADDRESS + 1, 0, 0, 0), SIE_ACK, "SET_ADDRESS") < 0) return -1;
+        host_address = HOST_ADDRESS + 1;
+        Host_Wait(sim_now + ADDRESS_RECOVERY);
+        if (Host_Expect(Host_Control(0x80, 0x00, 0, 0, 2, 0), SIE_ACK, "GET_STATUS at the new address") < 0) return -1;
+    }
+    else
+    {
+        Host_Control(0x00, 0x05, HOST_ADDRESS + 1, 0, 0, 1);
+    }
+    Host_Wait(sim_now + SIM_US(Host_Between(0, 3000)));
+    return Host_Reset();
+}
+
+/* Bus reset in the middle of enumeration */
+static int ResetMidEnumeration(void)
+{
+    if (Host_Reset() < 0) return -1;
+    host_abort_after = (unsigned)Host_Between(1, 6);
+    Host_Enumerate(1);
+    host_abort_after = 0;
+    host_configured = 0;
+    return Host_Reset();
+}
+
+/* The host stops the SOFs (the device suspends after 3ms) and starts them
+   again, a few times in a row; the configuration has to survive */
+static int SuspendResume(void)
+{
+    unsigned bursts = (unsigned)Host_Between(1, 5);
+    uint64_t idle;
+
+    while (bursts--)
+    {
+        host_polling = 0;
+        Host_Bus(0);
+        idle = Host_Between(1000, 10000);
+        Host_Wait(sim_now + SIM_US(idle));
+        if (idle > 3500 && !UCONbits.SUSPND) return Host_Problem("not suspended after %u us idle", (unsigned)idle);
+        Host_Bus(1);
+        host_polling = 1;
+        Host_Wait(sim_now + SIM_US(Host_Between(1000, 5000)));
+    }
+    if (DeviceState != CONFIGURED) return Host_Problem("configuration lost in suspend");
+    return 0;
+}
+
+/* A damaged packet every frame (PID, CRC, bit stuffing, bus turnaround) */
+static int BusErrors(void)
+{
+    static const uint8_t flags[] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x80 };
+    uint64_t end = sim_now + SIM_MS(OPT(O_STORM));
+
+    while (sim_now < end)
+    {
+        Host_Wait(sim_now + SIM_US(Host_Between(1, 999)));
+        Sie_Error(flags[Host_Random() % sizeof(flags)]);
+        errors_injected++;
+    }
+    Host_Wait(sim_now + SIM_MS(1));
+    return 0;
+}
+
+static const Scenario scenarios[] =
+{
+    { "nak-storm",             NakStorm },
+    { "stall",                 Stalls },
+    { "back-to-back",          BackToBack },
+    { "reset-mid-in",          ResetMidIn },
+    { "reset-mid-out",         ResetMidOut },
+    { "setup-pending-reset",   SetupPendingReset },
+    { "set-address-reset",     AddressReset },
+    { "reset-mid-enumeration", ResetMidEnumeration },
+    { "suspend-resume",        SuspendResume },
+    { "bus-errors",            BusErrors },
+};
+#define ScenarioCount (sizeof(scenarios) / sizeof(scenarios[0]))
+static Recovery recoveries[ScenarioCount];
+
+static void Failure(const char *name, unsigned long run)
+{
+    if (failures++ < MAX_FAILURES)
+        printf("FAIL %s #%lu at %.3f ms: %s\n", name, run, sim_now / (double)SIM_MS(1), host_problem);
+}
+
+/* Back to a configured device with the pad released after a failure */
+static void Restart(void)
+{
+    sim_pad = 0;
+    Host_Reset();
+    if (Host_Enumerate(1) < 0)
+    {
+        printf("device didn't come back: %s\n", host_problem);
+        Host_Fail("can't continue");
+    }
+    Host_Wait(sim_now + SIM_MS(20));
+}
+
+static int RunScenario(const Scenario *scenario, Recovery *recovery)
+{
+    uint64_t start;
+    unsigned recovered = 0;
+
+    if (scenario->Inject() < 0) return -1;
+    start = host_frames;
+    if (Recover(start, &recovered) < 0 || Check() < 0 || Leaked() < 0) return -1;
+
+    if (recovery->Runs == 0 || recovered < recovery->Min) recovery->Min = recovered;
+    if (recovered > recovery->Max) recovery->Max = recovered;
+    recovery->Sum += recovered;
+    recovery->Runs++;
+    return 0;
+}
+
+/* Random requests that change device state, a reset at a random point,
+   then enumeration like the first one */
+static int SoakCycle(void)
+{
+    uint8_t endpoint = (uint8_t)(0x80 | host_keyboard->Endpoint);
+    unsigned changes = (unsigned)Host_Between(0, 4);
+    uint64_t start;
+
+    while (changes--)
+    {
+        switch (Host_Random() % 6)
+        {
+        case 0: Host_Control(0x21, 0x0A, (uint16_t)(Host_Between(1, 255) << 8), HidInterfaceNumber, 0, 0); break;
+        case 1: Host_Control(0x21, 0x0B, 0, HidInterfaceNumber, 0, 0); break;       /* SET_PROTOCOL boot */
+        case 2: Host_Control(0x00, 0x03, 1, 0, 0, 0); break;                         /* Remote wakeup */
+        case 3: Host_Control(0x02, 0x03, 0, endpoint, 0, 0); break;                  /* Halt */
+        case 4:
+            host_data[0] = (uint8_t)Host_Random();
+            Host_Control(0x21, 0x09, 0x0200, HidInterfaceNumber, 1, 0);             /* SET_REPORT LEDs */
+            break;
+        default: Host_Control(0x80, 0x06, 0x0200, 0, 256, 1); break;                 /* Abandoned */
+        }
+    }
+
+    switch (Host_Random() % 4)
+    {
+    case 0: break;
+    case 1: Host_Control(0x80, 0x06, 0x0200, 0, 256, (unsigned)Host_Between(1, 2)); break;
+    case 2: Host_Control(0x00, 0x05, HOST_ADDRESS + 1, 0, 0, 1); break;
+    default:
+        /* Detach and attach */
+        host_polling = 0;
+        Host_Bus(0);
+        Host_Wait(sim_now + SIM_US(Host_Between(4000, 30000)));
+        break;
+    }
+
+    start = host_frames;
+    if (Host_Reset() < 0 || Host_Enumerate(0) < 0) return -1;
+    Host_Wait(sim_now + SIM_MS(2));
+    soak_frames += host_frames - start;
+    if (Check() < 0) return -1;
+    if (Leaked() < 0)
+    {
+        soak_leaks++;
+        return -1;
+    }
+    return 0;
+}
+
+static void Faults(void)
+{
+    unsigned long run;
+    unsigned i;
+
+    if (Host_Attach() < 0)
+    {
+        printf("first enumeration: %s\n", host_problem);
+        Host_Fail("the device never got configured");
+    }
+    Host_Wait(sim_now + SIM_MS(20));
+    if (Check() < 0)
+    {
+        printf("after the first enumeration: %s\n", host_problem);
+        Host_Fail("the device isn't usable");
+    }
+    Snapshot(&baseline);
+
+    for (run = 0; run < (unsigned long)OPT(O_REPEAT); run++)
+    {
+        for (i = 0; i < ScenarioCount; i++)
+        {
+            if (RunScenario(&scenarios[i], &recoveries[i]) == 0) continue;
+            recoveries[i].Failed++;
+            Failure(scenarios[i].Name, run);
+            Restart();
+        }
+    }
+
+    for (run = 0; run < (unsigned long)OPT(O_CYCLES); run++)
+    {
+        soak_done++;
+        if (SoakCycle() == 0) continue;
+        soak_failed++;
+        Failure("soak", run);
+        Restart();
+    }
+}
+
+static int Report(void)
+{
+    unsigned i;
+    unsigned failed = 0;
+
+    printf("%-22s %6s %6s   recovery frames: %5s %7s %5s\n", "scenario", "runs", "failed", "min", "mean", "max");
+    for (i = 0; i < ScenarioCount; i++)
+    {
+        failed += recoveries[i].Failed;
+        printf("%-22s %6u %6u   %22u %7.1f %5u\n", scenarios[i].Name, recoveries[i].Runs + recoveries[i].Failed,
+               recoveries[i].Failed, recoveries[i].Min,
+               recoveries[i].Runs ? recoveries[i].Sum / (double)recoveries[i].Runs : 0.0, recoveries[i].Max);
+    }
+    printf("storm tokens %lu (%lu NAKed), bus errors injected %lu, toggle errors %lu\n",
+           storm_tokens, storm_naks, errors_injected, host_toggle_errors);
+    if (soak_done)
+    {
+        printf("soak: %lu attach/reset cycles, %lu failed, %lu leaked state, %.1f frames reset to configured\n",
+               soak_done, soak_failed, soak_leaks, soak_frames / (double)(soak_done - soak_failed + !soak_done));
+    }
+    printf("%.1f s simulated\n", sim_now / (double)SIM_MS(1000));
+    return (failed || soak_failed || host_toggle_errors) ? 1 : 0;
+}
+
+static void Usage(const char *name)
+{
+    unsigned i;
+
+    fprintf(stderr, "usage: %s [--option value ...]\n", name);
+    for (i = 0; i < OptionCount; i++)
+        fprintf(stderr, "  --%-12s %s (%ld)\n", options[i].Name, options[i].Help, options[i].Value);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int a;
+    unsigned i;
+    char *end;
+
+    for (a = 1; a < argc; a++)
+    {
+        if (strncmp(argv[a], "--", 2) != 0 || a + 1 >= argc) Usage(argv[0]);
+        for (i = 0; i < OptionCount && strcmp(argv[a] + 2, options[i].Name) != 0; i++) ;
+        if (i == OptionCount) Usage(argv[0]);
+        options[i].Value = strtol(argv[++a], &end, 0);
+        if (*end || options[i].Value < 0) Usage(argv[0]);
+    }
+
+    Host_Seed((uint64_t)OPT(O_SEED));
+    sim_loop_cycles = (unsigned)OPT(O_LOOP);
+    sim_isr_cycles = (unsigned)OPT(O_ISR);
+
+    Host_Run(Faults);
+    return Report();
+}
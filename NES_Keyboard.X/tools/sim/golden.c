@@ -0,0 +1,459 @@
+/*
+ * Trace driven golden test of the report pipeline: pad traces played
+ * through the real firmware on the host build (PadTask(), PrepareTxBuffer(),
+ * HIDSend() and the SIE model) and the keyboard reports the host gets,
+ * with the frame each one went out in, diffed against golden files.
+ *
+ *   make golden [GOLDEN_ARGS="--update 1"]
+ *   build/sim/nes_golden [--option value ...] TRACE...
+ *
+ * A trace is text, one pad change per line: the frame (ms from the start
+ * of the trace) and the raw pad byte in hex, bit set = pressed (see
+ * nes_keyboard.h), '#' starts a comment. A tools/record.c capture works
+ * too, its change entries are the same thing. The corpus is
+ * tools/sim/traces, each with its .golden next to it.
+ *
+ * The golden file has a line per keyboard report: the frame since the
+ * start of the trace and the report bytes, then "cycles N", the longest
+ * PadTask() run in the sim's cycle estimates (see sim.h). Reports have to
+ * match exactly, cycles within --tolerance percent. Throughput is printed
+ * for each trace: reports per second on the bus, and reports per second
+ * of wall clock through the whole simulated pipeline.
+ *
+ * Exit status 1 when a trace differs from its golden file, 2 when the
+ * simulation itself failed. --update 1 rewrites the golden files instead.
+ * They are for the default build, SIM_FLAGS changes the reports.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <htc.h>
+#include "Usb.h"
+#include "scheduler.h"
+#include "host.h"
+
+#undef main     /* The firmware's is firmware_main() */
+
+#define TASK_INPUT          0       /* PadTask() in Main.c's Tasks[] */
+#define MAX_DIFFS           5       /* Printed per trace */
+
+extern Task Tasks[];
+
+/* Command line, all integers */
+typedef struct
+{
+    const char *Name;
+    long Value;
+    const char *Help;
+} Option;
+
+static Option options[] =
+{
+    { "update",    0,   "1 = write the golden files instead of checking them" },
+    { "tolerance", 10,  "cycles may grow by this much, percent" },
+    { "settle",    200, "idle time between enumeration and the trace, ms" },
+    { "tail",      100, "frames played after the last change" },
+};
+#define OptionCount (sizeof(options) / sizeof(options[0]))
+#define OPT(i)      (options[i].Value)
+enum { O_UPDATE, O_TOLERANCE, O_SETTLE, O_TAIL };
+
+/* Trace: pad state changes */
+typedef struct
+{
+    unsigned long Frame;
+    uint8_t Buttons;
+} Change;
+
+static Change *changes;
+static size_t change_count;
+
+/* Run of one trace (in the child) */
+static FILE *out;
+static uint64_t first_frame;
+
+/* Result of one trace (in the parent) */
+typedef struct
+{
+    char *Text;
+    size_t Length;
+} Output;
+
+static void AddChange(unsigned long frame, unsigned buttons)
+{
+    static size_t size;
+
+    if (change_count == size)
+    {
+        size = size ? size * 2 : 256;
+        changes = realloc(changes, size * sizeof(Change));
+        if (changes == NULL)
+        {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    changes[change_count].Frame = frame;
+    changes[change_count].Buttons = (uint8_t)buttons;
+    change_count++;
+}
+
+/* Text trace or tools/record.c capture, frames in order */
+static int LoadTrace(const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    char line[256];
+    uint8_t e[8];
+    unsigned long frame;
+    unsigned buttons;
+    unsigned n = 0;
+
+    change_count = 0;
+    if (in == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    if (fread(e, sizeof(e), 1, in) == 1 && memcmp(e, "NESREC\1", 7) == 0)
+    {
+        while (fread(e, sizeof(e), 1, in) == 1)
+        {
+            if (e[5] != 0) continue;    /* Only changes */
+            AddChange(e[0] | (e[1] << 8) | ((unsigned long)e[2] << 16) | ((unsigned long)e[3] << 24), e[4]);
+        }
+    }
+    else
+    {
+        rewind(in);
+        while (fgets(line, sizeof(line), in))
+        {
+            n++;
+            if (line[strspn(line, " \t\r\n")] == '#' || line[strspn(line, " \t\r\n")] == 0) continue;
+            if (sscanf(line, "%lu %x", &frame, &buttons) != 2 || buttons > 0xFF)
+            {
+                fprintf(stderr, "%s:%u: expected \"frame buttons\"\n", path, n);
+                fclose(in);
+                return -1;
+            }
+            AddChange(frame, buttons);
+        }
+    }
+    fclose(in);
+
+    for (n = 1; n < change_count; n++)
+    {
+        if (changes[n].Frame < changes[n - 1].Frame)
+        {
+            fprintf(stderr, "%s: frames go backwards at %lu\n", path, changes[n].Frame);
+            return -1;
+        }
+    }
+    if (change_count == 0)
+    {
+        fprintf(stderr, "%s: no pad changes\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Child: the firmware and the host */
+
+static void OnReport(Poll *poll, const uint8_t *data, uint8_t count)
+{
+    uint8_t i;
+
+    if (!poll->Keyboard || first_frame == 0) return;
+    fprintf(out, "%6lu ", (unsigned long)(host_frames - first_frame));
+    for (i = 0; i < count; i++) fprintf(out, " %02x", data[i]);
+    fprintf(out, "\n");
+}
+
+static void Play(void)
+{
+    uint64_t start;
+    size_t i;
+
+    if (Host_Attach() < 0)
+    {
+        fprintf(stderr, "enumeration: %s\n", host_problem);
+        Host_Fail("the device never got configured");
+    }
+    Host_Wait(sim_now + SIM_MS(OPT(O_SETTLE)));
+
+    /* Frame 0 starts here, a change lands half way into its frame */
+    Tasks[TASK_INPUT].MaxCycles = 0;
+    first_frame = host_frames;
+    start = sim_now + SIM_US(500);
+    for (i = 0; i < change_count; i++)
+    {
+        Host_Wait(start + SIM_MS(changes[i].Frame));
+        sim_pad = changes[i].Buttons;
+    }
+    Host_Wait(sim_now + SIM_MS(OPT(O_TAIL)));
+
+    fprintf(out, "cycles %u\n", Tasks[TASK_INPUT].MaxCycles);
+}
+
+static double Seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Reports, then "cycles N", then "# frames F wall W" for the parent */
+static void Child(int fd)
+{
+    double wall = Seconds();
+
+    out = fdopen(fd, "w");
+    if (out == NULL) exit(2);
+    host_jitter = 0;
+    host_on_report = OnReport;
+    Host_Run(Play);
+    if (host_toggle_errors) Host_Fail("data toggle errors");
+    fprintf(out, "# frames %lu wall %.6f\n", (unsigned long)(host_frames - first_frame), Seconds() - wall);
+    fclose(out);
+    exit(0);
+}
+
+/* Parent */
+
+static int Run(const char *trace, Output *output)
+{
+    int fds[2];
+    int status;
+    pid_t pid;
+    size_t size = 0;
+    ssize_t n;
+
+    if (LoadTrace(trace) < 0) return -1;
+    fflush(stdout);
+    if (pipe(fds) < 0 || (pid = fork()) < 0)
+    {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Child(fds[1]);
+    }
+    close(fds[1]);
+
+    output->Length = 0;
+    output->Text = NULL;
+    do
+    {
+        if (output->Length + 4096 > size)
+        {
+            size = size ? size * 2 : 65536;
+            output->Text = realloc(output->Text, size + 1);
+            if (output->Text == NULL)
+            {
+                perror("realloc");
+                exit(2);
+            }
+        }
+        n = read(fds[0], output->Text + output->Length, size - output->Length);
+        if (n > 0) output->Length += n;
+    } while (n > 0);
+    close(fds[0]);
+    output->Text[output->Length] = 0;
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "%s: simulation failed\n", trace);
+        return -1;
+    }
+    return 0;
+}
+
+static char *GoldenPath(const char *trace)
+{
+    const char *dot = strrchr(trace, '.');
+    size_t stem = (dot && !strchr(dot, '/')) ? (size_t)(dot - trace) : strlen(trace);
+    char *path = malloc(stem + sizeof(".golden"));
+
+    if (path == NULL) exit(2);
+    memcpy(path, trace, stem);
+    strcpy(path + stem, ".golden");
+    return path;
+}
+
+/* The next line that isn't a comment, 0 at the end */
+static char *NextLine(char **at)
+{
+    char *line;
+
+    while (**at)
+    {
+        line = *at;
+        *at += strcspn(*at, "\n");
+        if (**at) *(*at)++ = 0;
+        if (line[0] != '#') return line;
+    }
+    return NULL;
+}
+
+static unsigned long Count(const Output *output, unsigned long *frames, double *wall)
+{
+    const char *stats = strstr(output->Text, "# frames ");
+    const char *p;
+    unsigned long n = 0;
+
+    *frames = 0;
+    *wall = 0;
+    if (stats) sscanf(stats, "# frames %lu wall %lf", frames, wall);
+    for (p = output->Text; p < output->Text + output->Length; p += strcspn(p, "\n") + 1)
+    {
+        if (*p != '#' && strncmp(p, "cycles", 6) != 0) n++;
+    }
+    return n;
+}
+
+/* 1 if the trace's reports or cycles moved, -1 without a golden file */
+static int Compare(const char *trace, const char *golden_path, Output *output)
+{
+    FILE *in = fopen(golden_path, "r");
+    char *golden;
+    char *g;
+    char *o;
+    char *expected;
+    char *got;
+    long size;
+    unsigned long before = 0;
+    unsigned long after = 0;
+    unsigned diffs = 0;
+    int differs = 0;
+
+    if (in == NULL) return -1;
+    fseek(in, 0, SEEK_END);
+    size = ftell(in);
+    rewind(in);
+    golden = malloc(size + 1);
+    if (golden == NULL || fread(golden, 1, size, in) != (size_t)size) exit(2);
+    golden[size] = 0;
+    fclose(in);
+
+    g = golden;
+    o = output->Text;
+    for (;;)
+    {
+        expected = NextLine(&g);
+        got = NextLine(&o);
+        if (expected && sscanf(expected, "cycles %lu", &before) == 1) expected = NextLine(&g);
+        if (got && sscanf(got, "cycles %lu", &after) == 1) got = NextLine(&o);
+        if (expected == NULL && got == NULL) break;
+        if (expected && got && strcmp(expected, got) == 0) continue;
+
+        differs = 1;
+        if (diffs++ < MAX_DIFFS)
+            printf("  %s: expected \"%s\", got \"%s\"\n", trace, expected ? expected : "nothing", got ? got : "nothing");
+    }
+    if (diffs > MAX_DIFFS) printf("  %s: %u more differences\n", trace, diffs - MAX_DIFFS);
+
+    if (after > before * (1.0 + OPT(O_TOLERANCE) / 100.0))
+    {
+        printf("  %s: PadTask() cycles %lu -> %lu (+%.1f%%)\n", trace, before, after,
+               before ? (after - before) * 100.0 / before : 100.0);
+        differs = 1;
+    }
+    free(golden);
+    return differs;
+}
+
+static int Update(const char *trace, const char *golden_path, const Output *output)
+{
+    FILE *file = fopen(golden_path, "w");
+    const char *p;
+    size_t n;
+
+    if (file == NULL)
+    {
+        perror(golden_path);
+        return -1;
+    }
+    fprintf(file, "# %s through tools/sim/golden.c, default build\n", trace);
+    fprintf(file, "# frame from the start of the trace, then the keyboard report the host got in it\n");
+    for (p = output->Text; *p; p += n + (p[n] == '\n'))
+    {
+        n = strcspn(p, "\n");
+        if (*p != '#') fprintf(file, "%.*s\n", (int)n, p);
+    }
+    fclose(file);
+    return 0;
+}
+
+static void Usage(const char *name)
+{
+    unsigned i;
+
+    fprintf(stderr, "usage: %s [--option value ...] TRACE...\n", name);
+    for (i = 0; i < OptionCount; i++)
+        fprintf(stderr, "  --%-10s %s (%ld)\n", options[i].Name, options[i].Help, options[i].Value);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    Output output;
+    unsigned long trace_reports;
+    unsigned long frames;
+    unsigned long total_reports = 0;
+    double total_wall = 0;
+    double wall;
+    char *golden_path;
+    char *end;
+    int failed = 0;
+    int result;
+    int a;
+    unsigned i;
+
+    for (a = 1; a < argc && strncmp(argv[a], "--", 2) == 0; a += 2)
+    {
+        if (a + 1 >= argc) Usage(argv[0]);
+        for (i = 0; i < OptionCount && strcmp(argv[a] + 2, options[i].Name) != 0; i++) ;
+        if (i == OptionCount) Usage(argv[0]);
+        options[i].Value = strtol(argv[a + 1], &end, 0);
+        if (*end || options[i].Value < 0) Usage(argv[0]);
+    }
+    if (a == argc) Usage(argv[0]);
+
+    printf("%-28s %8s %10s %12s %8s\n", "trace", "reports", "bus/s", "wall/s", "cycles");
+    for (; a < argc; a++)
+    {
+        if (Run(argv[a], &output) < 0) return 2;
+
+        trace_reports = Count(&output, &frames, &wall);
+        total_reports += trace_reports;
+        total_wall += wall;
+        printf("%-28s %8lu %10.1f %12.0f %8u", strrchr(argv[a], '/') ? strrchr(argv[a], '/') + 1 : argv[a],
+               trace_reports, frames ? trace_reports * 1000.0 / frames : 0.0, wall > 0 ? trace_reports / wall : 0.0,
+               (unsigned)strtoul(strstr(output.Text, "cycles ") ? strstr(output.Text, "cycles ") + 7 : "0", NULL, 10));
+
+        golden_path = GoldenPath(argv[a]);
+        if (OPT(O_UPDATE))
+        {
+            result = Update(argv[a], golden_path, &output);
+            printf("  %s\n", result < 0 ? "NOT WRITTEN" : "updated");
+        }
+        else
+        {
+            printf("\n");
+            result = Compare(argv[a], golden_path, &output);
+            if (result) printf("  %s: %s\n", argv[a], result < 0 ? "no golden file" : "DIFFERS");
+        }
+        if (result) failed = 1;
+        free(golden_path);
+        free(output.Text);
+    }
+    printf("%lu reports, %.0f reports/s wall clock\n", total_reports, total_wall > 0 ? total_reports / total_wall : 0.0);
+    return failed;
+}
@@ -0,0 +1,420 @@
+/*
+ * Scripted USB host, see host.h.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <htc.h>
+#include "Usb.h"
+#include "nes_keyboard.h"
+#include "host.h"
+
+#define KEYBOARD_SHIFT      0x20    /* Right shift modifier, SELECT */
+#define CONTROL_RETRY       SIM_US(10)
+#define CONTROL_TIMEOUT     SIM_MS(50)
+#define RESET_RECOVERY      SIM_MS(10)
+#define ADDRESS_RECOVERY    SIM_MS(2)
+#define POLL_OFFSET         SIM_US(20)
+
+Poll host_polls[HOST_MAX_POLLED];
+unsigned host_poll_count;
+Poll *host_keyboard;
+
+uint8_t host_address;
+uint8_t host_polling;
+uint8_t host_configured;
+uint64_t host_frames;
+uint8_t host_buttons;
+unsigned host_jitter = 100;
+uint8_t host_data[1024];
+uint16_t host_length;
+unsigned host_abort_after;
+unsigned long host_toggle_errors;
+char host_problem[160];
+void (*host_on_report)(Poll *poll, const uint8_t *data, uint8_t count);
+
+static ucontext_t firmware_context;
+static ucontext_t host_context;
+static char host_stack[256 * 1024];
+static void (*host_script)(void);
+
+static uint8_t sof_on;
+static uint64_t next_sof;
+static uint16_t frame;
+static uint8_t hid_interfaces[HOST_MAX_POLLED];
+static uint16_t hid_report_sizes[HOST_MAX_POLLED];
+static unsigned hid_count;
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+void Host_Seed(uint64_t seed)
+{
+    rng = 0x9E3779B97F4A7C15ULL ^ seed;
+}
+
+uint32_t Host_Random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (uint32_t)(rng >> 32);
+}
+
+uint64_t Host_Between(uint64_t low, uint64_t high)
+{
+    if (high <= low) return low;
+    return low + (((uint64_t)Host_Random() << 32) | Host_Random()) % (high - low + 1);
+}
+
+void Host_Fail(const char *what)
+{
+    fprintf(stderr, "sim: %s at %.3f ms\n", what, sim_now / (double)SIM_MS(1));
+    exit(2);
+}
+
+int Host_Problem(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(host_problem, sizeof(host_problem), format, args);
+    va_end(args);
+    return -1;
+}
+
+/* Bus */
+
+static void KeyboardReport(const uint8_t *report, uint8_t count)
+{
+    uint8_t buttons = 0;
+    uint8_t i;
+    uint8_t k;
+
+    if (count < HidReportByteCount) return;
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (button_keys[i] == KEY_RIGHTSHIFT)
+        {
+            if (report[0] & KEYBOARD_SHIFT) buttons |= (uint8_t)(1 << i);
+            continue;
+        }
+        for (k = 2; k < HidReportByteCount; k++)
+        {
+            if (report[k] == button_keys[i]) buttons |= (uint8_t)(1 << i);
+        }
+    }
+    host_buttons = buttons;
+}
+
+int Host_Poll(Poll *poll)
+{
+    uint8_t data[64];
+    uint8_t count = 0;
+    uint8_t toggle = 0;
+    int handshake = Sie_In(host_address, poll->Endpoint, &toggle, data, &count);
+
+    poll->Due = 0;
+    if (handshake == SIE_STALL) poll->Stalls++;
+    if (handshake != SIE_ACK) return handshake;
+
+    /* A repeated toggle is a retry of data already taken */
+    if (toggle != poll->Toggle)
+    {
+        host_toggle_errors++;
+        return handshake;
+    }
+    poll->Toggle ^= 1;
+    poll->Reports++;
+    if (poll->Keyboard) KeyboardReport(data, count);
+    if (host_on_report) host_on_report(poll, data, count);
+    return handshake;
+}
+
+static void HostSof(void)
+{
+    unsigned i;
+
+    frame = (frame + 1) & 0x7FF;
+    host_frames++;
+    Sie_Sof(frame);
+
+    for (i = 0; host_polling && i < host_poll_count; i++)
+    {
+        if (frame % host_polls[i].Interval) continue;
+        host_polls[i].Due = next_sof + POLL_OFFSET + SIM_US(Host_Between(0, host_jitter));
+    }
+    next_sof += SIM_MS(1);
+}
+
+void Host_Bus(uint8_t on)
+{
+    unsigned i;
+
+    if (on && !sof_on) next_sof = sim_now;
+    sof_on = on;
+    for (i = 0; !on && i < host_poll_count; i++) host_polls[i].Due = 0;
+}
+
+/* Let the firmware run until `until`, with the SOFs and the polls that
+   fall due in the meantime */
+void Host_Wait(uint64_t until)
+{
+    uint64_t wake;
+    unsigned i;
+
+    for (;;)
+    {
+        if (sof_on && sim_now >= next_sof) HostSof();
+        wake = until;
+        for (i = 0; host_polling && i < host_poll_count; i++)
+        {
+            if (host_polls[i].Due && sim_now >= host_polls[i].Due) Host_Poll(&host_polls[i]);
+            if (host_polls[i].Due && host_polls[i].Due < wake) wake = host_polls[i].Due;
+        }
+        if (sim_now >= until) return;
+        if (sof_on && next_sof < wake) wake = next_sof;
+
+        sim_wake = wake > sim_now ? wake : sim_now + 1;
+        swapcontext(&host_context, &firmware_context);
+    }
+}
+
+void Sim_World(void)
+{
+    swapcontext(&firmware_context, &host_context);
+}
+
+static void Script(void)
+{
+    host_script();
+    sim_end = sim_now;
+    sim_wake = UINT64_MAX;
+}
+
+void Host_Run(void (*script)(void))
+{
+    host_script = script;
+    getcontext(&host_context);
+    host_context.uc_stack.ss_sp = host_stack;
+    host_context.uc_stack.ss_size = sizeof(host_stack);
+    host_context.uc_link = &firmware_context;
+    makecontext(&host_context, Script, 0);
+
+    /* Script() moves the end to now when the script is done */
+    Sim_Run(UINT64_MAX);
+}
+
+/* Control transfers, one at a time */
+
+#define CONTROL_IDLE        0
+#define CONTROL_SETUP       1
+#define CONTROL_DATA_IN     2
+#define CONTROL_DATA_OUT    3
+#define CONTROL_STATUS_IN   4
+#define CONTROL_STATUS_OUT  5
+
+int Host_Control(uint8_t type, uint8_t request, uint16_t value, uint16_t index, uint16_t length, unsigned stop)
+{
+    uint8_t setup[8];
+    uint8_t toggle = 0;
+    uint8_t count = 0;
+    uint8_t expected = 1;
+    uint16_t done = 0;
+    unsigned transactions = 0;
+    uint8_t stage = CONTROL_SETUP;
+    uint64_t started;
+    int handshake = SIE_NAK;
+
+    setup[0] = type;
+    setup[1] = request;
+    setup[2] = (uint8_t)value;
+    setup[3] = (uint8_t)(value >> 8);
+    setup[4] = (uint8_t)index;
+    setup[5] = (uint8_t)(index >> 8);
+    setup[6] = (uint8_t)length;
+    setup[7] = (uint8_t)(length >> 8);
+
+    if (host_abort_after && --host_abort_after == 0) stop = 1;
+    started = sim_now;
+
+    while (stage != CONTROL_IDLE)
+    {
+        if (stop && transactions == stop) return SIE_NONE;
+
+        switch (stage)
+        {
+        case CONTROL_SETUP:
+            handshake = Sie_Setup(host_address, setup);
+            if (handshake != SIE_ACK) break;
+            if (length == 0) stage = CONTROL_STATUS_IN;
+            else stage = (type & 0x80) ? CONTROL_DATA_IN : CONTROL_DATA_OUT;
+            break;
+
+        case CONTROL_DATA_IN:
+            handshake = Sie_In(host_address, 0, &toggle, host_data + done, &count);
+            if (handshake != SIE_ACK) break;
+            if (toggle != expected)
+            {
+                host_toggle_errors++;
+                break;
+            }
+            expected ^= 1;
+            done += count;
+            if (count < E0SZ || done >= length) stage = CONTROL_STATUS_OUT;
+            break;
+
+        case CONTROL_DATA_OUT:
+            count = (uint8_t)((length - done) < E0SZ ? length - done : E0SZ);
+            handshake = Sie_Out(host_address, 0, expected, host_data + done, count);
+            if (handshake != SIE_ACK) break;
+            expected ^= 1;
+            done += count;
+            if (done >= length) stage = CONTROL_STATUS_IN;
+            break;
+
+        case CONTROL_STATUS_IN:
+            handshake = Sie_In(host_address, 0, &toggle, host_data + done, &count);
+            if (handshake == SIE_ACK) stage = CONTROL_IDLE;
+            break;
+
+        case CONTROL_STATUS_OUT:
+            handshake = Sie_Out(host_address, 0, 1, NULL, 0);
+            if (handshake == SIE_ACK) stage = CONTROL_IDLE;
+            break;
+        }
+
+        if (handshake == SIE_ACK) transactions++;
+        else if (handshake == SIE_STALL) return SIE_STALL;
+        else if (sim_now - started > CONTROL_TIMEOUT) return SIE_NONE;
+        if (stage != CONTROL_IDLE) Host_Wait(sim_now + CONTROL_RETRY);
+    }
+    host_length = done;
+    return SIE_ACK;
+}
+
+int Host_Expect(int handshake, int expected, const char *what)
+{
+    static const char *names[] = { "ACK", "NAK", "STALL", "no answer" };
+
+    if (handshake == expected) return 0;
+    return Host_Problem("%s: %s instead of %s", what, names[handshake], names[expected]);
+}
+
+/* Interrupt IN endpoints and HID interfaces from the configuration descriptor */
+static void ParseConfiguration(const uint8_t *d, uint16_t length)
+{
+    uint16_t at = 0;
+    uint8_t interface = 0;
+    uint8_t class = 0;
+    uint8_t protocol = 0;
+    Poll *poll;
+
+    host_poll_count = 0;
+    host_keyboard = NULL;
+    hid_count = 0;
+    while (at + 2 <= length && d[at] >= 2)
+    {
+        if (d[at + 1] == 0x04)
+        {
+            interface = d[at + 2];
+            class = d[at + 5];
+            protocol = d[at + 7];
+        }
+        else if (d[at + 1] == 0x21 && class == 0x03 && hid_count < HOST_MAX_POLLED)
+        {
+            hid_interfaces[hid_count] = interface;
+            hid_report_sizes[hid_count] = d[at + 7] | (d[at + 8] << 8);
+            hid_count++;
+        }
+        else if (d[at + 1] == 0x05 && (d[at + 2] & 0x80) && (d[at + 3] & 0x03) == 0x03 &&
+                 host_poll_count < HOST_MAX_POLLED)
+        {
+            poll = &host_polls[host_poll_count++];
+            memset(poll, 0, sizeof(*poll));
+            poll->Endpoint = d[at + 2] & 0x0F;
+            poll->Interface = interface;
+            poll->Interval = d[at + 6] ? d[at + 6] : 1;
+            poll->Keyboard = (class == 0x03 && protocol == 0x01);
+            if (poll->Keyboard) host_keyboard = poll;
+        }
+        at += d[at];
+    }
+}
+
+/* Bus reset. Until the device is configured again nothing else may answer,
+   so an interrupt endpoint that still does at address 0 is a failure. */
+int Host_Reset(void)
+{
+    uint8_t data[64];
+    uint8_t toggle;
+    uint8_t count;
+    unsigned i;
+    int handshake;
+
+    host_polling = 0;
+    host_configured = 0;
+    host_address = 0;
+    Host_Bus(0);
+    Sie_BusReset();
+    Host_Bus(1);
+    Host_Wait(sim_now + RESET_RECOVERY);
+
+    for (i = 0; i < host_poll_count; i++)
+    {
+        handshake = Sie_In(0, host_polls[i].Endpoint, &toggle, data, &count);
+        if (handshake != SIE_NONE) return Host_Expect(handshake, SIE_NONE, "interrupt endpoint after a bus reset");
+    }
+    return 0;
+}
+
+/* What a host does after the reset. hid_requests adds SET_IDLE 0 and the
+   report descriptors, leave them out to see an idle rate the reset didn't
+   clear. */
+int Host_Enumerate(int hid_requests)
+{
+    uint16_t total;
+    unsigned i;
+
+    host_address = 0;
+    if (Host_Expect(Host_Control(0x80, 0x06, 0x0100, 0, 64, 0), SIE_ACK, "GET_DESCRIPTOR device") < 0) return -1;
+    if (Host_Expect(Host_Control(0x00, 0x05, HOST_ADDRESS, 0, 0, 0), SIE_ACK, "SET_ADDRESS") < 0) return -1;
+    host_address = HOST_ADDRESS;
+    Host_Wait(sim_now + ADDRESS_RECOVERY);
+
+    if (Host_Expect(Host_Control(0x80, 0x06, 0x0100, 0, 18, 0), SIE_ACK,
+                    "GET_DESCRIPTOR device at the new address") < 0)
+        return -1;
+    if (Host_Expect(Host_Control(0x80, 0x06, 0x0200, 0, 9, 0), SIE_ACK, "GET_DESCRIPTOR configuration") < 0)
+        return -1;
+    total = host_data[2] | (host_data[3] << 8);
+    if (total > sizeof(host_data)) Host_Fail("configuration descriptor too long");
+    if (Host_Expect(Host_Control(0x80, 0x06, 0x0200, 0, total, 0), SIE_ACK, "GET_DESCRIPTOR configuration") < 0)
+        return -1;
+    ParseConfiguration(host_data, host_length);
+    if (host_keyboard == NULL) Host_Fail("no keyboard endpoint in the configuration");
+
+    if (Host_Expect(Host_Control(0x00, 0x09, 1, 0, 0, 0), SIE_ACK, "SET_CONFIGURATION") < 0) return -1;
+    for (i = 0; hid_requests && i < hid_count; i++)
+    {
+        if (Host_Expect(Host_Control(0x21, 0x0A, 0, hid_interfaces[i], 0, 0), SIE_ACK, "SET_IDLE") < 0) return -1;
+        if (Host_Expect(Host_Control(0x81, 0x06, 0x2200, hid_interfaces[i], hid_report_sizes[i], 0), SIE_ACK,
+                        "GET_DESCRIPTOR report") < 0)
+            return -1;
+    }
+
+    host_buttons = 0;
+    host_configured = 1;
+    host_polling = 1;
+    return 0;
+}
+
+/* Connect debounce once the firmware turns the module on, then the reset */
+int Host_Attach(void)
+{
+    while (!Sie_Enabled()) Host_Wait(sim_now + SIM_US(100));
+    Host_Wait(sim_now + SIM_MS(100));
+    if (Host_Reset() < 0) return -1;
+    return Host_Enumerate(1);
+}
@@ -0,0 +1,80 @@
+/*
+ * Scripted USB host for the tools/sim programs that drive the bus as
+ * straight line code (faults.c, golden.c). It provides Sim_World().
+ *
+ * The script runs as a coroutine (ucontext) next to the firmware: it
+ * hands the CPU back in Host_Wait(), and Sim_World() switches to it
+ * whenever sim_now reaches the time it asked for. While it waits the
+ * host keeps the bus going: a SOF every ms (Host_Bus()) and, once
+ * configured, the interrupt IN polls at their bInterval.
+ *
+ * Functions that can fail return -1 with the reason in host_problem.
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include "sim.h"
+
+#define HOST_ADDRESS        5
+#define HOST_MAX_POLLED     8
+
+/* Interrupt IN endpoint the host polls */
+typedef struct
+{
+    uint8_t Endpoint;
+    uint8_t Interface;
+    uint8_t Interval;
+    uint8_t Keyboard;
+    uint8_t Toggle;
+    uint64_t Due;           /* 0 = not this frame */
+    unsigned long Reports;
+    unsigned long Stalls;
+} Poll;
+
+extern Poll host_polls[HOST_MAX_POLLED];
+extern unsigned host_poll_count;
+extern Poll *host_keyboard;             /* Boot keyboard endpoint, after Host_Enumerate() */
+
+extern uint8_t host_address;            /* Tokens go here */
+extern uint8_t host_polling;            /* Interrupt INs at their bInterval, none while clear */
+extern uint8_t host_configured;         /* Set by Host_Enumerate(), cleared by Host_Reset() */
+extern uint64_t host_frames;            /* SOFs sent */
+extern uint8_t host_buttons;            /* Pad buttons in the last keyboard report */
+extern unsigned host_jitter;            /* Random delay of a poll after its SOF offset, us */
+extern uint8_t host_data[1024];         /* Control transfer data, both ways */
+extern uint16_t host_length;            /* Bytes in host_data after an IN transfer */
+extern unsigned host_abort_after;       /* Leave the Nth Host_Control() after its SETUP */
+extern unsigned long host_toggle_errors;
+extern char host_problem[160];
+
+/* Every report the host takes from an interrupt IN, after the toggle check */
+extern void (*host_on_report)(Poll *poll, const uint8_t *data, uint8_t count);
+
+/* Run the firmware from reset with script as the host, until it returns */
+void Host_Run(void (*script)(void));
+
+void Host_Seed(uint64_t seed);
+uint32_t Host_Random(void);
+uint64_t Host_Between(uint64_t low, uint64_t high);
+void Host_Fail(const char *what);       /* Exit 2, the simulation can't go on */
+int Host_Problem(const char *format, ...);
+
+void Host_Wait(uint64_t until);
+void Host_Bus(uint8_t on);              /* SOFs on (resume) or off (suspend, detach) */
+int Host_Poll(Poll *poll);              /* One IN token, returns the handshake */
+
+/* One transfer on EP0. stop > 0 walks away after that many transactions
+   (SETUP included). The SETUP goes out at once, as from a fast host, even
+   if the device hasn't handled the last status stage yet. Returns the
+   handshake that ended it: SIE_ACK done, SIE_STALL refused, SIE_NONE
+   abandoned or timed out. */
+int Host_Control(uint8_t type, uint8_t request, uint16_t value, uint16_t index, uint16_t length, unsigned stop);
+int Host_Expect(int handshake, int expected, const char *what);
+
+int Host_Attach(void);                  /* Wait for the pull up, debounce, reset and enumerate */
+int Host_Reset(void);
+int Host_Enumerate(int hid_requests);
+
+#endif /* HOST_H */
@@ -0,0 +1 @@
+#include "pic16f1455.h"
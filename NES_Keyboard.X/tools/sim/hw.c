@@ -0,0 +1,447 @@
+/*
+ * Hardware models for tools/sim: the registers, Timer1 and the delays,
+ * the interrupt, the pad's 4021 shift register and the USB SIE up to the
+ * BDT (ownership, data toggles, the USTAT FIFO, PKTDIS after a SETUP,
+ * IDLEIF after 3ms without bus activity and ACTVIF on activity while
+ * suspended). The bus side of the SIE is driven by the host in sim.c or
+ * host.c (faults.c, golden.c).
+ *
+ * The 4021 is wired by the sim's own pin table for each PCB revision, not
+ * by board.h, so a wrong pin map there shows up as the firmware driving
+ * or reading the wrong lines.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <htc.h>
+#include "Usb.h"
+#include "board.h"     /* BOARD_REV only */
+#include "sim.h"
+
+/* Buffer descriptor, as Usb.c lays it out */
+#define BD_UOWN             0x80
+#define BD_DTS              0x40
+#define BD_DTSEN            0x08
+#define BD_BSTALL           0x04
+#define BD_PID(pid)         ((pid) << 2)
+#define PID_OUT             0x01
+#define PID_IN              0x09
+#define PID_SETUP           0x0D
+
+#define USTAT_FIFO          4
+#define IDLE_TIME           SIM_MS(3)   /* J state this long sets IDLEIF */
+
+typedef struct
+{
+    uint8_t Stat;
+    uint8_t Cnt;
+    uint16_t ADDR;
+} SimBdt;
+
+/* Firmware objects the SIE reaches through the BDT (defined in Usb.c) */
+extern volatile SimBdt Interfaces[];
+extern volatile uint8_t SetupPacket[];
+extern volatile uint8_t ControlTransferBuffer[];
+void ISRCode(void);
+int firmware_main(void);
+
+volatile uint8_t PORTA, PORTC, LATA, LATC, TRISA, TRISC, ANSELA, ANSELC, WPUA;
+volatile uint8_t OPTION_REG, OSCTUNE, OSCCON, ACTCON, INTCON, PIE2, PIR2;
+volatile uint8_t T1CON, T1GCON, WDTCON, FSR0L, FSR0H, FSR1L, FSR1H;
+volatile uint8_t UCON, UCFG, UIR, UIE, UEIR, UEIE, USTAT, UADDR, UFRML, UFRMH;
+volatile uint8_t UEP[8];
+
+uint64_t sim_now;
+uint64_t sim_wake;
+uint64_t sim_end;
+uint8_t sim_pad;
+unsigned sim_loop_cycles = 10;
+unsigned sim_isr_cycles = 60;
+unsigned long sim_toggle_drops;
+unsigned long sim_pad_reads;
+uint64_t sim_pad_read_cycles;
+
+static jmp_buf sim_exit;
+static uint8_t in_isr;
+
+/* The PCBs as routed: PORTC bits of the pad lines, PORTA bit of the LED */
+typedef struct
+{
+    uint8_t Revision;
+    uint8_t Data;
+    uint8_t Latch;
+    uint8_t Clock;
+    uint8_t Pot;
+    uint8_t Led;
+} SimBoard;
+
+static const SimBoard sim_boards[] =
+{
+    { 1, 3, 5, 4, 2, 4 },   /* Latch and clock swapped */
+    { 2, 3, 4, 5, 2, 4 },
+};
+#define SimBoardCount (sizeof(sim_boards) / sizeof(sim_boards[0]))
+
+static const SimBoard *board;
+static uint8_t last_latc;
+static uint8_t last_lata;
+
+/* 4021: parallel load while P/S (latch) is high, shift on the clock's rising edge */
+static uint8_t shift_register = 0xFF;
+static uint8_t last_clock;
+static uint8_t last_latch;
+static int clocks = -1;             /* Since the last latch, -1 before the first */
+static uint64_t read_start;
+
+/* Completed transactions waiting for TRNIF to be cleared */
+static uint8_t ustat_fifo[USTAT_FIFO];
+static uint8_t ustat_count;
+
+/* Last SOF, token or reset on the bus, and whether IDLEIF was set since */
+static uint64_t last_activity;
+static uint8_t idle_flagged;
+
+#if CdcEnabled
+static uint8_t cdc_notify[CdcNotifyByteCount];  /* Nothing in Usb.c, the endpoint is never armed */
+#endif
+
+/* USB RAM as the firmware addresses it, the fixed addresses from
+   UsbDescriptors.h */
+typedef struct
+{
+    uint16_t Address;
+    volatile uint8_t *Host;
+    uint16_t Size;
+} UsbRam;
+
+static const UsbRam usb_ram[] =
+{
+    { SetupPacketAddress, SetupPacket, E0SZ },
+    { ControlBufferAddress, ControlTransferBuffer, E0SZ },
+    { HidTxAddress, HIDTxBuffer, HidReportByteCount },
+    { HidRxAddress, HIDRxBuffer, HidReportByteCount },
+#if MouseEnabled
+    { MouseTxAddress, MouseTxBuffer, MouseReportByteCount },
+#endif
+#if VendorEnabled
+    { VendorTxAddress, VendorTxBuffer, VendorReportByteCount },
+#endif
+#if PlaybackEnabled
+    { VendorRxAddress, VendorRxBuffer, VendorReportByteCount },
+#endif
+#if CdcEnabled
+    { CdcNotifyAddress, cdc_notify, CdcNotifyByteCount },
+    { CdcTxAddress, CdcTxBuffer, CdcPacketSize },
+    { CdcRxAddress, CdcRxBuffer, CdcPacketSize },
+    { CdcLineCodingAddress, CdcLineCoding, CdcLineCodingByteCount },
+#endif
+};
+#define UsbRamCount (sizeof(usb_ram) / sizeof(usb_ram[0]))
+
+static volatile uint8_t *Resolve(uint16_t address, uint8_t count)
+{
+    unsigned i;
+    uint16_t offset;
+
+    for (i = 0; i < UsbRamCount; i++)
+    {
+        offset = (uint16_t)(address - usb_ram[i].Address);
+        if (offset + count <= usb_ram[i].Size) return usb_ram[i].Host + offset;
+    }
+    fprintf(stderr, "sim: BDT points at 0x%04X (%u bytes), outside the USB buffers\n", address, count);
+    exit(2);
+}
+
+static void PinFail(const char *what, char port, uint8_t bit)
+{
+    fprintf(stderr, "sim: board v%u: %s R%c%u\n", board->Revision, what, port, bit);
+    exit(2);
+}
+
+/* Outputs the firmware toggles have to be the board's, and set up as outputs */
+static void CheckPins(void)
+{
+    uint8_t outputs = (uint8_t)((1 << board->Latch) | (1 << board->Clock));
+    uint8_t changed = LATC ^ last_latc;
+    uint8_t bit;
+
+    for (bit = 0; bit < 6; bit++)
+    {
+        if (!(changed & (1 << bit))) continue;
+        if (!(outputs & (1 << bit))) PinFail("firmware drives", 'C', bit);
+        if (TRISC & (1 << bit)) PinFail("pad output left an input", 'C', bit);
+        if (!(TRISC & (1 << board->Data))) PinFail("pad data is not an input", 'C', board->Data);
+    }
+    last_latc = LATC;
+
+    changed = LATA ^ last_lata;
+    for (bit = 0; bit < 6; bit++)
+    {
+        if (!(changed & (1 << bit))) continue;
+        if (bit != board->Led) PinFail("firmware drives", 'A', bit);
+        if (TRISA & (1 << bit)) PinFail("LED left an input", 'A', bit);
+    }
+    last_lata = LATA;
+}
+
+static void PadModel(void)
+{
+    uint8_t latch;
+    uint8_t clock;
+
+    if (LATC != last_latc || LATA != last_lata) CheckPins();
+    latch = (LATC >> board->Latch) & 0x01;
+    clock = (LATC >> board->Clock) & 0x01;
+
+    /* A read is a latch pulse and 8 clocks, anything else is the wrong lines */
+    if (latch && !last_latch)
+    {
+        if (clocks >= 0 && clocks != 8) PinFail("pad read with a wrong clock count, latch", 'C', board->Latch);
+        clocks = 0;
+        read_start = sim_now;
+    }
+    if (clock && !last_clock)
+    {
+        if (latch) PinFail("pad clocked during the latch pulse, clock", 'C', board->Clock);
+        if (clocks >= 0) clocks++;
+    }
+    if (!clock && last_clock && clocks == 8)
+    {
+        sim_pad_reads++;
+        sim_pad_read_cycles += sim_now - read_start;
+    }
+
+    if (latch) shift_register = (uint8_t)~sim_pad;
+    else if (clock && !last_clock) shift_register = (uint8_t)((shift_register >> 1) | 0x80);
+    last_clock = clock;
+    last_latch = latch;
+
+    PORTC = (uint8_t)((PORTC & ~(1 << board->Data)) | ((shift_register & 0x01) << board->Data));
+}
+
+static void UstatPush(uint8_t ustat)
+{
+    ustat_fifo[ustat_count++] = ustat;
+}
+
+/* A cleared TRNIF brings the next completed transaction in */
+static void UstatAdvance(void)
+{
+    if (UIRbits.TRNIF || ustat_count == 0) return;
+
+    USTAT = ustat_fifo[0];
+    memmove(ustat_fifo, ustat_fifo + 1, --ustat_count);
+    UIRbits.TRNIF = 1;
+}
+
+static void Activity(void)
+{
+    last_activity = sim_now;
+    idle_flagged = 0;
+    if (UCONbits.SUSPND) UIRbits.ACTVIF = 1;
+}
+
+/* Everything that happens outside the CPU, caught up to sim_now */
+static void Service(void)
+{
+    if (sim_now >= sim_end) longjmp(sim_exit, 1);
+
+    PadModel();
+    while (sim_now >= sim_wake) Sim_World();
+    UstatAdvance();
+
+    if (UCONbits.USBEN && !idle_flagged && sim_now - last_activity >= IDLE_TIME)
+    {
+        UIRbits.IDLEIF = 1;
+        idle_flagged = 1;
+    }
+
+    if (UIR & UIE) PIR2bits.USBIF = 1;
+    if (in_isr || !INTCONbits.GIE || !INTCONbits.PEIE || !(PIE2bits.USBIE && PIR2bits.USBIF)) return;
+
+    in_isr = 1;
+    INTCONbits.GIE = 0;
+    sim_now += sim_isr_cycles;
+    ISRCode();
+    INTCONbits.GIE = 1;
+    in_isr = 0;
+}
+
+void sim_delay_us(unsigned long us)
+{
+    while (us--)
+    {
+        sim_now += SIM_CYCLES_PER_US;
+        Service();
+    }
+}
+
+/* Woken by bus activity or the watchdog (SUSPEND_WDTPS, 16ms) */
+void sim_sleep(void)
+{
+    uint64_t timeout = sim_now + SIM_MS(16);
+
+    while (UCONbits.SUSPND && sim_now < timeout)
+    {
+        sim_now += SIM_CYCLES_PER_US;
+        Service();
+    }
+}
+
+uint8_t sim_tmr1h(void)
+{
+    sim_now += sim_loop_cycles;
+    Service();
+    return (uint8_t)(sim_now >> 8);
+}
+
+uint8_t sim_tmr1l(void)
+{
+    return (uint8_t)sim_now;
+}
+
+void Sim_Run(uint64_t end)
+{
+    unsigned i;
+
+    for (i = 0; i < SimBoardCount && sim_boards[i].Revision != BOARD_REV; i++) ;
+    if (i == SimBoardCount)
+    {
+        fprintf(stderr, "sim: no pin table for BOARD_REV %d\n", BOARD_REV);
+        exit(2);
+    }
+    board = &sim_boards[i];
+    last_latc = LATC;
+    last_lata = LATA;
+
+    sim_end = end;
+    if (setjmp(sim_exit) == 0) firmware_main();
+}
+
+int Sie_Enabled(void)
+{
+    return UCONbits.USBEN;
+}
+
+void Sie_BusReset(void)
+{
+    Activity();
+    ustat_count = 0;
+    UIRbits.URSTIF = 1;
+}
+
+void Sie_Sof(uint16_t frame)
+{
+    Activity();
+    UFRML = (uint8_t)frame;
+    UFRMH = (uint8_t)((frame >> 8) & 0x07);
+    UIRbits.SOFIF = 1;
+}
+
+/* Common token checks, returns the descriptor or 0 with the handshake set */
+static volatile SimBdt *Token(uint8_t address, uint8_t ep, uint8_t in, int *handshake)
+{
+    volatile SimBdt *bd = &Interfaces[ep * 2 + in];
+    uint8_t enable = in ? 0x02 : 0x04;  /* EPINEN, EPOUTEN */
+
+    Activity();
+    *handshake = SIE_NONE;
+    if (!UCONbits.USBEN || UCONbits.SUSPND || address != UADDR) return 0;
+    if (ep >= InterfaceCount + 1 || !(UEP[ep] & enable)) return 0;
+
+    *handshake = SIE_NAK;
+    if (UCONbits.PKTDIS || ustat_count + UIRbits.TRNIF >= USTAT_FIFO) return 0;
+    if (!(bd->Stat & BD_UOWN)) return 0;
+    return bd;
+}
+
+int Sie_Setup(uint8_t address, const uint8_t *packet)
+{
+    int handshake;
+    volatile SimBdt *bd = Token(address, 0, 0, &handshake);
+    volatile uint8_t *buffer;
+    uint8_t i;
+
+    /* A SETUP lands even on a stalled endpoint 0 */
+    if (bd == 0) return handshake;
+
+    buffer = Resolve(bd->ADDR, 8);
+    for (i = 0; i < 8; i++) buffer[i] = packet[i];
+    bd->Cnt = 8;
+    bd->Stat = BD_PID(PID_SETUP);
+    UCONbits.PKTDIS = 1;
+    UstatPush(0x00);
+    UstatAdvance();
+    return SIE_ACK;
+}
+
+int Sie_Out(uint8_t address, uint8_t ep, uint8_t toggle, const uint8_t *data, uint8_t count)
+{
+    int handshake;
+    volatile SimBdt *bd = Token(address, ep, 0, &handshake);
+    volatile uint8_t *buffer;
+    uint8_t i;
+
+    if (bd == 0) return handshake;
+    if (bd->Stat & BD_BSTALL)
+    {
+        UIRbits.STALLIF = 1;
+        return SIE_STALL;
+    }
+
+    /* Wrong toggle: ACKed on the bus, but the data and the BD are left alone */
+    if ((bd->Stat & BD_DTSEN) && (!!(bd->Stat & BD_DTS) != toggle))
+    {
+        sim_toggle_drops++;
+        return SIE_ACK;
+    }
+
+    if (count > bd->Cnt) count = bd->Cnt;
+    if (count)
+    {
+        buffer = Resolve(bd->ADDR, count);
+        for (i = 0; i < count; i++) buffer[i] = data[i];
+    }
+    bd->Cnt = count;
+    bd->Stat = BD_PID(PID_OUT) | (toggle ? BD_DTS : 0);
+    UstatPush((uint8_t)(ep << 3));
+    UstatAdvance();
+    return SIE_ACK;
+}
+
+int Sie_In(uint8_t address, uint8_t ep, uint8_t *toggle, uint8_t *data, uint8_t *count)
+{
+    int handshake;
+    volatile SimBdt *bd = Token(address, ep, 1, &handshake);
+    volatile uint8_t *buffer;
+    uint8_t i;
+
+    if (bd == 0) return handshake;
+    if (bd->Stat & BD_BSTALL)
+    {
+        UIRbits.STALLIF = 1;
+        return SIE_STALL;
+    }
+
+    *count = bd->Cnt;
+    *toggle = !!(bd->Stat & BD_DTS);
+    if (*count)
+    {
+        buffer = Resolve(bd->ADDR, *count);
+        for (i = 0; i < *count; i++) data[i] = buffer[i];
+    }
+    bd->Stat = BD_PID(PID_IN) | (bd->Stat & BD_DTS);
+    UstatPush((uint8_t)((ep << 3) | 0x04));
+    UstatAdvance();
+    return SIE_ACK;
+}
+
+/* Damaged packet: the flags go to UEIR, UERRIF if any of them is enabled */
+void Sie_Error(uint8_t flags)
+{
+    Activity();
+    UEIR |= flags;
+    if (UEIR & UEIE) UIRbits.UERRIF = 1;
+}
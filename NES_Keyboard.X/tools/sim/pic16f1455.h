@@ -0,0 +1,120 @@
+/*
+ * PIC16F1455 register model for the host build of the firmware (see
+ * tools/sim/sim.c). Only what the firmware touches is here. Every SFR is a
+ * plain byte, the XXXbits views are bit fields over the same byte.
+ *
+ * Timer1, the delays and SLEEP are calls into the simulator: they are the
+ * points where simulated time passes and interrupts can be taken.
+ */
+
+#ifndef SIM_PIC16F1455_H
+#define SIM_PIC16F1455_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __at(x)
+#define __interrupt(...)
+#define NOP()           ((void)0)
+#define CLRWDT()        ((void)0)
+#define di()            (INTCONbits.GIE = 0)
+#define ei()            (INTCONbits.GIE = 1)
+#define SLEEP()         sim_sleep()
+#define __delay_us(x)   sim_delay_us(x)
+#define __delay_ms(x)   sim_delay_us((x) * 1000UL)
+
+void sim_delay_us(unsigned long us);
+void sim_sleep(void);
+uint8_t sim_tmr1h(void);
+uint8_t sim_tmr1l(void);
+
+#define SFR(name)       extern volatile uint8_t name
+#define SFRBITS(name)   (*(volatile name##bits_t *)&name)
+
+SFR(PORTA);
+SFR(PORTC);
+SFR(LATA);
+SFR(LATC);
+SFR(TRISA);
+SFR(TRISC);
+SFR(ANSELA);
+SFR(ANSELC);
+SFR(WPUA);
+SFR(OPTION_REG);
+SFR(OSCTUNE);
+SFR(OSCCON);
+SFR(ACTCON);
+SFR(INTCON);
+SFR(PIE2);
+SFR(PIR2);
+SFR(T1CON);
+SFR(T1GCON);
+SFR(WDTCON);
+SFR(FSR0L);
+SFR(FSR0H);
+SFR(FSR1L);
+SFR(FSR1H);
+SFR(UCON);
+SFR(UCFG);
+SFR(UIR);
+SFR(UIE);
+SFR(UEIR);
+SFR(UEIE);
+SFR(USTAT);
+SFR(UADDR);
+SFR(UFRML);
+SFR(UFRMH);
+extern volatile uint8_t UEP[8];
+
+#define UEP0            (UEP[0])
+#define UEP1            (UEP[1])
+#define UEP2            (UEP[2])
+#define UEP3            (UEP[3])
+#define UEP4            (UEP[4])
+#define UEP5            (UEP[5])
+#define UEP6            (UEP[6])
+#define UEP7            (UEP[7])
+
+/* Reads only - each one lets time pass (see sim.h) */
+#define TMR1H           sim_tmr1h()
+#define TMR1L           sim_tmr1l()
+
+typedef struct { uint8_t RA0:1, RA1:1, RA2:1, RA3:1, RA4:1, RA5:1, :2; } PORTAbits_t;
+typedef struct { uint8_t RC0:1, RC1:1, RC2:1, RC3:1, RC4:1, RC5:1, :2; } PORTCbits_t;
+typedef struct { uint8_t LATA0:1, LATA1:1, LATA2:1, LATA3:1, LATA4:1, LATA5:1, :2; } LATAbits_t;
+typedef struct { uint8_t LATC0:1, LATC1:1, LATC2:1, LATC3:1, LATC4:1, LATC5:1, :2; } LATCbits_t;
+typedef struct { uint8_t TRISA0:1, TRISA1:1, TRISA2:1, TRISA3:1, TRISA4:1, TRISA5:1, :2; } TRISAbits_t;
+typedef struct { uint8_t TRISC0:1, TRISC1:1, TRISC2:1, TRISC3:1, TRISC4:1, TRISC5:1, :2; } TRISCbits_t;
+typedef struct { uint8_t ANSA0:1, ANSA1:1, ANSA2:1, ANSA3:1, ANSA4:1, ANSA5:1, :2; } ANSELAbits_t;
+typedef struct { uint8_t ANSC0:1, ANSC1:1, ANSC2:1, ANSC3:1, ANSC4:1, ANSC5:1, :2; } ANSELCbits_t;
+typedef struct { uint8_t WPUA0:1, WPUA1:1, WPUA2:1, WPUA3:1, WPUA4:1, WPUA5:1, :2; } WPUAbits_t;
+typedef struct { uint8_t PS:3, PSA:1, TMR0SE:1, TMR0CS:1, INTEDG:1, nWPUEN:1; } OPTION_REGbits_t;
+typedef struct { uint8_t IOCIF:1, INTF:1, TMR0IF:1, IOCIE:1, INTE:1, TMR0IE:1, PEIE:1, GIE:1; } INTCONbits_t;
+typedef struct { uint8_t :2, USBIE:1, BCL1IE:1, :3, OSFIE:1; } PIE2bits_t;
+typedef struct { uint8_t :2, USBIF:1, BCL1IF:1, :3, OSFIF:1; } PIR2bits_t;
+typedef struct { uint8_t SWDTEN:1, WDTPS:5, :2; } WDTCONbits_t;
+typedef struct { uint8_t :1, SUSPND:1, RESUME:1, USBEN:1, PKTDIS:1, SE0:1, PPBRST:1, :1; } UCONbits_t;
+typedef struct { uint8_t URSTIF:1, UERRIF:1, ACTVIF:1, TRNIF:1, IDLEIF:1, STALLIF:1, SOFIF:1, :1; } UIRbits_t;
+typedef struct { uint8_t URSTIE:1, UERRIE:1, ACTVIE:1, TRNIE:1, IDLEIE:1, STALLIE:1, SOFIE:1, :1; } UIEbits_t;
+typedef struct { uint8_t EPSTALL:1, EPINEN:1, EPOUTEN:1, EPCONDIS:1, EPHSHK:1, :3; } UEP0bits_t;
+
+#define PORTAbits       SFRBITS(PORTA)
+#define PORTCbits       SFRBITS(PORTC)
+#define LATAbits        SFRBITS(LATA)
+#define LATCbits        SFRBITS(LATC)
+#define TRISAbits       SFRBITS(TRISA)
+#define TRISCbits       SFRBITS(TRISC)
+#define ANSELAbits      SFRBITS(ANSELA)
+#define ANSELCbits      SFRBITS(ANSELC)
+#define WPUAbits        SFRBITS(WPUA)
+#define OPTION_REGbits  SFRBITS(OPTION_REG)
+#define INTCONbits      SFRBITS(INTCON)
+#define PIE2bits        SFRBITS(PIE2)
+#define PIR2bits        SFRBITS(PIR2)
+#define WDTCONbits      SFRBITS(WDTCON)
+#define UCONbits        SFRBITS(UCON)
+#define UIRbits         SFRBITS(UIR)
+#define UIEbits         SFRBITS(UIE)
+#define UEP0bits        (*(volatile UEP0bits_t *)&UEP[0])
+
+#endif /* SIM_PIC16F1455_H */
@@ -0,0 +1,809 @@
+/*
+ * End to end latency simulator: the real firmware (the Source .c files, built
+ * for the host against tools/sim/pic16f1455.h) running against models of
+ * the pad's 4021, the USB SIE and a host that enumerates the device and
+ * then polls its interrupt endpoints, see hw.c and sim.h.
+ *
+ *   make sim SIM_ARGS="--seed 7 --interval 4"
+ *   build/sim/nes_sim [--option value ...]
+ *
+ * After enumeration a random button timeline is played on the pad and
+ * every edge is matched to the keyboard report that first shows it. The
+ * output is the press/release to host latency (edge to the IN transaction
+ * that carried it), edges the host never saw and reports that show a
+ * newer edge before an older one. --gate-* turn it into a pass/fail check,
+ * exit status 1 when a gate is missed, 2 when the simulation itself failed.
+ * With MouseEnabled the timeline will now and then hit the mouse mode
+ * combo and take the pad away from the keyboard, so expect drops there.
+ *
+ * Latency is also split by the pad poll rate the firmware was at when the
+ * edge happened (see Main.c), with the pad reads per second and the share
+ * of the CPU they take at that rate. Edges only land at the idle rate
+ * with gaps past IDLE_AFTER_FRAMES: --gap 6000 --min-gap 5500.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <htc.h>
+#include "Usb.h"
+#include "nes_keyboard.h"
+#include "scheduler.h"
+#include "sim.h"
+
+#undef main     /* The firmware's is firmware_main() */
+
+#define KEYBOARD_SHIFT      0x20    /* Right shift modifier, SELECT */
+#define DEVICE_ADDRESS      5
+#define MAX_POLLED          8
+#define CONTROL_RETRY       SIM_US(10)
+#define CONTROL_TIMEOUT     SIM_MS(500)
+#define HISTOGRAM_BIN       250     /* us */
+#define HISTOGRAM_BINS      64
+#define TASK_INPUT          0       /* PadTask() in Main.c's Tasks[] */
+
+/* Firmware state (Main.c): pad poll periods */
+extern Task Tasks[];
+extern uint8_t poll_frames_active;
+
+/* Command line, all integers */
+typedef struct
+{
+    const char *Name;
+    long Value;
+    const char *Help;
+} Option;
+
+static Option options[] =
+{
+    { "seed",        1,     "random seed for the timeline and the poll jitter" },
+    { "duration",    20000, "timeline length, ms" },
+    { "gap",         30,    "mean time between edges, ms (uniform from --min-gap)" },
+    { "min-gap",     2,     "shortest time between edges, ms" },
+    { "max-held",    3,     "most buttons held at once" },
+    { "settle",      200,   "idle time between enumeration and the timeline, ms" },
+    { "interval",    0,     "keyboard poll interval, frames (0 = bInterval)" },
+    { "poll-offset", 20,    "poll position in the frame after SOF, us" },
+    { "jitter",      100,   "random extra poll delay, us" },
+    { "loop-cycles", 10,    "cycles charged per Timer1 read" },
+    { "isr-cycles",  60,    "cycles charged per interrupt" },
+    { "gate-p99",    0,     "fail if the 99th percentile latency is above this, us (0 = off)" },
+    { "gate-max",    0,     "fail if the worst latency is above this, us (0 = off)" },
+    { "gate-drops",  -1,    "fail if more edges than this were dropped (-1 = off)" },
+};
+#define OptionCount (sizeof(options) / sizeof(options[0]))
+#define OPT(i)      (options[i].Value)
+enum { O_SEED, O_DURATION, O_GAP, O_MIN_GAP, O_MAX_HELD, O_SETTLE, O_INTERVAL, O_OFFSET, O_JITTER,
+       O_LOOP, O_ISR, O_GATE_P99, O_GATE_MAX, O_GATE_DROPS };
+
+static const char *log_path;
+
+/* Timeline edge and what the host made of it */
+#define EDGE_PENDING        0
+#define EDGE_SEEN           1
+#define EDGE_DROPPED        2
+
+typedef struct
+{
+    uint64_t At;
+    uint64_t Seen;
+    uint8_t Button;
+    uint8_t Value;
+    uint8_t State;
+    uint8_t Idle;           /* Pad polled at the idle rate when it happened */
+} Edge;
+
+static Edge *edges;
+static size_t edge_count;
+static size_t edge_size;
+static size_t first_pending[BUTTON_COUNT];
+
+/* Interrupt IN endpoint the host polls */
+typedef struct
+{
+    uint8_t Endpoint;
+    uint8_t Interval;
+    uint8_t Keyboard;
+    uint8_t Toggle;
+    uint64_t Due;           /* 0 = not this frame */
+    unsigned long Reports;
+    unsigned long Naks;
+} Poll;
+
+static Poll polls[MAX_POLLED];
+static unsigned poll_count;
+
+/* Control transfer in progress */
+#define CONTROL_IDLE        0
+#define CONTROL_SETUP       1
+#define CONTROL_DATA_IN     2
+#define CONTROL_DATA_OUT    3
+#define CONTROL_STATUS_IN   4
+#define CONTROL_STATUS_OUT  5
+
+typedef struct
+{
+    uint8_t Setup[8];
+    uint8_t Data[1024];
+    uint16_t Length;
+    uint16_t Done;
+    uint8_t Toggle;
+    uint8_t Stage;
+    uint8_t Stalled;
+    uint64_t Next;
+    uint64_t Started;
+} Control;
+
+static Control control;
+
+/* Host */
+#define HOST_DETACHED       0
+#define HOST_RESETTING      1
+#define HOST_ENUMERATING    2
+#define HOST_RUNNING        3
+
+static uint8_t host_state = HOST_DETACHED;
+static uint8_t address;
+static uint8_t enumerate_step;
+static uint8_t hid_interfaces[MAX_POLLED];
+static uint16_t hid_report_sizes[MAX_POLLED];
+static unsigned hid_count;
+static unsigned hid_step;
+static uint64_t reset_at;
+static uint64_t configured_at;
+static unsigned long enumeration_transactions;  /* EP0 transactions ACKed, reset to configured */
+static unsigned long enumeration_naks;
+static uint64_t next_sof;
+static uint16_t frame;
+
+/* Timeline and results */
+static uint64_t timeline_start;
+static uint64_t timeline_end;
+static uint64_t next_edge;
+static uint8_t host_buttons;
+static uint64_t newest_seen;
+static unsigned long inversions;
+static unsigned long phantoms;
+static unsigned long toggle_errors;
+static unsigned long keyboard_reports;
+
+/* Time and pad reads at each poll rate, over the timeline */
+static uint64_t mode_time[2];
+static unsigned long mode_reads[2];
+static uint64_t mode_read_cycles[2];
+static uint64_t accounted_at;
+static unsigned long accounted_reads;
+static uint64_t accounted_read_cycles;
+
+static uint64_t rng;
+
+static uint32_t Random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (uint32_t)(rng >> 32);
+}
+
+static uint64_t RandomBetween(uint64_t low, uint64_t high)
+{
+    if (high <= low) return low;
+    return low + (((uint64_t)Random() << 32) | Random()) % (high - low + 1);
+}
+
+static void Fail(const char *what)
+{
+    fprintf(stderr, "sim: %s at %.3f ms\n", what, sim_now / (double)SIM_MS(1));
+    exit(2);
+}
+
+/* Pad */
+
+static uint8_t IdleRate(void)
+{
+    return Tasks[TASK_INPUT].Period != poll_frames_active;
+}
+
+/* Charge the time and the pad reads since the last call to the current rate */
+static void Account(void)
+{
+    uint8_t idle = IdleRate();
+
+    if (accounted_at)
+    {
+        mode_time[idle] += sim_now - accounted_at;
+        mode_reads[idle] += sim_pad_reads - accounted_reads;
+        mode_read_cycles[idle] += sim_pad_read_cycles - accounted_read_cycles;
+    }
+    accounted_at = sim_now;
+    accounted_reads = sim_pad_reads;
+    accounted_read_cycles = sim_pad_read_cycles;
+}
+
+static void AddEdge(uint8_t button, uint8_t value)
+{
+    if (edge_count == edge_size)
+    {
+        edge_size = edge_size ? edge_size * 2 : 4096;
+        edges = realloc(edges, edge_size * sizeof(Edge));
+        if (edges == NULL) Fail("out of memory");
+    }
+    edges[edge_count].At = sim_now;
+    edges[edge_count].Seen = 0;
+    edges[edge_count].Button = button;
+    edges[edge_count].Value = value;
+    edges[edge_count].State = EDGE_PENDING;
+    edges[edge_count].Idle = IdleRate();
+    edge_count++;
+}
+
+static unsigned Held(uint8_t buttons)
+{
+    unsigned n = 0;
+
+    for (; buttons; buttons &= buttons - 1) n++;
+    return n;
+}
+
+/* One random press or release, never more than --max-held down at once */
+static void NextEdge(void)
+{
+    uint8_t button = (uint8_t)(Random() % BUTTON_COUNT);
+
+    if (!(sim_pad & (1 << button)) && Held(sim_pad) >= (unsigned)OPT(O_MAX_HELD))
+    {
+        while (!(sim_pad & (1 << button))) button = (button + 1) % BUTTON_COUNT;
+    }
+    sim_pad ^= (uint8_t)(1 << button);
+    AddEdge(button, (sim_pad >> button) & 1);
+
+    next_edge = sim_now + RandomBetween(SIM_MS(OPT(O_MIN_GAP)), SIM_MS(2 * OPT(O_GAP) - OPT(O_MIN_GAP)));
+    if (next_edge >= timeline_end) next_edge = 0;
+}
+
+/* The host saw button change to value: the newest edge like that before
+   now is the one it shows, anything older still pending was lost */
+static void Match(uint8_t button, uint8_t value, uint64_t previous_newest, uint64_t *report_newest)
+{
+    size_t i;
+    size_t match = edge_count;
+
+    for (i = first_pending[button]; i < edge_count && edges[i].At <= sim_now; i++)
+    {
+        if (edges[i].Button == button && edges[i].State == EDGE_PENDING && edges[i].Value == value) match = i;
+    }
+    if (match == edge_count)
+    {
+        phantoms++;
+        return;
+    }
+
+    for (i = first_pending[button]; i < match; i++)
+    {
+        if (edges[i].Button == button && edges[i].State == EDGE_PENDING) edges[i].State = EDGE_DROPPED;
+    }
+    edges[match].State = EDGE_SEEN;
+    edges[match].Seen = sim_now;
+    if (edges[match].At < previous_newest) inversions++;
+    if (edges[match].At > *report_newest) *report_newest = edges[match].At;
+
+    for (i = match + 1; i < edge_count && edges[i].Button != button; i++) ;
+    first_pending[button] = i;
+}
+
+static void KeyboardReport(const uint8_t *report, uint8_t count)
+{
+    uint8_t buttons = 0;
+    uint8_t changed;
+    uint8_t i;
+    uint8_t k;
+    uint64_t newest = newest_seen;
+
+    if (count < HidReportByteCount) return;
+    keyboard_reports++;
+
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (button_keys[i] == KEY_RIGHTSHIFT)
+        {
+            if (report[0] & KEYBOARD_SHIFT) buttons |= (uint8_t)(1 << i);
+            continue;
+        }
+        for (k = 2; k < HidReportByteCount; k++)
+        {
+            if (report[k] == button_keys[i]) buttons |= (uint8_t)(1 << i);
+        }
+    }
+
+    changed = buttons ^ host_buttons;
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (changed & (1 << i)) Match(i, (buttons >> i) & 1, newest_seen, &newest);
+    }
+    host_buttons = buttons;
+    newest_seen = newest;
+}
+
+/* Host: polling */
+
+static void PollEndpoint(Poll *poll)
+{
+    uint8_t data[64];
+    uint8_t count = 0;
+    uint8_t toggle = 0;
+    int handshake = Sie_In(address, poll->Endpoint, &toggle, data, &count);
+
+    poll->Due = 0;
+    if (handshake == SIE_NAK)
+    {
+        poll->Naks++;
+        return;
+    }
+    if (handshake != SIE_ACK) return;
+
+    /* A repeated toggle is a retry of data already taken */
+    if (toggle != poll->Toggle)
+    {
+        toggle_errors++;
+        return;
+    }
+    poll->Toggle ^= 1;
+    poll->Reports++;
+    if (poll->Keyboard && sim_now >= timeline_start) KeyboardReport(data, count);
+}
+
+static void StartOfFrame(void)
+{
+    unsigned i;
+    uint64_t jitter = OPT(O_JITTER) > 0 ? (uint64_t)OPT(O_JITTER) : 0;
+
+    frame = (frame + 1) & 0x7FF;
+    Sie_Sof(frame);
+
+    if (host_state == HOST_RUNNING)
+    {
+        for (i = 0; i < poll_count; i++)
+        {
+            if (frame % polls[i].Interval) continue;
+            polls[i].Due = next_sof + SIM_US(OPT(O_OFFSET)) + SIM_US(RandomBetween(0, jitter));
+        }
+    }
+    next_sof += SIM_MS(1);
+}
+
+/* Host: control transfers */
+
+static void Request(uint8_t type, uint8_t request, uint16_t value, uint16_t index, uint16_t length)
+{
+    control.Setup[0] = type;
+    control.Setup[1] = request;
+    control.Setup[2] = (uint8_t)value;
+    control.Setup[3] = (uint8_t)(value >> 8);
+    control.Setup[4] = (uint8_t)index;
+    control.Setup[5] = (uint8_t)(index >> 8);
+    control.Setup[6] = (uint8_t)length;
+    control.Setup[7] = (uint8_t)(length >> 8);
+    control.Length = length;
+    control.Done = 0;
+    control.Stalled = 0;
+    control.Stage = CONTROL_SETUP;
+    control.Started = sim_now;
+    control.Next = sim_now;
+}
+
+static void ControlStep(void)
+{
+    uint8_t count;
+    uint8_t toggle;
+    int handshake = SIE_NAK;
+
+    switch (control.Stage)
+    {
+    case CONTROL_SETUP:
+        handshake = Sie_Setup(address, control.Setup);
+        if (handshake != SIE_ACK) break;
+        control.Toggle = 1;
+        if (control.Length == 0) control.Stage = CONTROL_STATUS_IN;
+        else control.Stage = (control.Setup[0] & 0x80) ? CONTROL_DATA_IN : CONTROL_DATA_OUT;
+        break;
+
+    case CONTROL_DATA_IN:
+        handshake = Sie_In(address, 0, &toggle, control.Data + control.Done, &count);
+        if (handshake != SIE_ACK) break;
+        if (toggle != control.Toggle)
+        {
+            toggle_errors++;
+            break;
+        }
+        control.Toggle ^= 1;
+        control.Done += count;
+        if (count < E0SZ || control.Done >= control.Length) control.Stage = CONTROL_STATUS_OUT;
+        break;
+
+    case CONTROL_DATA_OUT:
+        count = (uint8_t)((control.Length - control.Done) < E0SZ ? control.Length - control.Done : E0SZ);
+        handshake = Sie_Out(address, 0, control.Toggle, control.Data + control.Done, count);
+        if (handshake != SIE_ACK) break;
+        control.Toggle ^= 1;
+        control.Done += count;
+        if (control.Done >= control.Length) control.Stage = CONTROL_STATUS_IN;
+        break;
+
+    case CONTROL_STATUS_IN:
+        handshake = Sie_In(address, 0, &toggle, control.Data + control.Done, &count);
+        if (handshake == SIE_ACK) control.Stage = CONTROL_IDLE;
+        break;
+
+    case CONTROL_STATUS_OUT:
+        handshake = Sie_Out(address, 0, 1, NULL, 0);
+        if (handshake == SIE_ACK) control.Stage = CONTROL_IDLE;
+        break;
+    }
+
+    if (host_state == HOST_ENUMERATING)
+    {
+        if (handshake == SIE_ACK) enumeration_transactions++;
+        else if (handshake == SIE_NAK) enumeration_naks++;
+    }
+
+    if (handshake == SIE_STALL)
+    {
+        control.Stalled = 1;
+        control.Stage = CONTROL_IDLE;
+    }
+    else if (control.Stage != CONTROL_IDLE && sim_now - control.Started > CONTROL_TIMEOUT)
+    {
+        Fail("control transfer timed out");
+    }
+    control.Next = sim_now + CONTROL_RETRY;
+}
+
+/* Interrupt IN endpoints and HID interfaces from the configuration descriptor */
+static void ParseConfiguration(const uint8_t *d, uint16_t length)
+{
+    uint16_t at = 0;
+    uint8_t interface = 0;
+    uint8_t class = 0;
+    uint8_t protocol = 0;
+    Poll *poll;
+
+    while (at + 2 <= length && d[at] >= 2)
+    {
+        if (d[at + 1] == 0x04)
+        {
+            interface = d[at + 2];
+            class = d[at + 5];
+            protocol = d[at + 7];
+        }
+        else if (d[at + 1] == 0x21 && class == 0x03 && hid_count < MAX_POLLED)
+        {
+            hid_interfaces[hid_count] = interface;
+            hid_report_sizes[hid_count] = d[at + 7] | (d[at + 8] << 8);
+            hid_count++;
+        }
+        else if (d[at + 1] == 0x05 && (d[at + 2] & 0x80) && (d[at + 3] & 0x03) == 0x03 && poll_count < MAX_POLLED)
+        {
+            poll = &polls[poll_count++];
+            poll->Endpoint = d[at + 2] & 0x0F;
+            poll->Interval = d[at + 6] ? d[at + 6] : 1;
+            poll->Keyboard = (class == 0x03 && protocol == 0x01);
+            if (poll->Keyboard && OPT(O_INTERVAL) > 0) poll->Interval = (uint8_t)OPT(O_INTERVAL);
+        }
+        at += d[at];
+    }
+}
+
+/* What a host does after the reset, one request at a time */
+static void Enumerate(void)
+{
+    uint16_t total;
+
+    if (control.Stalled && enumerate_step <= 6) Fail("enumeration request stalled");
+
+    switch (enumerate_step++)
+    {
+    case 0:
+        Request(0x80, 0x06, 0x0100, 0, 64);                 /* GET_DESCRIPTOR device */
+        break;
+    case 1:
+        Request(0x00, 0x05, DEVICE_ADDRESS, 0, 0);          /* SET_ADDRESS */
+        break;
+    case 2:
+        address = DEVICE_ADDRESS;
+        Request(0x80, 0x06, 0x0100, 0, 18);
+        control.Next = sim_now + SIM_MS(2);                 /* SET_ADDRESS recovery */
+        break;
+    case 3:
+        Request(0x80, 0x06, 0x0200, 0, 9);                  /* GET_DESCRIPTOR configuration */
+        break;
+    case 4:
+        total = control.Data[2] | (control.Data[3] << 8);
+        if (total > sizeof(control.Data)) Fail("configuration descriptor too long");
+        Request(0x80, 0x06, 0x0200, 0, total);
+        break;
+    case 5:
+        ParseConfiguration(control.Data, control.Done);
+        Request(0x00, 0x09, 1, 0, 0);                       /* SET_CONFIGURATION */
+        break;
+    default:
+        /* SET_IDLE 0 and GET_DESCRIPTOR report for each HID interface */
+        if (hid_step < hid_count * 2)
+        {
+            if (hid_step & 1)
+                Request(0x81, 0x06, 0x2200, hid_interfaces[hid_step / 2], hid_report_sizes[hid_step / 2]);
+            else
+                Request(0x21, 0x0A, 0, hid_interfaces[hid_step / 2], 0);
+            hid_step++;
+            break;
+        }
+        host_state = HOST_RUNNING;
+        configured_at = sim_now;
+        timeline_start = sim_now + SIM_MS(OPT(O_SETTLE));
+        timeline_end = timeline_start + SIM_MS(OPT(O_DURATION));
+        next_edge = timeline_start;
+        sim_end = timeline_end + SIM_MS(100);   /* Time for the last edge to arrive */
+        break;
+    }
+}
+
+static uint64_t Earliest(uint64_t a, uint64_t b)
+{
+    if (a == 0) return b;
+    if (b == 0) return a;
+    return a < b ? a : b;
+}
+
+void Sim_World(void)
+{
+    uint64_t wake = 0;
+    unsigned i;
+
+    switch (host_state)
+    {
+    case HOST_DETACHED:
+        /* Connect debounce, then the bus reset */
+        if (!Sie_Enabled())
+        {
+            sim_wake = sim_now + SIM_US(100);
+            return;
+        }
+        host_state = HOST_RESETTING;
+        reset_at = sim_now + SIM_MS(100);
+        sim_wake = reset_at;
+        return;
+
+    case HOST_RESETTING:
+        Sie_BusReset();
+        host_state = HOST_ENUMERATING;
+        next_sof = sim_now + SIM_MS(10);
+        control.Next = next_sof + SIM_US(100);
+        enumerate_step = 0;
+        sim_wake = next_sof;
+        return;
+    }
+
+    if (sim_now >= next_sof) StartOfFrame();
+    if (timeline_start && sim_now >= timeline_start && sim_now <= timeline_end) Account();
+
+    for (i = 0; i < poll_count; i++)
+    {
+        if (polls[i].Due && sim_now >= polls[i].Due) PollEndpoint(&polls[i]);
+        wake = Earliest(wake, polls[i].Due);
+    }
+
+    if (host_state == HOST_ENUMERATING && sim_now >= control.Next)
+    {
+        if (control.Stage == CONTROL_IDLE) Enumerate();
+        else ControlStep();
+    }
+    if (host_state == HOST_ENUMERATING || control.Stage != CONTROL_IDLE) wake = Earliest(wake, control.Next);
+
+    if (next_edge && sim_now >= next_edge) NextEdge();
+    wake = Earliest(wake, next_edge);
+
+    wake = Earliest(wake, next_sof);
+    sim_wake = wake > sim_now ? wake : sim_now + 1;
+}
+
+/* Results */
+
+static int CompareLatency(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double Us(uint64_t cycles)
+{
+    return cycles / (double)SIM_CYCLES_PER_US;
+}
+
+/* Latency of the edges seen at one poll rate, and what that rate costs */
+static void ModeReport(const char *name, uint8_t idle)
+{
+    uint64_t *latency = malloc((edge_count + 1) * sizeof(uint64_t));
+    size_t seen = 0;
+    size_t i;
+    double seconds = mode_time[idle] / (double)SIM_MS(1000);
+
+    if (latency == NULL) Fail("out of memory");
+    for (i = 0; i < edge_count; i++)
+    {
+        if (edges[i].State == EDGE_SEEN && edges[i].Idle == idle) latency[seen++] = edges[i].Seen - edges[i].At;
+    }
+    printf("%-6s %6zu edges", name, seen);
+    if (seen)
+    {
+        qsort(latency, seen, sizeof(uint64_t), CompareLatency);
+        printf(", latency us p50 %.0f p99 %.0f max %.0f", Us(latency[seen / 2]),
+               Us(latency[(seen - 1) * 99 / 100]), Us(latency[seen - 1]));
+    }
+    if (seconds > 0)
+    {
+        printf(", %.0f pad reads/s, %.1f%% of the CPU", mode_reads[idle] / seconds,
+               mode_read_cycles[idle] * 100.0 / mode_time[idle]);
+    }
+    printf("\n");
+    free(latency);
+}
+
+static void WriteLog(void)
+{
+    FILE *out = fopen(log_path, "w");
+    size_t i;
+
+    if (out == NULL)
+    {
+        perror(log_path);
+        return;
+    }
+    fprintf(out, "button,value,edge_us,seen_us,latency_us\n");
+    for (i = 0; i < edge_count; i++)
+    {
+        fprintf(out, "%u,%u,%.1f,", edges[i].Button, edges[i].Value, Us(edges[i].At - timeline_start));
+        if (edges[i].State == EDGE_SEEN)
+            fprintf(out, "%.1f,%.1f\n", Us(edges[i].Seen - timeline_start), Us(edges[i].Seen - edges[i].At));
+        else
+            fprintf(out, ",\n");
+    }
+    fclose(out);
+}
+
+static int Report(void)
+{
+    uint64_t *latency = malloc((edge_count + 1) * sizeof(uint64_t));
+    unsigned long histogram[HISTOGRAM_BINS + 1] = { 0 };
+    unsigned long dropped = 0;
+    unsigned long peak = 0;
+    uint64_t sum = 0;
+    size_t seen = 0;
+    size_t i;
+    unsigned bin;
+    unsigned last = 0;
+    int failed = 0;
+
+    if (latency == NULL) Fail("out of memory");
+    for (i = 0; i < edge_count; i++)
+    {
+        if (edges[i].State == EDGE_PENDING) edges[i].State = EDGE_DROPPED;
+        if (edges[i].State == EDGE_DROPPED)
+        {
+            dropped++;
+            continue;
+        }
+        latency[seen] = edges[i].Seen - edges[i].At;
+        sum += latency[seen];
+        bin = (unsigned)(Us(latency[seen]) / HISTOGRAM_BIN);
+        if (bin > HISTOGRAM_BINS) bin = HISTOGRAM_BINS;
+        histogram[bin]++;
+        seen++;
+    }
+    qsort(latency, seen, sizeof(uint64_t), CompareLatency);
+
+    printf("enumerated %.1f ms after the bus reset, %lu EP0 transactions (%lu NAKed)\n",
+           Us(configured_at - reset_at) / 1000, enumeration_transactions, enumeration_naks);
+    for (i = 0; i < poll_count; i++)
+    {
+        printf("EP%u IN every %u ms%s: %lu reports, %lu NAKs\n", polls[i].Endpoint, polls[i].Interval,
+               polls[i].Keyboard ? " (keyboard)" : "", polls[i].Reports, polls[i].Naks);
+    }
+    printf("edges %zu, seen %zu, dropped %lu, out of order %lu, unexplained %lu\n",
+           edge_count, seen, dropped, inversions, phantoms);
+    printf("keyboard reports %lu, toggle errors %lu, OUT toggle drops %lu\n",
+           keyboard_reports, toggle_errors, sim_toggle_drops);
+    if (seen == 0)
+    {
+        printf("no edges seen\n");
+        free(latency);
+        return 1;
+    }
+
+    printf("latency us: min %.0f p50 %.0f p90 %.0f p99 %.0f max %.0f mean %.0f\n",
+           Us(latency[0]), Us(latency[seen / 2]), Us(latency[(seen - 1) * 90 / 100]),
+           Us(latency[(seen - 1) * 99 / 100]), Us(latency[seen - 1]), Us(sum / seen));
+    ModeReport("active", 0);
+    ModeReport("idle", 1);
+
+    for (bin = 0; bin <= HISTOGRAM_BINS; bin++)
+    {
+        if (histogram[bin]) last = bin;
+        if (histogram[bin] > peak) peak = histogram[bin];
+    }
+    for (bin = (unsigned)(Us(latency[0]) / HISTOGRAM_BIN); bin <= last; bin++)
+    {
+        if (bin == HISTOGRAM_BINS) printf("%5u+    ", bin * HISTOGRAM_BIN);
+        else printf("%5u-%-5u", bin * HISTOGRAM_BIN, (bin + 1) * HISTOGRAM_BIN);
+        printf(" %6lu %.*s\n", histogram[bin], (int)(histogram[bin] * 50 / peak),
+               "##################################################");
+    }
+
+    if (OPT(O_GATE_P99) > 0 && Us(latency[(seen - 1) * 99 / 100]) > OPT(O_GATE_P99))
+    {
+        printf("GATE: p99 above %ld us\n", OPT(O_GATE_P99));
+        failed = 1;
+    }
+    if (OPT(O_GATE_MAX) > 0 && Us(latency[seen - 1]) > OPT(O_GATE_MAX))
+    {
+        printf("GATE: max above %ld us\n", OPT(O_GATE_MAX));
+        failed = 1;
+    }
+    if (OPT(O_GATE_DROPS) >= 0 && dropped > (unsigned long)OPT(O_GATE_DROPS))
+    {
+        printf("GATE: more than %ld dropped edges\n", OPT(O_GATE_DROPS));
+        failed = 1;
+    }
+    if (OPT(O_GATE_DROPS) >= 0 && (inversions || phantoms || toggle_errors))
+    {
+        printf("GATE: reports out of order or out of sync\n");
+        failed = 1;
+    }
+    free(latency);
+    return failed;
+}
+
+static void Usage(const char *name)
+{
+    unsigned i;
+
+    fprintf(stderr, "usage: %s [--option value ...]\n", name);
+    for (i = 0; i < OptionCount; i++)
+        fprintf(stderr, "  --%-12s %s (%ld)\n", options[i].Name, options[i].Help, options[i].Value);
+    fprintf(stderr, "  --%-12s every edge as CSV\n", "log file");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int a;
+    unsigned i;
+    char *end;
+
+    for (a = 1; a < argc; a++)
+    {
+        if (strncmp(argv[a], "--", 2) != 0 || a + 1 >= argc) Usage(argv[0]);
+        if (strcmp(argv[a] + 2, "log") == 0)
+        {
+            log_path = argv[++a];
+            continue;
+        }
+        for (i = 0; i < OptionCount && strcmp(argv[a] + 2, options[i].Name) != 0; i++) ;
+        if (i == OptionCount) Usage(argv[0]);
+        options[i].Value = strtol(argv[++a], &end, 0);
+        if (*end) Usage(argv[0]);
+    }
+    if (OPT(O_MIN_GAP) < 0 || OPT(O_GAP) < OPT(O_MIN_GAP) || OPT(O_MAX_HELD) < 1 || OPT(O_DURATION) <= 0)
+        Usage(argv[0]);
+
+    rng = 0x9E3779B97F4A7C15ULL ^ (uint64_t)OPT(O_SEED);
+    sim_loop_cycles = (unsigned)OPT(O_LOOP);
+    sim_isr_cycles = (unsigned)OPT(O_ISR);
+
+    /* Enumeration moves the end to after the timeline */
+    Sim_Run(SIM_MS(2000));
+    if (host_state != HOST_RUNNING) Fail("the device never got configured");
+
+    if (log_path) WriteLog();
+    return Report();
+}
@@ -0,0 +1,54 @@
+/*
+ * Interface between the hardware models (hw.c) and the simulated world
+ * (sim.c) around the real firmware.
+ *
+ * Time is counted in CPU cycles at Fosc/4, 12 per us, the same unit as
+ * Timer1. The firmware only spends time where it touches the models: a
+ * Timer1 read costs sim_loop_cycles (the scheduler reads it around every
+ * task, so that is the main loop's pace), a __delay_us() its length and an
+ * interrupt sim_isr_cycles on top of any Timer1 reads inside it. Between
+ * those points the firmware runs in zero time. The numbers are estimates,
+ * good for comparing builds against each other, not for absolute claims.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#define SIM_CYCLES_PER_US   12
+#define SIM_US(us)          ((uint64_t)(us) * SIM_CYCLES_PER_US)
+#define SIM_MS(ms)          SIM_US((uint64_t)(ms) * 1000)
+
+/* Handshakes a token gets from the SIE */
+#define SIE_ACK             0
+#define SIE_NAK             1
+#define SIE_STALL           2
+#define SIE_NONE            3   /* No reply: module off, wrong address, endpoint disabled */
+
+extern uint64_t sim_now;            /* Cycles since power up */
+extern uint64_t sim_wake;           /* When Sim_World() wants to run next */
+extern uint64_t sim_end;            /* Sim_Run() returns here, the world may move it */
+extern uint8_t sim_pad;             /* Buttons held on the pad, bit set = pressed */
+extern unsigned sim_loop_cycles;    /* Charged per Timer1 read */
+extern unsigned sim_isr_cycles;     /* Charged per interrupt, entry to exit */
+extern unsigned long sim_toggle_drops;  /* OUT data the SIE threw away on a toggle mismatch */
+extern unsigned long sim_pad_reads;     /* Latch and 8 clocks on the 4021 */
+extern uint64_t sim_pad_read_cycles;    /* Spent in them, latch to the last clock */
+
+/* Run the firmware from reset until sim_now reaches end (sim_end) */
+void Sim_Run(uint64_t end);
+
+/* sim.c or host.c: host and pad, called whenever sim_now has reached sim_wake */
+void Sim_World(void);
+
+/* SIE, as seen from the bus. The token calls return a SIE_ handshake. */
+int Sie_Enabled(void);
+void Sie_BusReset(void);
+void Sie_Sof(uint16_t frame);
+int Sie_Setup(uint8_t address, const uint8_t *packet);
+int Sie_Out(uint8_t address, uint8_t ep, uint8_t toggle, const uint8_t *data, uint8_t count);
+int Sie_In(uint8_t address, uint8_t ep, uint8_t *toggle, uint8_t *data, uint8_t *count);
+void Sie_Error(uint8_t flags);      /* UEIR bits, as the SIE flags a damaged packet */
+
+#endif /* SIM_H */
@@ -0,0 +1,87 @@
+/*
+ * Dump the NES Keyboard telemetry feature report (see Source/telemetry.h).
+ *
+ *   cc -O2 -o telemetry tools/telemetry.c
+ *   ./telemetry [/dev/hidrawN]
+ *
+ * Without an argument the vendor interface is found by VID/PID and its
+ * report descriptor. Needs read/write access to the hidraw node.
+ */
+
+#include "nes_hidraw.h"
+
+#define REPORT_ID           0x01
+#define REPORT_VERSION      0x01
+#define REPORT_SIZE         74
+#define BINS                8
+#define CYCLES_PER_US       12.0
+
+static const char *usb_errors[8] =
+{
+    "PID check", "CRC5", "CRC16", "Data field size", "Bus turnaround", "-", "-", "Bit stuff"
+};
+
+static void print_log2(const char *name, const uint8_t *bins)
+{
+    int n;
+
+    printf("%s\n", name);
+    for (n = 0; n < BINS; n++)
+    {
+        double edge = (128 << n) / CYCLES_PER_US;
+        if (n < BINS - 1) printf("  < %8.1f us  %6u\n", edge, u16(bins + n * 2));
+        else printf("  >= %7.1f us  %6u\n", edge / 2, u16(bins + n * 2));
+    }
+}
+
+static void print_linear(const char *name, const uint8_t *bins)
+{
+    int n;
+
+    printf("%s\n", name);
+    for (n = 0; n < BINS; n++)
+    {
+        double edge = ((n + 1) * 4096) / CYCLES_PER_US;
+        if (n < BINS - 1) printf("  < %8.1f us  %6u\n", edge, u16(bins + n * 2));
+        else printf("  >= %7.1f us  %6u\n", (n * 4096) / CYCLES_PER_US, u16(bins + n * 2));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t report[REPORT_SIZE];
+    int fd;
+    int n;
+
+    fd = open_device(argc, argv);
+    if (fd < 0) return 1;
+
+    memset(report, 0, sizeof(report));
+    report[0] = REPORT_ID;
+    if (ioctl(fd, HIDIOCGFEATURE(sizeof(report)), report) < (int)sizeof(report))
+    {
+        perror("HIDIOCGFEATURE");
+        return 1;
+    }
+    if (report[1] != REPORT_VERSION)
+    {
+        fprintf(stderr, "Unknown telemetry version %u\n", report[1]);
+        return 1;
+    }
+
+    printf("Bus resets        %6u\n", u16(report + 2));
+    printf("Reports armed     %6u\n", u16(report + 4));
+    printf("Reports dropped   %6u\n", u16(report + 6));
+    printf("ISR max           %8.1f us\n", u16(report + 8) / CYCLES_PER_US);
+    printf("USB errors\n");
+    for (n = 0; n < 8; n++)
+    {
+        if (usb_errors[n][0] != '-') printf("  %-16s%6u\n", usb_errors[n], u16(report + 10 + n * 2));
+    }
+    print_log2("Pad sample -> report staged", report + 26);
+    print_log2("SOF -> pad sample", report + 42);
+    print_linear("Report armed -> collected by host", report + 58);
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Drain the NES Keyboard USB event trace (see Source/trace.h, firmware
+ * built with TraceEnabled) and print it as a timeline.
+ *
+ *   cc -O2 -o tracedump tools/tracedump.c
+ *   ./tracedump [-f] [/dev/hidrawN]
+ *
+ * -f keeps draining every 50ms until interrupted, so the 32 record ring
+ * doesn't overflow while watching a host enumerate or misbehave. Times are
+ * USB frames (ms) since the first record drained.
+ */
+
+#include "nes_hidraw.h"
+
+#define REPORT_ID           0x02
+#define REPORT_MAX          64
+#define RECORD_SIZE         8
+
+static const char *events[] =
+{
+    "?", "SETUP", "TOKEN", "REFUSED", "STALL", "RESET", "ERROR", "SUSPEND", "RESUME"
+};
+
+static const char *standard_requests[] =
+{
+    "GET_STATUS", "CLEAR_FEATURE", "?", "SET_FEATURE", "?", "SET_ADDRESS", "GET_DESCRIPTOR",
+    "SET_DESCRIPTOR", "GET_CONFIGURATION", "SET_CONFIGURATION", "GET_INTERFACE", "SET_INTERFACE"
+};
+
+static const char *class_requests[] =
+{
+    "?", "GET_REPORT", "GET_IDLE", "GET_PROTOCOL", "?", "?", "?", "?", "?",
+    "SET_REPORT", "SET_IDLE", "SET_PROTOCOL"
+};
+
+static const char *stages[] = { "setup", "data out", "data in", "status" };
+
+static const char *descriptor(unsigned type)
+{
+    switch (type)
+    {
+    case 0x01: return "Device";
+    case 0x02: return "Configuration";
+    case 0x03: return "String";
+    case 0x06: return "Qualifier";
+    case 0x21: return "HID";
+    case 0x22: return "Report";
+    }
+    return "?";
+}
+
+static const char *request(unsigned bm, unsigned request)
+{
+    if ((bm & 0x60) == 0x00 && request < 12) return standard_requests[request];
+    if ((bm & 0x60) == 0x20 && request < 12) return class_requests[request];
+    return "VENDOR/?";
+}
+
+static void print_setup(const uint8_t *d)
+{
+    printf("%02X %-17s", d[0], request(d[0], d[1]));
+    if ((d[0] & 0x60) == 0 && (d[1] == 6 || d[1] == 7))
+        printf(" %s[%u]", descriptor(d[3]), d[2]);
+    else
+        printf(" wValue %02X%02X", d[3], d[2]);
+    printf(" wIndex %u wLength %u%s\n", d[4], d[5], (d[0] & 0x80) ? "" : " (out)");
+}
+
+static void print_record(const uint8_t *r, unsigned long ms)
+{
+    unsigned type = r[1] >> 3;
+    unsigned frame = r[0] | ((r[1] & 0x07) << 8);
+    const uint8_t *d = r + 2;
+
+    printf("%8lu ms  [%4u]  %-8s ", ms, frame, type < 9 ? events[type] : "?");
+    switch (type)
+    {
+    case 1:
+        print_setup(d);
+        break;
+    case 2:
+        printf("EP0 %s stat %02X cnt %u, %s stage\n", d[0] ? "in " : "out", d[1], d[3], stages[d[2] & 3]);
+        break;
+    case 3:
+        printf("%02X %s - not handled, EP0 stalled\n", d[0], request(d[0], d[1]));
+        break;
+    case 4:
+        printf("UEP0 %02X\n", d[0]);
+        break;
+    case 5:
+        printf("address was %u, state %u\n", d[0], d[1]);
+        break;
+    case 6:
+        printf("UEIR %02X%s%s%s%s%s%s\n", d[0],
+               (d[0] & 0x01) ? " PID" : "", (d[0] & 0x02) ? " CRC5" : "", (d[0] & 0x04) ? " CRC16" : "",
+               (d[0] & 0x08) ? " DFN8" : "", (d[0] & 0x10) ? " BTO" : "", (d[0] & 0x80) ? " BTS" : "");
+        break;
+    default:
+        printf("\n");
+        break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t report[REPORT_MAX];
+    unsigned long ms = 0;
+    int last_frame = -1;
+    int follow = 0;
+    int fd;
+    int length;
+    int n;
+
+    if (argc > 1 && strcmp(argv[1], "-f") == 0)
+    {
+        follow = 1;
+        argc--;
+        argv++;
+    }
+
+    fd = open_device(argc, argv);
+    if (fd < 0) return 1;
+
+    for (;;)
+    {
+        memset(report, 0, sizeof(report));
+        report[0] = REPORT_ID;
+        length = ioctl(fd, HIDIOCGFEATURE(sizeof(report)), report);
+        if (length < 4)
+        {
+            perror("HIDIOCGFEATURE (firmware built without TraceEnabled?)");
+            return 1;
+        }
+
+        if (u16(report + 2)) printf("--- %u records lost (ring overflowed) ---\n", u16(report + 2));
+
+        for (n = 0; n < report[1] && 4 + (n + 1) * RECORD_SIZE <= length; n++)
+        {
+            const uint8_t *r = report + 4 + n * RECORD_SIZE;
+            int frame = r[0] | ((r[1] & 0x07) << 8);
+
+            /* The frame number wraps every 2048ms */
+            if (last_frame >= 0) ms += (frame - last_frame) & 0x7FF;
+            last_frame = frame;
+            print_record(r, ms);
+        }
+
+        if (report[1] == 0)
+        {
+            if (!follow) break;
+            fflush(stdout);
+            usleep(50000);
+        }
+    }
+
+    close(fd);
+    return 0;
+}